@@ -12,17 +12,17 @@
 #include <rofi/helper.h>
 #include <rofi/mode-private.h>
 #include <rofi/rofi-icon-fetcher.h>
+#include <rofi/settings.h>
 
 #include <glib-object.h>
-#include <json-glib/json-glib.h>
-#include <pango/pango.h>
 
 #include <stdint.h>
+#include <string.h>
 
 #include "string_utils.h"
 #include "page_data.h"
-#include "json_glib_extensions.h"
 #include "blocks_mode_data.h"
+#include "unix_socket.h"
 
 
 typedef struct RofiViewState RofiViewState;
@@ -45,8 +45,21 @@ const gchar* CmdArg__BLOCKS_WRAP = "-blocks-wrap";
 const gchar* CmdArg__BLOCKS_PROMPT = "-blocks-prompt";
 const gchar* CmdArg__MARKUP_ROWS = "-markup-rows";
 const gchar* CmdArg__EVENT_FORMAT = "-event-format";
-
-static const gchar* EMPTY_STRING = "";
+const gchar* CmdArg__BLOCKS_MAX_FPS = "-blocks-max-fps";
+const gchar* CmdArg__BLOCKS_DEBOUNCE_INPUT = "-blocks-debounce-input";
+const gchar* CmdArg__BLOCKS_DEBOUNCE_SELECT = "-blocks-debounce-select";
+const gchar* CmdArg__BLOCKS_THROTTLE_INPUT = "-blocks-throttle-input";
+const gchar* CmdArg__BLOCKS_THROTTLE_SELECT = "-blocks-throttle-select";
+const gchar* CmdArg__BLOCKS_PROTOCOL = "-blocks-protocol";
+const gchar* CmdArg__BLOCKS_INDEX = "-blocks-index";
+const gchar* CmdArg__BLOCKS_READER_THREAD = "-blocks-reader-thread";
+const gchar* CmdArg__BLOCKS_CONNECT = "-blocks-connect";
+const gchar* CmdArg__BLOCKS_SNAPSHOT = "-blocks-snapshot";
+const gchar* CmdArg__BLOCKS_TRACE = "-blocks-trace";
+const gchar* Env__BLOCKS_TRACE = "ROFI_BLOCKS_TRACE";
+
+// events waiting for the script to read them, before stale ones are dropped
+static const guint MAX_QUEUED_EVENTS = 256;
 
 typedef enum {
     Event__INIT,
@@ -60,7 +73,9 @@ typedef enum {
     Event__CUSTOM,
     Event__COMPLETE,
     Event__CANCEL,
-    Event__EXIT
+    Event__EXIT,
+    Event__FETCH_LINES,
+    Event__STATS
 } Event;
 
 static const char* event_enum_labels[] = {
@@ -75,7 +90,9 @@ static const char* event_enum_labels[] = {
     "CUSTOM",
     "COMPLETE",
     "CANCEL",
-    "EXIT"
+    "EXIT",
+    "FETCH_LINES",
+    "STATS"
 };
 
 
@@ -83,24 +100,80 @@ static const char* event_enum_labels[] = {
   extended mode pirvate data methods
 **************************************/
 
-void blocks_mode_private_data_write_to_channel(BlocksModePrivateData* data, Event event, const char* action_value, const char* action_data) {
-    GIOChannel* write_channel = data->write_channel;
-    if (data->write_channel == NULL) {
+static void blocks_mode_private_data_send_event(BlocksModePrivateData* data, Event event, const char* action_value, const char* action_data) {
+    if (data->event_queue == NULL) {
         // when script exits or errors while loading
         return;
     }
-    const gchar* format = data->event_format->str;
-    gchar* format_result = str_replace(format, "{{event}}", event_enum_labels[event]);
-    format_result = str_replace_in(&format_result, "{{value}}", action_value);
-    format_result = str_replace_in(&format_result, "{{data}}", action_data);
-    format_result = str_replace_in_escaped(&format_result, "{{value_escaped}}", action_value);
-    format_result = str_replace_in_escaped(&format_result, "{{data_escaped}}", action_data);
-    g_debug("sending event: %s", format_result);
-    gsize bytes_witten;
-    g_io_channel_write_chars(write_channel, format_result, -1, &bytes_witten, &data->error);
-    g_io_channel_write_unichar(write_channel, '\n', &data->error);
-    g_io_channel_flush(write_channel, &data->error);
-    g_free(format_result);
+    gint64 start = trace_begin(data->trace);
+    GString* format_result;
+    if (data->protocol == PayloadFormat_MSGPACK) {
+        format_result = event_format_render_msgpack(data->event_format, event_enum_labels[event], action_value, action_data);
+        g_debug("sending event: %s", event_enum_labels[event]);
+    } else {
+        format_result = event_format_render(data->event_format, event_enum_labels[event], action_value, action_data);
+        g_debug("sending event: %s", format_result->str);
+        g_string_append_c(format_result, '\n');
+    }
+    // selection and input changes are superseded by newer ones when the
+    // reader falls behind, every other event is always delivered
+    gboolean droppable = event == Event__SELECT_ENTRY || event == Event__INPUT;
+    event_queue_push(data->event_queue, format_result->str, format_result->len, event, droppable);
+    trace_end(data->trace, "write_event", start, "\"event\":\"%s\"", event_enum_labels[event]);
+}
+
+static void on_send_event(gint kind, const gchar* value, const gchar* data, gpointer context) {
+    blocks_mode_private_data_send_event((BlocksModePrivateData*) context, (Event) kind, value, data);
+}
+
+void blocks_mode_private_data_write_to_channel(BlocksModePrivateData* data, Event event, const char* action_value, const char* action_data) {
+    delayed_events_push(data->delayed_events, event, action_value, action_data);
+}
+
+static gint compare_blocks(gconstpointer a, gconstpointer b) {
+    guint block_a = *(const guint*) a;
+    guint block_b = *(const guint*) b;
+    return block_a < block_b ? -1 : block_a > block_b;
+}
+
+// asks for the queued blocks of virtual lines, a FETCH_LINES event with the
+// first line and the number of lines for each run of consecutive blocks
+static gboolean on_request_lines(gpointer context) {
+    BlocksModePrivateData* data = (BlocksModePrivateData*) context;
+    data->request_idle = 0;
+    GArray* blocks = data->blocks_to_request;
+    guint count = page_data_get_number_of_lines(data->page);
+    g_array_sort(blocks, compare_blocks);
+    for (guint i = 0; i < blocks->len;) {
+        guint first = g_array_index(blocks, guint, i);
+        guint last = first;
+        for (++i; i < blocks->len && g_array_index(blocks, guint, i) == last + 1; ++i) {
+            last++;
+        }
+        guint64 start = (guint64) first * PAGE_DATA_VIRTUAL_BLOCK_SIZE;
+        guint64 end = MIN(((guint64) last + 1) * PAGE_DATA_VIRTUAL_BLOCK_SIZE, count);
+        if (start >= end) {
+            continue;
+        }
+        char value[24];
+        char length[24];
+        snprintf(value, sizeof(value), "%" G_GUINT64_FORMAT, start);
+        snprintf(length, sizeof(length), "%" G_GUINT64_FORMAT, end - start);
+        delayed_events_send(data->delayed_events, Event__FETCH_LINES, value, length);
+    }
+    g_array_set_size(blocks, 0);
+    return G_SOURCE_REMOVE;
+}
+
+// lines rofi asks for while handling an event are fetched once it is done,
+// in as few events as possible
+static void request_virtual_lines(BlocksModePrivateData* data, guint index) {
+    if (!page_data_is_virtual(data->page) || index >= page_data_get_number_of_lines(data->page)) {
+        return;
+    }
+    if (blocks_mode_private_data_request_block(data, index) && data->request_idle == 0) {
+        data->request_idle = g_idle_add(on_request_lines, data);
+    }
 }
 
 
@@ -121,135 +194,227 @@ static PageData* mode_get_private_data_current_page(const Mode* sw) {
  main loop sources
 ********************/
 
-static void on_icon_retry(gpointer context) {
-    PageData *page = (PageData *) context;
+// rofi fetches icons asynchronously without telling when a fetch completes,
+// so setting the prompt icon is retried with a growing delay until it is
+// loaded, giving up after a while in case it does not exist
+static const guint ICON_RETRY_FIRST_DELAY_MS = 16;
+static const guint ICON_RETRY_MAX_DELAY_MS = 1000;
+static const guint ICON_RETRY_MAX_ATTEMPTS = 12;
+
+static void schedule_icon_retry(BlocksModePrivateData* data);
+
+static gboolean on_icon_retry(gpointer context) {
+    BlocksModePrivateData* data = (BlocksModePrivateData*) context;
+    data->icon_retry = 0;
+    GString* icon = data->page->icon;
     RofiViewState* state = rofi_view_get_active();
-    rofi_view_set_icon(state, page->icon != NULL ? page->icon->str : NULL, FALSE);
-}
-
-static gboolean next_line(BlocksModePrivateData* data, GIOChannel* source, GIOCondition condition, gpointer context) {
-    GString* buffer = data->buffer;
-    GString* active_line = data->active_line;
-    GError* error = NULL;
-    gunichar unichar;
-    GIOStatus status = g_io_channel_read_unichar(source, &unichar, &error);
-
-    // when there is nothing to read, status is G_IO_STATUS_AGAIN
-    while(status == G_IO_STATUS_NORMAL) {
-        g_string_append_unichar(buffer, unichar);
-        if (unichar == '\n') {
-            if (buffer->len > 1) { //input is not an empty line
-                g_debug("received new line: %s", buffer->str);
-                g_string_assign(active_line, buffer->str);
-            }
-            g_string_set_size(buffer, 0);
-            return TRUE;
-        }
-        status = g_io_channel_read_unichar(source, &unichar, &error);
+    // the icon of a snapshot is set before the view is created
+    if (state == NULL || rofi_view_set_icon(state, icon != NULL ? icon->str : NULL, FALSE) != 0) {
+        schedule_icon_retry(data);
     }
-    return FALSE;
+    return G_SOURCE_REMOVE;
 }
 
-// GIOChannel watch, called when there is output to read from child proccess
-static gboolean on_new_input(GIOChannel* source, GIOCondition condition, gpointer context) {
-    Mode* sw = (Mode*) context;
+static void schedule_icon_retry(BlocksModePrivateData* data) {
+    if (data->icon_retry_attempts >= ICON_RETRY_MAX_ATTEMPTS) {
+        g_debug("prompt icon is still not available, giving up");
+        return;
+    }
+    guint delay_ms = MIN(ICON_RETRY_FIRST_DELAY_MS << data->icon_retry_attempts, ICON_RETRY_MAX_DELAY_MS);
+    data->icon_retry_attempts++;
+    data->icon_retry = g_timeout_add(delay_ms, on_icon_retry, data);
+}
+
+// applies the page changes accumulated since the frame started to the view
+static void flush_frame(Mode* sw) {
     BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+    BlocksModeFrame* frame = &data->frame;
+    if (!frame->open) {
+        return;
+    }
+    gint64 start = trace_begin(data->trace);
+    blocks_mode_private_data_apply_pending_lines(data);
+    // the view is only reloaded when something it shows changed
+    gboolean changed = data->page->lines_generation != frame->lines_generation
+        || !page_data_is_string_equal(frame->message, data->page->message);
+
+    GString* new_overlay = data->page->overlay;
+    GString* new_prompt = data->page->prompt;
+    GString* new_placeholder = data->page->placeholder;
+    GString* new_icon = data->page->icon;
+    GString* new_input = data->page->input;
+    GString* new_filter = data->page->filter;
+    gboolean new_case_sensitive = data->page->case_sensitive;
 
-    while (next_line(data, source, condition, context)) {
-        g_debug("handling received line");
+    RofiViewState* state = rofi_view_get_active();
 
-        GString* overlay = data->page->overlay;
-        GString* prompt = data->page->prompt;
-        GString* placeholder = data->page->placeholder;
-        GString* icon = data->page->icon;
-        GString* input = data->page->input;
-        GString* filter = data->page->filter;
-
-        GString* old_overlay = overlay ? g_string_new(overlay->str) : NULL;
-        GString* old_prompt = prompt ? g_string_new(prompt->str) : NULL;
-        GString* old_placeholder = placeholder ? g_string_new(placeholder->str) : NULL;
-        GString* old_icon = icon ? g_string_new(icon->str) : NULL;
-        GString* old_input = input ? g_string_new(input->str) : NULL;
-        GString* old_filter = filter ? g_string_new(filter->str) : NULL;
-        gboolean old_case_sensitive = data->page->case_sensitive;
-
-        blocks_mode_private_data_update_page(data);
-
-        GString* new_overlay = data->page->overlay;
-        GString* new_prompt = data->page->prompt;
-        GString* new_placeholder = data->page->placeholder;
-        GString* new_icon = data->page->icon;
-        GString* new_input = data->page->input;
-        GString* new_filter = data->page->filter;
-        gboolean new_case_sensitive = data->page->case_sensitive;
-
-        RofiViewState* state = rofi_view_get_active();
-
-        if (!page_data_is_string_equal(old_icon, new_icon)) {
-            if (rofi_view_set_icon(state, new_icon ? new_icon->str : NULL, FALSE) != 0) {
-                // Icons are fetched asynchronously and may not be immediately
-                // available. rofi_view_set_icon returns non-zero if this is the
-                // case (or the icon wasn't found), so try again shortly after:
-                g_idle_add(G_SOURCE_FUNC(on_icon_retry), (void*) data->page);
-            }
+    if (!page_data_is_string_equal(frame->icon, new_icon)) {
+        changed = TRUE;
+        if (data->icon_retry > 0) {
+            g_source_remove(data->icon_retry);
+            data->icon_retry = 0;
         }
-
-        if ((old_case_sensitive != new_case_sensitive)
-            || (!page_data_is_string_equal(old_filter, new_filter))) {
-            if (data->tokens) {
-                helper_tokenize_free(data->tokens);
-            }
-            data->tokens = new_filter == NULL
-                ? NULL
-                : helper_tokenize(new_filter->str, new_case_sensitive);
-            rofi_view_set_case_sensitive(state, new_case_sensitive);
+        data->icon_retry_attempts = 0;
+        if (rofi_view_set_icon(state, new_icon ? new_icon->str : NULL, FALSE) != 0) {
+            // rofi_view_set_icon returns non-zero if the icon is not loaded
+            // yet (or wasn't found)
+            schedule_icon_retry(data);
         }
+    }
 
-        if (!page_data_is_string_equal(old_overlay, new_overlay)) {
-            rofi_view_set_overlay(state, (new_overlay->len > 0) ? new_overlay->str : NULL);
+    if ((frame->case_sensitive != new_case_sensitive)
+        || (!page_data_is_string_equal(frame->filter, new_filter))) {
+        changed = TRUE;
+        if (data->tokens) {
+            helper_tokenize_free(data->tokens);
         }
+        data->tokens = new_filter == NULL
+            ? NULL
+            : helper_tokenize(new_filter->str, new_case_sensitive);
+        data->query_generation++;
+        rofi_view_set_case_sensitive(state, new_case_sensitive);
+    }
 
-        if (!page_data_is_string_equal(old_placeholder, new_placeholder)) {
-            rofi_view_set_placeholder(state, (new_placeholder->len > 0) ? new_placeholder->str : NULL);
-        }
+    if (!page_data_is_string_equal(frame->overlay, new_overlay)) {
+        changed = TRUE;
+        rofi_view_set_overlay(state, (new_overlay->len > 0) ? new_overlay->str : NULL);
+    }
 
-        if (!page_data_is_string_equal(old_input, new_input)) {
-            rofi_view_set_input(state, new_input->str, -1);
-        }
+    if (!page_data_is_string_equal(frame->placeholder, new_placeholder)) {
+        changed = TRUE;
+        rofi_view_set_placeholder(state, (new_placeholder->len > 0) ? new_placeholder->str : NULL);
+    }
 
-        if (!page_data_is_string_equal(old_prompt, new_prompt)) {
-            if (sw->display_name) {
-                g_free(sw->display_name);
-            }
-            sw->display_name = new_prompt ? g_strdup(new_prompt->str) : NULL;
-            rofi_view_update_prompt(state);
-        }
+    if (frame->input_set_by_payload && !page_data_is_string_equal(frame->input, new_input)) {
+        changed = TRUE;
+        rofi_view_set_input(state, new_input->str, -1);
+    }
 
-        if (data->entry_to_focus >= 0) {
-            g_debug("entry_to_focus %li", data->entry_to_focus);
-            rofi_view_set_selected_line(state, (unsigned int) data->entry_to_focus);
+    if (!page_data_is_string_equal(frame->prompt, new_prompt)) {
+        changed = TRUE;
+        if (sw->display_name) {
+            g_free(sw->display_name);
         }
+        sw->display_name = new_prompt ? g_strdup(new_prompt->str) : NULL;
+        rofi_view_update_prompt(state);
+    }
 
-        if (data->page->trigger != NULL) {
-            rofi_view_trigger_action_by_name(state, data->page->trigger->str);
-            g_string_free(data->page->trigger, TRUE);
-            data->page->trigger = NULL;
-        }
+    if (data->entry_to_focus >= 0) {
+        changed = TRUE;
+        g_debug("entry_to_focus %li", data->entry_to_focus);
+        rofi_view_set_selected_line(state, (unsigned int) data->entry_to_focus);
+    }
+
+    if (data->page->trigger != NULL) {
+        changed = TRUE;
+        rofi_view_trigger_action_by_name(state, data->page->trigger->str);
+        g_string_free(data->page->trigger, TRUE);
+        data->page->trigger = NULL;
+    }
 
-        old_overlay && g_string_free(old_overlay, TRUE);
-        old_prompt && g_string_free(old_prompt, TRUE);
-        old_placeholder && g_string_free(old_placeholder, TRUE);
-        old_icon && g_string_free(old_icon, TRUE);
-        old_input && g_string_free(old_input, TRUE);
-        old_filter && g_string_free(old_filter, TRUE);
+    blocks_mode_private_data_end_frame(data);
+    data->last_frame_time = g_get_monotonic_time();
 
-        g_debug("reloading rofi view");
-        rofi_view_reload();
+    if (data->stats_requested) {
+        // after the lines of the frame were applied, to count them
+        data->stats_requested = FALSE;
+        gchar* stats = blocks_mode_private_data_format_stats(data);
+        delayed_events_send(data->delayed_events, Event__STATS, stats, "");
+        g_free(stats);
+    }
+
+    if (!changed) {
+        g_debug("nothing changed, not reloading rofi view");
+        trace_end(data->trace, "update_view", start, "\"reload\":false");
+        return;
+    }
+    g_debug("reloading rofi view");
+    rofi_view_reload();
+    trace_end(data->trace, "update_view", start, "\"reload\":true");
+}
+
+static gboolean on_frame_timeout(gpointer context) {
+    Mode* sw = (Mode*) context;
+    BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+    data->frame_timeout = 0;
+    flush_frame(sw);
+    return G_SOURCE_REMOVE;
+}
+
+// flushes the open frame right away, or once the -blocks-max-fps interval
+// since the last flush has passed
+static void schedule_frame(Mode* sw) {
+    BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+    if (!data->frame.open || data->frame_timeout > 0) {
+        return;
+    }
+    gint64 elapsed = g_get_monotonic_time() - data->last_frame_time;
+    gint64 interval = data->max_fps > 0 ? G_USEC_PER_SEC / data->max_fps : 0;
+    if (elapsed >= interval) {
+        flush_frame(sw);
+    } else {
+        data->frame_timeout = g_timeout_add((interval - elapsed) / 1000 + 1, on_frame_timeout, sw);
     }
+}
 
+// GIOChannel watch, called when there is output to read from child proccess
+static gboolean on_new_input(GIOChannel* source, GIOCondition condition, gpointer context) {
+    Mode* sw = (Mode*) context;
+    BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+    gint64 start = trace_begin(data->trace);
+    LineReaderStatus status = line_reader_fill(data->line_reader);
+    trace_end(data->trace, "read", start, NULL);
+    gchar* line;
+    gsize line_length;
+
+    // Every payload updates the page right away, but the view is only
+    // updated (and reloaded) once per frame. Only the lines of the newest
+    // payload that has them are ever built.
+    while (data->protocol == PayloadFormat_MSGPACK
+           ? line_reader_next_frame(data->line_reader, &line, &line_length)
+           : line_reader_next_line(data->line_reader, &line, &line_length)) {
+        if (blocks_mode_private_data_is_repeated_payload(data, line, line_length)) {
+            g_debug("skipping payload identical to the previous one");
+            continue;
+        }
+        g_debug("handling received line");
+        blocks_mode_private_data_begin_frame(data);
+        blocks_mode_private_data_update_page(data, data->protocol, line, line_length);
+        if (data->page->trigger != NULL) {
+            // keybindings act on the view as it is now, never coalesce them
+            flush_frame(sw);
+        }
+    }
+    // the lines point into the reader buffer, build them before it is reused
+    blocks_mode_private_data_build_pending_lines(data);
+    schedule_frame(sw);
+
+    if (status == LineReaderStatus_EOF || status == LineReaderStatus_ERROR) {
+        g_debug("input closed, removing watch");
+        data->read_channel_watcher = 0;
+        return G_SOURCE_REMOVE;
+    }
     return G_SOURCE_CONTINUE;
 }
 
+// called on the main loop with each payload the reader thread parsed, as
+// on_new_input does with each payload it reads, then with NULL
+static void on_payload_read(PayloadReaderItem* item, gpointer context) {
+    Mode* sw = (Mode*) context;
+    BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+    if (item == NULL) {
+        schedule_frame(sw);
+        return;
+    }
+    blocks_mode_private_data_begin_frame(data);
+    gint64 start = trace_begin(data->trace);
+    blocks_mode_private_data_apply_payload(data, &item->payload, item->lines);
+    trace_end(data->trace, "apply_payload", start, NULL);
+    if (data->page->trigger != NULL) {
+        flush_frame(sw);
+    }
+}
+
 // spawn watch, called when child exited
 static void on_child_status(GPid pid, gint status, gpointer context) {
     g_message("Child %" G_PID_FORMAT " exited %s", pid,
@@ -257,7 +422,10 @@ static void on_child_status(GPid pid, gint status, gpointer context) {
     Mode* sw = (Mode*) context;
     BlocksModePrivateData *data = mode_get_private_data_extended_mode(sw);
     g_spawn_close_pid(pid);
-    data->write_channel = NULL;
+    if (data->event_queue != NULL) {
+        event_queue_destroy(data->event_queue);
+        data->event_queue = NULL;
+    }
     if (data->close_on_child_exit) {
         exit(0);
     }
@@ -268,15 +436,89 @@ static void on_child_status(GPid pid, gint status, gpointer context) {
  extended mode methods
 ***********************/
 
+// shows the page saved when the backend was last used, until it sends its
+// first payload
+static void blocks_mode_show_snapshot(Mode* sw, BlocksModePrivateData* pd) {
+    gsize length;
+    gchar* payload = page_snapshot_load(pd->snapshot_key, &length);
+    if (payload == NULL) {
+        return;
+    }
+    g_debug("showing snapshot of %s", pd->snapshot_key);
+    blocks_mode_private_data_update_page(pd, PayloadFormat_JSON, payload, length);
+    blocks_mode_private_data_apply_pending_lines(pd);
+    pd->showing_snapshot = TRUE;
+    if (pd->page->prompt != NULL) {
+        g_free(sw->display_name);
+        sw->display_name = g_strdup(pd->page->prompt->str);
+    }
+    if (pd->page->icon != NULL) {
+        schedule_icon_retry(pd);
+    }
+    g_free(payload);
+}
+
+// shows why the backend could not be started or reached, in place of its pages
+static void blocks_mode_show_backend_error(BlocksModePrivateData* pd, const char* backend, const char* error_message) {
+    char buffer[1024];
+    char* backend_escaped = str_new_escaped_for_json_string(backend);
+    char* error_message_escaped = str_new_escaped_for_json_string(error_message);
+    snprintf(buffer, sizeof(buffer),
+             "{\"close_on_exit\": false, \"message\":\"Error loading %s:%s\"}\n",
+             backend_escaped,
+             error_message_escaped);
+    fprintf(stderr, "message:  %s\n", buffer);
+
+    blocks_mode_private_data_update_page(pd, PayloadFormat_JSON, buffer, strlen(buffer));
+    g_free(backend_escaped);
+    g_free(error_message_escaped);
+}
+
 static int blocks_mode_init(Mode* sw) {
     if (mode_get_private_data(sw)) { return TRUE; }
 
     BlocksModePrivateData* pd = blocks_mode_private_data_new();
     mode_set_private_data(sw, (void*) pd);
 
+    char* trace_path = NULL;
+    if (!find_arg_str(CmdArg__BLOCKS_TRACE, &trace_path)) {
+        trace_path = (char*) g_getenv(Env__BLOCKS_TRACE);
+    }
+    if (trace_path != NULL && trace_path[0] != '\0') {
+        GError* error = NULL;
+        pd->trace = trace_new(trace_path, &error);
+        if (pd->trace == NULL) {
+            fprintf(stderr, "Unable to trace: %s\n", error->message);
+            g_error_free(error);
+        }
+        pd->match_bitmap->trace = pd->trace;
+    }
+
     char* format = NULL;
     if (find_arg_str(CmdArg__EVENT_FORMAT, &format)) {
-        pd->event_format = g_string_new(format);
+        event_format_set(pd->event_format, format);
+    }
+
+    char* protocol = NULL;
+    if (find_arg_str(CmdArg__BLOCKS_PROTOCOL, &protocol)) {
+        if (g_strcmp0(protocol, "msgpack") == 0) {
+            pd->protocol = PayloadFormat_MSGPACK;
+        } else if (g_strcmp0(protocol, "json") != 0) {
+            fprintf(stderr, "Unknown protocol %s, using json\n", protocol);
+        }
+    }
+
+    find_arg_uint(CmdArg__BLOCKS_MAX_FPS, &pd->max_fps);
+    pd->delayed_events = delayed_events_new(Event__INPUT, Event__SELECT_ENTRY, on_send_event, pd);
+    find_arg_uint(CmdArg__BLOCKS_DEBOUNCE_INPUT, &pd->delayed_events->input.debounce_ms);
+    find_arg_uint(CmdArg__BLOCKS_DEBOUNCE_SELECT, &pd->delayed_events->select_entry.debounce_ms);
+    find_arg_uint(CmdArg__BLOCKS_THROTTLE_INPUT, &pd->delayed_events->input.throttle_ms);
+    find_arg_uint(CmdArg__BLOCKS_THROTTLE_SELECT, &pd->delayed_events->select_entry.throttle_ms);
+
+    pd->icon_cache = icon_cache_new(rofi_icon_fetcher_query);
+
+    if (find_arg(CmdArg__BLOCKS_INDEX) >= 0) {
+        pd->trigram_index = trigram_index_new();
     }
 
     if (find_arg(CmdArg__MARKUP_ROWS)) {
@@ -288,8 +530,33 @@ static int blocks_mode_init(Mode* sw) {
         sw->display_name = g_strdup(prompt);
     }
 
+    // INIT tells sessions sharing a backend apart
+    char init_data[128];
+    g_strlcpy(init_data, ROFI_PACKAGE_VERSION, sizeof(init_data));
+    char* socket_path = NULL;
     char* cmd = NULL;
-    if (find_arg_str(CmdArg__BLOCKS_WRAP, &cmd)) {
+    if (find_arg_str(CmdArg__BLOCKS_CONNECT, &socket_path)) {
+        GError* error = NULL;
+        int socket_fd = unix_socket_connect(socket_path, &error);
+        if (socket_fd < 0) {
+            fprintf(stderr, "Unable to connect %s\n", error->message);
+            blocks_mode_show_backend_error(pd, socket_path, error->message);
+            g_error_free(error);
+            return TRUE;
+        }
+        // both ends are closed on destroy, and share the non-blocking mode
+        pd->read_channel_fd = socket_fd;
+        pd->write_channel_fd = dup(socket_fd);
+        int retval = fcntl(pd->read_channel_fd, F_SETFL, fcntl(pd->read_channel_fd, F_GETFL) | O_NONBLOCK);
+        if (retval != 0 || pd->write_channel_fd < 0) {
+            fprintf(stderr,"Error setting up socket %s\n", socket_path);
+            exit(1);
+        }
+        pd->read_channel = g_io_channel_unix_new(pd->read_channel_fd);
+        pd->event_queue = event_queue_new(pd->write_channel_fd, MAX_QUEUED_EVENTS);
+        snprintf(init_data, sizeof(init_data), "%s %d-%" G_GINT64_FORMAT,
+                 ROFI_PACKAGE_VERSION, (int) getpid(), g_get_real_time());
+    } else if (find_arg_str(CmdArg__BLOCKS_WRAP, &cmd)) {
         GError* error = NULL;
         int cmd_input_fd;
         int cmd_output_fd;
@@ -305,21 +572,8 @@ static int blocks_mode_init(Mode* sw) {
                 NULL, NULL, &(pd->cmd_pid), &(cmd_input_fd), &(cmd_output_fd), NULL,
                 &error)) {
             fprintf(stderr, "Unable to exec %s\n", error->message);
-            char buffer[1024];
-            int result = 4;
-            char* cmd_escaped = str_new_escaped_for_json_string(cmd);
-            char* error_message_escaped = str_new_escaped_for_json_string(error->message);
-            snprintf(buffer, sizeof(buffer),
-                     "{\"close_on_exit\": false, \"message\":\"Error loading %s:%s\"}\n",
-                     cmd_escaped,
-                     error_message_escaped);
-            fprintf(stderr, "message:  %s\n", buffer);
-
-            g_string_assign(pd->active_line, buffer);
-            blocks_mode_private_data_update_page(pd);
+            blocks_mode_show_backend_error(pd, cmd, error->message);
             g_error_free(error);
-            g_free(cmd_escaped);
-            g_free(error_message_escaped);
             return TRUE;
         }
         g_strfreev(argv);
@@ -328,13 +582,16 @@ static int blocks_mode_init(Mode* sw) {
         pd->write_channel_fd = cmd_input_fd;
 
         int retval = fcntl(pd->read_channel_fd, F_SETFL, fcntl(pd->read_channel_fd, F_GETFL) | O_NONBLOCK);
+        if (retval == 0) {
+            retval = fcntl(pd->write_channel_fd, F_SETFL, fcntl(pd->write_channel_fd, F_GETFL) | O_NONBLOCK);
+        }
         if (retval != 0) {
             fprintf(stderr,"Error setting non block on output pipe\n");
             kill(pd->cmd_pid, SIGTERM);
             exit(1);
         }
         pd->read_channel = g_io_channel_unix_new(pd->read_channel_fd);
-        pd->write_channel = g_io_channel_unix_new(pd->write_channel_fd);
+        pd->event_queue = event_queue_new(pd->write_channel_fd, MAX_QUEUED_EVENTS);
         g_child_watch_add(pd->cmd_pid, on_child_status, sw);
     } else {
         int retval = fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
@@ -343,12 +600,28 @@ static int blocks_mode_init(Mode* sw) {
             exit(1);
         }
         pd->read_channel = g_io_channel_unix_new(STDIN_FILENO);
-        pd->write_channel = g_io_channel_unix_new(STDOUT_FILENO);
+        // stdout is left blocking, its mode is shared with the shell and the
+        // rest of the pipeline, and rofi writes to it too
+        pd->event_queue = event_queue_new(STDOUT_FILENO, MAX_QUEUED_EVENTS);
     }
 
-    pd->read_channel_watcher = g_io_add_watch(pd->read_channel, G_IO_IN, on_new_input, sw);
+    const char* backend = socket_path != NULL ? socket_path : cmd;
+    if (backend != NULL && find_arg(CmdArg__BLOCKS_SNAPSHOT) >= 0) {
+        pd->snapshot_key = g_strdup(backend);
+        blocks_mode_show_snapshot(sw, pd);
+    }
+
+    if (find_arg(CmdArg__BLOCKS_READER_THREAD) >= 0) {
+        pd->payload_reader = payload_reader_new(g_io_channel_unix_get_fd(pd->read_channel), pd->protocol,
+                                                pd->page->markup_default, pd->page->max_lines, pd->trace,
+                                                &pd->stats, on_payload_read, sw);
+    } else {
+        pd->line_reader = line_reader_new(g_io_channel_unix_get_fd(pd->read_channel));
+        line_reader_set_framed(pd->line_reader, pd->protocol == PayloadFormat_MSGPACK);
+        pd->read_channel_watcher = g_io_add_watch(pd->read_channel, G_IO_IN, on_new_input, sw);
+    }
 
-    blocks_mode_private_data_write_to_channel(pd, Event__INIT, PACKAGE_VERSION, ROFI_PACKAGE_VERSION);
+    blocks_mode_private_data_write_to_channel(pd, Event__INIT, PACKAGE_VERSION, init_data);
     return TRUE;
 }
 
@@ -367,11 +640,10 @@ static ModeMode blocks_mode_result(Mode* sw, int mretv, char** input, unsigned i
         return PREVIOUS_DIALOG;
     }
 
+    gint64 start = trace_begin(data->trace);
     PageData* page = data->page;
-    LineData* line;
-    if (selected_line >= 0 && selected_line < page->lines->len) {
-        line = &g_array_index(page->lines, LineData, selected_line);
-    } else {
+    LineData* line = page_data_get_line_by_index_or_else(page, selected_line, NULL);
+    if (line == NULL) {
         selected_line = -1;
     }
 
@@ -383,12 +655,13 @@ static ModeMode blocks_mode_result(Mode* sw, int mretv, char** input, unsigned i
     } else if (mretv & MENU_COMPLETE) {
         blocks_mode_private_data_write_to_channel(data, Event__COMPLETE, "", "");
     } else if (mretv & MENU_OK) {
-        if (line->nonselectable) { return RELOAD_DIALOG; }
+        // lines of virtual pages may not be loaded yet
+        if (line == NULL || line->nonselectable) { return RELOAD_DIALOG; }
         blocks_mode_private_data_write_to_channel(
             data, (mretv & MENU_CUSTOM_ACTION) ? Event__ACCEPT_ENTRY_ALT : Event__ACCEPT_ENTRY,
             line->text, line->data);
     } else if (mretv & MENU_ENTRY_DELETE) {
-        if (line->nonselectable) { return RELOAD_DIALOG; }
+        if (line == NULL || line->nonselectable) { return RELOAD_DIALOG; }
         blocks_mode_private_data_write_to_channel(data, Event__DELETE_ENTRY, line->text, line->data);
     } else if (mretv & MENU_CUSTOM_INPUT) {
         blocks_mode_private_data_write_to_channel(
@@ -400,12 +673,20 @@ static ModeMode blocks_mode_result(Mode* sw, int mretv, char** input, unsigned i
     } else {
         retv = MODE_EXIT;
     }
+    trace_end(data->trace, "result", start, "\"mretv\":%d", mretv);
     return retv;
 }
 
 static void blocks_mode_destroy(Mode* sw) {
     BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
     if (data != NULL) {
+        if (data->snapshot_key != NULL) {
+            GError* error = NULL;
+            if (!page_snapshot_save(data->page, data->snapshot_key, &error)) {
+                g_warning("unable to save snapshot: %s", error->message);
+                g_error_free(error);
+            }
+        }
         blocks_mode_private_data_write_to_channel(data, Event__EXIT, "", "");
         blocks_mode_private_data_update_destroy(data);
         mode_set_private_data(sw, NULL);
@@ -425,8 +706,9 @@ static void blocks_mode_destroy(Mode* sw) {
     }
 
     if (line->icon_fetch_uid <= 0) {
-        line->icon_fetch_uid = rofi_icon_fetcher_query(icon, height);
-    } 
+        BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+        line->icon_fetch_uid = icon_cache_lookup(data->icon_cache, icon, height);
+    }
     return rofi_icon_fetcher_get(line->icon_fetch_uid);
  }
 
@@ -437,6 +719,7 @@ static char* blocks_mode_get_display_value(const Mode* sw, unsigned int selected
     PageData* page = mode_get_private_data_current_page(sw);
     LineData* line = page_data_get_line_by_index_or_else(page, selected_line, NULL);
     if (line == NULL) {
+        request_virtual_lines(data, selected_line);
         *state |= 16;
         return get_entry ? g_strdup("") : NULL;
     }
@@ -448,29 +731,191 @@ static char* blocks_mode_get_display_value(const Mode* sw, unsigned int selected
     return get_entry ? g_strdup(line->text) : NULL;
 }
 
-static int blocks_mode_token_match(const Mode* sw, rofi_int_matcher** tokens, unsigned int selected_line) {
-    BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+typedef struct {
+    BlocksModePrivateData* data;
+    rofi_int_matcher** tokens;
+} BlocksModeMatchContext;
+
+// called from the match bitmap threads
+static gboolean blocks_mode_line_matches(gpointer context, guint index) {
+    BlocksModeMatchContext* match_context = (BlocksModeMatchContext*) context;
+    BlocksModePrivateData* data = match_context->data;
     PageData* page = data->page;
-    LineData* line = page_data_get_line_by_index_or_else(page, selected_line, NULL);
+    LineData* line = page_data_get_line_by_index_or_else(page, index, NULL);
     if (line == NULL) { return FALSE; }
     if (line->filter == FALSE) { return TRUE; }
-    if (data->tokens == NULL) {
-        if (page->filter != NULL && page->filter->str[0] == '\0') {
-            return TRUE;
+    if (data->tokens == NULL && page->filter != NULL && page->filter->str[0] == '\0') {
+        return TRUE;
+    }
+    return helper_token_match(match_context->tokens, line->match_text);
+}
+
+// Words of query as rofi built tokens from them with the normal matching
+// method: each token is then the escaped word, inverted when it starts with
+// '-'. NULL when tokens were built otherwise, or when lines are normalized
+// before matching.
+static gchar** blocks_mode_get_query_words(const gchar* query, rofi_int_matcher** tokens) {
+    if (config.normalize_match) {
+        return NULL;
+    }
+    gchar** words = g_strsplit(query, " ", -1);
+    GPtrArray* result = g_ptr_array_new_with_free_func(g_free);
+    gboolean normal = tokens != NULL;
+    guint token_index = 0;
+    for (gchar** word = words; normal && *word != NULL; ++word) {
+        if (**word == '\0') {
+            continue;
+        }
+        rofi_int_matcher* token = tokens[token_index];
+        gboolean invert = (*word)[0] == '-';
+        gchar* escaped = g_regex_escape_string(invert ? *word + 1 : *word, -1);
+        normal = token != NULL && !token->invert == !invert
+            && g_strcmp0(g_regex_get_pattern(token->regex), escaped) == 0;
+        g_free(escaped);
+        if (normal) {
+            g_ptr_array_add(result, g_strdup(*word));
+            token_index++;
+        }
+    }
+    normal = normal && tokens[token_index] == NULL;
+    g_strfreev(words);
+    if (!normal) {
+        g_ptr_array_free(result, TRUE);
+        return NULL;
+    }
+    g_ptr_array_set_free_func(result, NULL);
+    g_ptr_array_add(result, NULL);
+    return (gchar**) g_ptr_array_free(result, FALSE);
+}
+
+static gboolean blocks_mode_word_contains(const gchar* word, const gchar* part, gboolean caseless) {
+    if (!caseless) {
+        return strstr(word, part) != NULL;
+    }
+    gchar* folded_word = g_utf8_casefold(word, -1);
+    gchar* folded_part = g_utf8_casefold(part, -1);
+    gboolean result = strstr(folded_word, folded_part) != NULL;
+    g_free(folded_word);
+    g_free(folded_part);
+    return result;
+}
+
+// Whether every line matching words also matches previous_words, as when
+// typing: each previous word is extended in place, inverted words are kept
+// as they are, and words may be added at the end.
+static gboolean blocks_mode_query_narrows(gchar** previous_words, gchar** words, gboolean caseless) {
+    for (guint i = 0; previous_words[i] != NULL; ++i) {
+        const gchar* previous = previous_words[i];
+        const gchar* word = words[i];
+        if (word == NULL) {
+            return FALSE;
         }
+        gboolean narrows = previous[0] == '-'
+            ? g_strcmp0(previous, word) == 0
+            : word[0] != '-' && blocks_mode_word_contains(word, previous, caseless);
+        if (!narrows) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// brings the index up to date with the lines, appended lines are indexed
+// incrementally and the ones the max_lines ring evicted are dropped. The
+// index is rebuilt once it holds more dropped lines than kept ones.
+static void blocks_mode_update_trigram_index(BlocksModePrivateData* data) {
+    TrigramIndex* index = data->trigram_index;
+    PageData* page = data->page;
+    guint length = page_data_get_number_of_lines(page);
+    guint64 evicted = page->lines_evicted - data->trigram_index_evicted;
+    if (data->trigram_index_reset_generation != page->lines_reset_generation
+            || evicted > trigram_index_get_number_of_lines(index)
+            || index->dropped + evicted > length) {
+        trigram_index_clear(index);
+        data->trigram_index_reset_generation = page->lines_reset_generation;
     } else {
-        tokens = data->tokens;
+        trigram_index_drop(index, (guint) evicted);
+    }
+    data->trigram_index_evicted = page->lines_evicted;
+    if (trigram_index_get_number_of_lines(index) > length) {
+        trigram_index_clear(index);
+    }
+    if (trigram_index_get_number_of_lines(index) == length) {
+        return;
     }
-    gchar* text = line->text;
-    if (line->meta != NULL) {
-        text = line->meta;
-    } else if (!line->markup) {
-        return helper_token_match(tokens, text);
+    gint64 start = g_get_monotonic_time();
+    guint first = trigram_index_get_number_of_lines(index);
+    for (guint i = first; i < length; ++i) {
+        LineData* line = page_data_get_line_by_index_or_else(page, i, NULL);
+        trigram_index_add(index, line->match_text, !line->filter);
     }
-    // Strip out markup when matching
-    char* esc = NULL;
-    pango_parse_markup(text, -1, 0, NULL, &esc, NULL, NULL);
-    return helper_token_match(tokens, esc);
+    g_debug("indexed %u lines in %" G_GINT64_FORMAT " us, index of %u lines uses %" G_GSIZE_FORMAT " KiB",
+            length - first, g_get_monotonic_time() - start, length, index->memory / 1024);
+}
+
+static GArray* blocks_mode_query_trigram_index(BlocksModePrivateData* data, gchar** words) {
+    GPtrArray* needles = g_ptr_array_new();
+    for (gchar** word = words; *word != NULL; ++word) {
+        if ((*word)[0] != '-') {
+            g_ptr_array_add(needles, *word);
+        }
+    }
+    g_ptr_array_add(needles, NULL);
+    blocks_mode_update_trigram_index(data);
+    GArray* candidates = trigram_index_query(data->trigram_index, (const gchar* const*) needles->pdata);
+    g_ptr_array_free(needles, TRUE);
+    return candidates;
+}
+
+// called by the match bitmap before matching: when the query narrows the
+// previous one, only the lines that matched it are matched again, otherwise
+// the trigram index tells which lines may match, with -blocks-index
+static GArray* blocks_mode_line_candidates(gpointer context) {
+    BlocksModeMatchContext* match_context = (BlocksModeMatchContext*) context;
+    BlocksModePrivateData* data = match_context->data;
+    PageData* page = data->page;
+    rofi_int_matcher** tokens = match_context->tokens;
+    gchar** words = NULL;
+    if (data->tokens != NULL || page->filter == NULL || page->filter->str[0] != '\0') {
+        const gchar* query = data->tokens != NULL ? page->filter->str : data->query->str;
+        words = blocks_mode_get_query_words(query, tokens);
+    }
+    gboolean caseless = tokens != NULL && tokens[0] != NULL
+        && (g_regex_get_compile_flags(tokens[0]->regex) & G_REGEX_CASELESS) != 0;
+
+    GArray* candidates = NULL;
+    if (words != NULL && data->matched_words != NULL && data->matched_caseless == caseless
+            && blocks_mode_query_narrows(data->matched_words, words, caseless)) {
+        candidates = match_bitmap_get_matches(data->match_bitmap, page->lines_generation,
+                                              page_data_get_number_of_lines(page));
+    }
+    if (candidates == NULL && words != NULL && data->trigram_index != NULL) {
+        candidates = blocks_mode_query_trigram_index(data, words);
+    } else if (words == NULL && data->trigram_index != NULL) {
+        g_debug("not using the index, tokens are not matched as substrings");
+    }
+    g_strfreev(data->matched_words);
+    data->matched_words = words;
+    data->matched_caseless = caseless;
+    return candidates;
+}
+
+// rofi calls this for every line on each filter pass; the first call of a
+// pass matches every line at once, the rest only look the result up
+static int blocks_mode_token_match(const Mode* sw, rofi_int_matcher** tokens, unsigned int selected_line) {
+    BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
+    PageData* page = data->page;
+    if (page_data_is_virtual(page)) {
+        // the backend filters virtual lines itself, on INPUT
+        return TRUE;
+    }
+    BlocksModeMatchContext context = {
+        .data = data,
+        .tokens = data->tokens != NULL ? data->tokens : tokens
+    };
+    return match_bitmap_test(data->match_bitmap, data->query_generation, page->lines_generation,
+                             page_data_get_number_of_lines(page), blocks_mode_line_matches,
+                             blocks_mode_line_candidates, &context, selected_line);
 }
 
 static char* blocks_mode_get_message(const Mode* sw) {
@@ -485,11 +930,15 @@ static char* blocks_mode_preprocess_input(Mode* sw, const char* new_input) {
     BlocksModePrivateData* data = mode_get_private_data_extended_mode(sw);
     PageData* page = data->page;
     GString* input = page->input;
+    // rofi preprocesses the input once before each filter pass, and may
+    // tokenize it differently (e.g. case sensitivity) even when it is the same
+    data->query_generation++;
     if (g_strcmp0(input->str, new_input) != 0) {
         g_string_assign(input, new_input);
         blocks_mode_private_data_write_to_channel(data, Event__INPUT, new_input, "");
     }
-    return g_strdup((page->filter == NULL ? input : page->filter)->str);
+    g_string_assign(data->query, (page->filter == NULL ? input : page->filter)->str);
+    return g_strdup(data->query->str);
 }
 
 static void blocks_mode_selection_changed(Mode* sw, unsigned int index, unsigned int relative_index) {
@@ -498,8 +947,16 @@ static void blocks_mode_selection_changed(Mode* sw, unsigned int index, unsigned
         blocks_mode_private_data_write_to_channel(data, Event__SELECT_ENTRY, "", "");
     } else {
         PageData* page = mode_get_private_data_current_page(sw);
+        // lines around the selection of a virtual page are fetched ahead of
+        // scrolling to them
+        request_virtual_lines(data, index);
+        request_virtual_lines(data, index + PAGE_DATA_VIRTUAL_BLOCK_SIZE);
+        if (index >= PAGE_DATA_VIRTUAL_BLOCK_SIZE) {
+            request_virtual_lines(data, index - PAGE_DATA_VIRTUAL_BLOCK_SIZE);
+        }
         LineData* line = page_data_get_line_by_index_or_else(page, index, NULL);
-        blocks_mode_private_data_write_to_channel(data, Event__SELECT_ENTRY, line->text, line->data);
+        blocks_mode_private_data_write_to_channel(data, Event__SELECT_ENTRY,
+                                                  line != NULL ? line->text : "", line != NULL ? line->data : "");
     }
 }
 
@@ -1,85 +1,217 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // Copyright (C) 2020 Omar Castro
 #include "blocks_mode_data.h"
+#include "content_hash.h"
 
+// how long queued events, such as EXIT, may take to be written on destroy
+static const gint EVENT_QUEUE_DRAIN_TIMEOUT_MS = 1000;
 
-static const char* UNDEFINED = "";
-
-
-static void blocks_mode_private_data_update_string(BlocksModePrivateData* data, GString** str, const char* json_root_member, gboolean allow_null) {
-    JsonNode* node = json_object_get_member(data->root, json_root_member);
-    if (node == NULL) {
+static void blocks_mode_private_data_update_string(GString** str, PayloadString* field, gboolean allow_null) {
+    if (!field->present) {
         return;
-    } else if (json_node_is_null(node)) {
+    } else if (field->value == NULL) {
         page_data_set_string_member(str, allow_null ? NULL : "");
-    } else if (json_node_get_value_type(node) == G_TYPE_STRING) {
-        page_data_set_string_member(str, json_node_get_string(node));
+    } else {
+        page_data_set_string_member(str, field->value);
     }
 }
 
-static void blocks_mode_private_data_update_icon(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->icon, "icon", TRUE);
+static void blocks_mode_private_data_update_icon(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->icon, &payload->icon, TRUE);
+}
+
+static void blocks_mode_private_data_update_case_sensitivity(BlocksModePrivateData* data, Payload* payload) {
+    if (payload->case_sensitive.present) {
+        data->page->case_sensitive = payload->case_sensitive.value;
+    }
 }
 
-static void blocks_mode_private_data_update_case_sensitivity(BlocksModePrivateData* data) {
-    data->page->case_sensitive = json_object_get_boolean_member_or_else(
-        data->root, "case_sensitive", data->page->case_sensitive
-    );
+static void blocks_mode_private_data_update_placeholder(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->placeholder, &payload->placeholder, FALSE);
 }
 
-static void blocks_mode_private_data_update_placeholder(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->placeholder, "placeholder", FALSE);
+static void blocks_mode_private_data_update_filter(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->filter, &payload->filter, TRUE);
 }
 
-static void blocks_mode_private_data_update_filter(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->filter, "filter", TRUE);
+static void blocks_mode_private_data_update_message(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->message, &payload->message, TRUE);
 }
 
-static void blocks_mode_private_data_update_message(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->message, "message", TRUE);
+static void blocks_mode_private_data_update_overlay(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->overlay, &payload->overlay, TRUE);
 }
 
-static void blocks_mode_private_data_update_overlay(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->overlay, "overlay", TRUE);
+static void blocks_mode_private_data_update_prompt(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->prompt, &payload->prompt, TRUE);
 }
 
-static void blocks_mode_private_data_update_prompt(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->prompt, "prompt", TRUE);
+static void blocks_mode_private_data_update_input(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->input, &payload->input, FALSE);
+    if (payload->input.present) {
+        data->frame.input_set_by_payload = TRUE;
+    }
 }
 
-static void blocks_mode_private_data_update_input(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->input, "input", FALSE);
+static void blocks_mode_private_data_update_trigger(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_string(&data->page->trigger, &payload->trigger, TRUE);
 }
 
-static void blocks_mode_private_data_update_trigger(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->page->trigger, "trigger", TRUE);
+static void blocks_mode_private_data_update_event_format(BlocksModePrivateData* data, Payload* payload) {
+    if (payload->event_format.present) {
+        const gchar* format = payload->event_format.value;
+        event_format_set(data->event_format, format != NULL ? format : "");
+    }
 }
 
-static void blocks_mode_private_data_update_event_format(BlocksModePrivateData* data) {
-    blocks_mode_private_data_update_string(data, &data->event_format, "event_format", FALSE);
+static void blocks_mode_private_data_update_focus_entry(BlocksModePrivateData* data, Payload* payload) {
+    if (payload->selected_line.present && payload->selected_line.is_integer) {
+        data->entry_to_focus = payload->selected_line.value;
+    }
 }
 
-static void blocks_mode_private_data_update_focus_entry(BlocksModePrivateData* data) {
-    data->entry_to_focus = json_object_get_int_member_or_else(data->root, "selected_line", -1);
+static void blocks_mode_private_data_update_stats(BlocksModePrivateData* data, Payload* payload) {
+    if (payload->stats.present && payload->stats.value) {
+        data->stats_requested = TRUE;
+    }
 }
 
-static void blocks_mode_private_data_update_close_on_child_exit(BlocksModePrivateData* data) {
-    gboolean orig = data->close_on_child_exit;
-    gboolean now = json_object_get_boolean_member_or_else(data->root, "close_on_exit" , orig);
-    data->close_on_child_exit = now;
+static void blocks_mode_private_data_update_close_on_child_exit(BlocksModePrivateData* data, Payload* payload) {
+    if (payload->close_on_exit.present) {
+        data->close_on_child_exit = payload->close_on_exit.value;
+    }
 }
 
-static void blocks_mode_private_data_update_lines(BlocksModePrivateData* data) {
-    JsonObject* root = data->root;
-    PageData* page = data->page;
-    const char* LINES_PROP = "lines";
-    if (json_object_has_member(root, LINES_PROP)) {
-        JsonArray* lines = json_object_get_array_member(data->root, LINES_PROP);
-        page_data_clear_lines(page);
-        size_t len = json_array_get_length(lines);
-        for (int i = 0; i < len; ++i) {
-            page_data_add_line_json_node(page, json_array_get_element(lines, i));
-        }
+// lines_count replaces the lines like a payload with lines would, with lines
+// that are only fetched once shown
+static void blocks_mode_private_data_update_lines_count(BlocksModePrivateData* data, Payload* payload) {
+    if (!payload->lines_count.present) {
+        return;
+    }
+    gint64 count = payload->lines_count.is_integer ? payload->lines_count.value : 0;
+    page_data_set_virtual_lines(data->pending_page, (guint) CLAMP(count, 0, G_MAXUINT));
+    data->pending_lines.start = NULL;
+    data->has_pending_page = TRUE;
+    // the blocks asked for before are of the lines being replaced
+    g_hash_table_remove_all(data->requested_blocks);
+}
+
+// lines with lines_offset are a window of the virtual lines, loaded right
+// away in the page they belong to
+static void blocks_mode_private_data_update_lines_window(BlocksModePrivateData* data, Payload* payload, PageData* built_lines) {
+    PageData* page = data->has_pending_page ? data->pending_page : data->page;
+    if (!page_data_is_virtual(page)) {
+        g_debug("ignoring lines_offset, lines are not virtual");
+        return;
+    }
+    gint64 offset = payload->lines_offset.is_integer ? payload->lines_offset.value : 0;
+    PageData* window = built_lines;
+    if (window == NULL) {
+        window = page_data_new();
+        window->markup_default = data->page->markup_default;
+        payload_build_lines(&payload->lines, window, 0);
+    }
+    guint first = (guint) CLAMP(offset, 0, G_MAXUINT);
+    guint blocks = page_data_set_virtual_window(page, first, window);
+    // loaded blocks are asked for again once evicted; blocks the window only
+    // partly covers stay requested until the next lines_count, as asking
+    // again would only get the same answer
+    guint first_block = ((guint64) first + PAGE_DATA_VIRTUAL_BLOCK_SIZE - 1) / PAGE_DATA_VIRTUAL_BLOCK_SIZE;
+    for (guint b = first_block; b < first_block + blocks; ++b) {
+        g_hash_table_remove(data->requested_blocks, GUINT_TO_POINTER(b));
+    }
+    if (window != built_lines) {
+        page_data_destroy(window);
+    }
+}
+
+// lines are only validated here; a newer payload with lines replaces them
+// before they are ever built. built_lines, when set, are the lines of the
+// payload built beforehand.
+static void blocks_mode_private_data_update_lines(BlocksModePrivateData* data, Payload* payload, PageData* built_lines) {
+    if (payload->lines.start == NULL) {
+        return;
+    }
+    if (data->pending_lines.start != NULL || data->has_pending_page) {
+        g_debug("coalescing lines of a superseded payload");
+        stats_add(&data->stats.payloads_coalesced, 1);
+    }
+    if (payload->lines_offset.present) {
+        blocks_mode_private_data_update_lines_window(data, payload, built_lines);
+        return;
+    }
+    if (built_lines != NULL) {
+        page_data_set_max_lines(data->pending_page, data->page->max_lines);
+        page_data_take_lines(data->pending_page, built_lines);
+        data->pending_lines.start = NULL;
+        data->has_pending_page = TRUE;
+        return;
+    }
+    data->pending_lines = payload->lines;
+    data->has_pending_page = FALSE;
+}
+
+// the file replaces the lines like a payload with lines would, without
+// reading any of them yet
+static void blocks_mode_private_data_update_lines_file(BlocksModePrivateData* data, Payload* payload) {
+    if (!payload->lines_file.present || payload->lines_file.value == NULL) {
+        return;
+    }
+    GError* error = NULL;
+    LinesFile* file = lines_file_open(payload->lines_file.value, &error);
+    if (file == NULL) {
+        fprintf(stderr, "Unable to load lines file: %s\n", error->message);
+        g_error_free(error);
+        return;
+    }
+    PageData* pending_page = data->pending_page;
+    pending_page->markup_default = data->page->markup_default;
+    page_data_set_max_lines(pending_page, data->page->max_lines);
+    page_data_set_lines_file(pending_page, file);
+    data->pending_lines.start = NULL;
+    data->has_pending_page = TRUE;
+}
+
+static void blocks_mode_private_data_update_max_lines(BlocksModePrivateData* data, Payload* payload) {
+    if (!payload->max_lines.present) {
+        return;
+    }
+    page_data_set_max_lines(data->page, payload_get_max_lines(payload));
+}
+
+static void blocks_mode_private_data_update_delay(guint* delay_ms, PayloadInt* field) {
+    if (field->present) {
+        gint64 delay = field->is_integer ? field->value : 0;
+        *delay_ms = (guint) CLAMP(delay, 0, G_MAXUINT);
+    }
+}
+
+static void blocks_mode_private_data_update_event_delays(BlocksModePrivateData* data, Payload* payload) {
+    blocks_mode_private_data_update_delay(&data->delayed_events->input.debounce_ms, &payload->debounce.input);
+    blocks_mode_private_data_update_delay(&data->delayed_events->select_entry.debounce_ms, &payload->debounce.select_entry);
+    blocks_mode_private_data_update_delay(&data->delayed_events->input.throttle_ms, &payload->throttle.input);
+    blocks_mode_private_data_update_delay(&data->delayed_events->select_entry.throttle_ms, &payload->throttle.select_entry);
+}
+
+static void blocks_mode_private_data_update_lines_append(BlocksModePrivateData* data, Payload* payload) {
+    if (payload->lines_append.start == NULL) {
+        return;
+    }
+    // appended lines go after any replaced lines still waiting for the frame
+    blocks_mode_private_data_build_pending_lines(data);
+    PageData* page = data->has_pending_page ? data->pending_page : data->page;
+    guint skip = payload_lines_to_skip(&payload->lines_append, page->max_lines);
+    payload_build_lines(&payload->lines_append, page, skip);
+}
+
+static GString* blocks_mode_frame_copy_string(GString* str) {
+    return str ? g_string_new(str->str) : NULL;
+}
+
+static void blocks_mode_frame_free_string(GString** str) {
+    if (*str) {
+        g_string_free(*str, TRUE);
+        *str = NULL;
     }
 }
 
@@ -89,14 +221,19 @@ BlocksModePrivateData* blocks_mode_private_data_new() {
     BlocksModePrivateData* pd = g_malloc0(sizeof(*pd));
     pd->page = page_data_new();
     pd->page->markup_default = MarkupStatus_UNDEFINED;
-    pd->event_format = g_string_new("{\"event\":\"{{event}}\", \"value\":\"{{value_escaped}}\", \"data\":\"{{data_escaped}}\"}");
+    pd->event_format = event_format_new("{\"event\":\"{{event}}\", \"value\":\"{{value_escaped}}\", \"data\":\"{{data_escaped}}\"}");
     pd->entry_to_focus = -1;
+    pd->protocol = PayloadFormat_JSON;
     pd->tokens = NULL;
+    pd->match_bitmap = match_bitmap_new(0);
+    pd->query = g_string_new(NULL);
     pd->close_on_child_exit = TRUE;
     pd->cmd_pid = 0;
-    pd->buffer = g_string_sized_new(1024);
-    pd->active_line = g_string_sized_new(1024);
-    pd->parser = json_parser_new();
+    pd->pending_page = page_data_new();
+    pd->requested_blocks = g_hash_table_new(g_direct_hash, g_direct_equal);
+    pd->blocks_to_request = g_array_new(FALSE, FALSE, sizeof(guint));
+    stats_init(&pd->stats);
+    pd->stats_reported_at = pd->stats.started;
     return pd;
 }
 
@@ -107,41 +244,233 @@ void blocks_mode_private_data_update_destroy(BlocksModePrivateData* data){
     if (data->read_channel_watcher > 0) {
         g_source_remove(data->read_channel_watcher);
     }
-    if (data->parser) {
-        g_object_unref(data->parser);
-    }
     if (data->tokens) {
         helper_tokenize_free(data->tokens);
     }
+    match_bitmap_destroy(data->match_bitmap);
+    g_string_free(data->query, TRUE);
+    if (data->trigram_index != NULL) {
+        trigram_index_destroy(data->trigram_index);
+    }
+    g_strfreev(data->matched_words);
+    if (data->icon_cache != NULL) {
+        icon_cache_destroy(data->icon_cache);
+    }
+    if (data->icon_retry > 0) {
+        g_source_remove(data->icon_retry);
+    }
+    if (data->frame_timeout > 0) {
+        g_source_remove(data->frame_timeout);
+    }
+    if (data->request_idle > 0) {
+        g_source_remove(data->request_idle);
+    }
+    g_free(data->snapshot_key);
+    g_hash_table_destroy(data->requested_blocks);
+    g_array_free(data->blocks_to_request, TRUE);
+    blocks_mode_private_data_end_frame(data);
+    if (data->delayed_events) {
+        delayed_events_destroy(data->delayed_events);
+    }
+    if (data->payload_reader) {
+        payload_reader_destroy(data->payload_reader);
+    }
+    if (data->line_reader) {
+        line_reader_destroy(data->line_reader);
+    }
     page_data_destroy(data->page);
+    page_data_destroy(data->pending_page);
+    event_format_destroy(data->event_format);
+    if (data->event_queue) {
+        event_queue_drain(data->event_queue, EVENT_QUEUE_DRAIN_TIMEOUT_MS);
+        event_queue_destroy(data->event_queue);
+    }
     close(data->write_channel_fd);
     close(data->read_channel_fd);
-    g_free(data->write_channel);
     g_free(data->read_channel);
+    trace_destroy(data->trace);
     g_free(data);
 }
 
-void blocks_mode_private_data_update_page(BlocksModePrivateData* data){
+void blocks_mode_private_data_update_page(BlocksModePrivateData* data, PayloadFormat format, gchar* text, gsize length){
     GError* error = NULL;
-    if (!json_parser_load_from_data(data->parser, data->active_line->str, data->active_line->len, &error)) {
+    Payload payload;
+    gint64 start = g_get_monotonic_time();
+    gboolean parsed = format == PayloadFormat_MSGPACK
+        ? payload_parse_msgpack(&payload, text, length, &error)
+        : payload_parse_json(&payload, text, length, &error);
+    stats_add_parse_time(&data->stats, g_get_monotonic_time() - start);
+    trace_end(data->trace, "parse", start, "\"bytes\":%zu", length);
+    data->payload_repeatable = FALSE;
+    if (!parsed) {
         fprintf(stderr, "Unable to parse line: %s\n", error->message);
         g_error_free(error);
         return;
     }
+    data->payload_repeatable = payload_is_idempotent(&payload);
+    start = trace_begin(data->trace);
+    blocks_mode_private_data_apply_payload(data, &payload, NULL);
+    trace_end(data->trace, "apply_payload", start, NULL);
+}
+
+// the first payload replaces the lines and message of the snapshot, even
+// when it does not set them
+static void blocks_mode_private_data_drop_snapshot(BlocksModePrivateData* data) {
+    if (!data->showing_snapshot) {
+        return;
+    }
+    data->showing_snapshot = FALSE;
+    page_data_set_message(data->page, NULL);
+    page_data_clear_lines(data->pending_page);
+    data->pending_lines.start = NULL;
+    data->has_pending_page = TRUE;
+}
+
+void blocks_mode_private_data_apply_payload(BlocksModePrivateData* data, Payload* payload, PageData* built_lines) {
+    blocks_mode_private_data_drop_snapshot(data);
+    blocks_mode_private_data_update_trigger(data, payload);
+    blocks_mode_private_data_update_icon(data, payload);
+    blocks_mode_private_data_update_case_sensitivity(data, payload);
+    blocks_mode_private_data_update_placeholder(data, payload);
+    blocks_mode_private_data_update_filter(data, payload);
+    blocks_mode_private_data_update_message(data, payload);
+    blocks_mode_private_data_update_overlay(data, payload);
+    blocks_mode_private_data_update_input(data, payload);
+    blocks_mode_private_data_update_prompt(data, payload);
+    blocks_mode_private_data_update_close_on_child_exit(data, payload);
+    blocks_mode_private_data_update_event_format(data, payload);
+    blocks_mode_private_data_update_event_delays(data, payload);
+    blocks_mode_private_data_update_max_lines(data, payload);
+    blocks_mode_private_data_update_lines_count(data, payload);
+    blocks_mode_private_data_update_lines(data, payload, built_lines);
+    blocks_mode_private_data_update_lines_file(data, payload);
+    blocks_mode_private_data_update_lines_append(data, payload);
+    blocks_mode_private_data_update_focus_entry(data, payload);
+    blocks_mode_private_data_update_stats(data, payload);
+}
+
+gboolean blocks_mode_private_data_is_repeated_payload(BlocksModePrivateData* data, const gchar* text, gsize length) {
+    guint64 hash = content_hash(text, length, 0);
+    gboolean repeated = data->payload_repeatable && data->payload_hash == hash && data->payload_length == length;
+    data->payload_hash = hash;
+    data->payload_length = length;
+    stats_add(&data->stats.payloads_received, 1);
+    stats_add(&data->stats.bytes_read, length);
+    if (repeated) {
+        stats_add(&data->stats.payloads_coalesced, 1);
+    }
+    return repeated;
+}
+
+// Builds the lines of the newest payload into the pending page. Must run
+// before the buffer holding the payloads is reused.
+void blocks_mode_private_data_build_pending_lines(BlocksModePrivateData* data) {
+    if (data->pending_lines.start == NULL) {
+        return;
+    }
+    PageData* pending_page = data->pending_page;
+    page_data_clear_lines(pending_page);
+    pending_page->markup_default = data->page->markup_default;
+    page_data_set_max_lines(pending_page, data->page->max_lines);
+    guint skip = payload_lines_to_skip(&data->pending_lines, data->page->max_lines);
+    gint64 start = trace_begin(data->trace);
+    payload_build_lines(&data->pending_lines, pending_page, skip);
+    trace_end(data->trace, "build_lines", start, "\"lines\":%zu", page_data_get_number_of_lines(pending_page));
+    data->has_pending_page = TRUE;
+}
+
+gboolean blocks_mode_private_data_request_block(BlocksModePrivateData* data, guint index) {
+    guint block = index / PAGE_DATA_VIRTUAL_BLOCK_SIZE;
+    if (g_hash_table_contains(data->requested_blocks, GUINT_TO_POINTER(block))) {
+        return FALSE;
+    }
+    g_hash_table_add(data->requested_blocks, GUINT_TO_POINTER(block));
+    g_array_append_val(data->blocks_to_request, block);
+    return TRUE;
+}
+
+gboolean blocks_mode_private_data_apply_pending_lines(BlocksModePrivateData* data) {
+    blocks_mode_private_data_build_pending_lines(data);
+    if (!data->has_pending_page) {
+        return FALSE;
+    }
+    data->has_pending_page = FALSE;
+    PageData* page = data->page;
+    PageData* pending_page = data->pending_page;
+    gint64 start = trace_begin(data->trace);
+    GArray* previous = g_array_new(FALSE, FALSE, sizeof(guint));
+    gboolean changed = !page_data_match_lines(page, pending_page, previous);
+    if (changed) {
+        guint64 lines_generation = page->lines_generation;
+        page_data_take_lines(page, pending_page);
+        // lines that did not change keep their match results, to only match
+        // the others again when the query stays the same
+        match_bitmap_remap(data->match_bitmap, lines_generation, page->lines_generation,
+                           (const guint*) previous->data, previous->len);
+    } else {
+        g_debug("lines did not change, keeping them");
+        page_data_clear_lines(pending_page);
+    }
+    g_array_free(previous, TRUE);
+    trace_end(data->trace, "apply_lines", start, "\"lines\":%zu, \"changed\":%s",
+              page_data_get_number_of_lines(page), changed ? "true" : "false");
+    return changed;
+}
+
+void blocks_mode_private_data_begin_frame(BlocksModePrivateData* data) {
+    BlocksModeFrame* frame = &data->frame;
+    if (frame->open) {
+        return;
+    }
+    PageData* page = data->page;
+    frame->overlay = blocks_mode_frame_copy_string(page->overlay);
+    frame->prompt = blocks_mode_frame_copy_string(page->prompt);
+    frame->placeholder = blocks_mode_frame_copy_string(page->placeholder);
+    frame->icon = blocks_mode_frame_copy_string(page->icon);
+    frame->input = blocks_mode_frame_copy_string(page->input);
+    frame->filter = blocks_mode_frame_copy_string(page->filter);
+    frame->message = blocks_mode_frame_copy_string(page->message);
+    frame->case_sensitive = page->case_sensitive;
+    frame->lines_generation = page->lines_generation;
+    frame->open = TRUE;
+    data->entry_to_focus = -1;
+}
+
+void blocks_mode_private_data_end_frame(BlocksModePrivateData* data) {
+    BlocksModeFrame* frame = &data->frame;
+    blocks_mode_frame_free_string(&frame->overlay);
+    blocks_mode_frame_free_string(&frame->prompt);
+    blocks_mode_frame_free_string(&frame->placeholder);
+    blocks_mode_frame_free_string(&frame->icon);
+    blocks_mode_frame_free_string(&frame->input);
+    blocks_mode_frame_free_string(&frame->filter);
+    blocks_mode_frame_free_string(&frame->message);
+    frame->input_set_by_payload = FALSE;
+    frame->open = FALSE;
+}
+
+gchar* blocks_mode_private_data_format_stats(BlocksModePrivateData* data) {
+    gint64 now = g_get_monotonic_time();
+    guint64 matched_lines = stats_get(&data->match_bitmap->matched_lines);
+    gdouble elapsed = MAX(now - data->stats_reported_at, 1) / (gdouble) G_USEC_PER_SEC;
+    gdouble match_rate = (matched_lines - data->stats_reported_matched_lines) / elapsed;
+    data->stats_reported_at = now;
+    data->stats_reported_matched_lines = matched_lines;
+    // rofi sets the locale, whose decimal separator may not be a dot
+    gchar match_rate_text[G_ASCII_DTOSTR_BUF_SIZE];
+    g_ascii_formatd(match_rate_text, sizeof(match_rate_text), "%.1f", match_rate);
 
-    data->root = json_node_get_object(json_parser_get_root(data->parser));
-
-    blocks_mode_private_data_update_trigger(data);
-    blocks_mode_private_data_update_icon(data);
-    blocks_mode_private_data_update_case_sensitivity(data);
-    blocks_mode_private_data_update_placeholder(data);
-    blocks_mode_private_data_update_filter(data);
-    blocks_mode_private_data_update_message(data);
-    blocks_mode_private_data_update_overlay(data);
-    blocks_mode_private_data_update_input(data);
-    blocks_mode_private_data_update_prompt(data);
-    blocks_mode_private_data_update_close_on_child_exit(data);
-    blocks_mode_private_data_update_event_format(data);
-    blocks_mode_private_data_update_lines(data);
-    blocks_mode_private_data_update_focus_entry(data);
+    EventQueue* queue = data->event_queue;
+    GString* result = g_string_new("{");
+    stats_append_json(&data->stats, result);
+    g_string_append_printf(result,
+        ", \"lines\":%zu, \"page_bytes\":%zu, \"match_calls\":%" G_GUINT64_FORMAT ", \"match_calls_per_second\":%s"
+        ", \"events_sent\":%" G_GUINT64_FORMAT ", \"events_dropped\":%" G_GUINT64_FORMAT
+        ", \"queue_depth\":%u, \"queue_peak_depth\":%u}",
+        page_data_get_number_of_lines(data->page),
+        page_data_get_memory_size(data->page) + page_data_get_memory_size(data->pending_page),
+        matched_lines, match_rate_text,
+        queue != NULL ? queue->sent : 0, queue != NULL ? queue->dropped : 0,
+        queue != NULL ? event_queue_get_depth(queue) : 0, queue != NULL ? queue->peak_depth : 0);
+    return g_string_free(result, FALSE);
 }
@@ -12,29 +12,89 @@
 #include <time.h>
 
 #include <glib-object.h>
-#include <json-glib/json-glib.h>
 #include <rofi/rofi-types.h>
 #include <rofi/helper.h>
 
 #include "string_utils.h"
 #include "page_data.h"
-#include "json_glib_extensions.h"
+#include "line_reader.h"
+#include "payload.h"
+#include "event_format.h"
+#include "event_queue.h"
+#include "delayed_events.h"
+#include "match_bitmap.h"
+#include "trigram_index.h"
+#include "icon_cache.h"
+#include "payload_reader.h"
+#include "page_snapshot.h"
+#include "trace.h"
+#include "stats.h"
+
+// view related page state as it was when the current frame started; the view
+// is updated from the difference once the frame is flushed
+typedef struct {
+    gboolean open;
+    GString* overlay;
+    GString* prompt;
+    GString* placeholder;
+    GString* icon;
+    GString* input;
+    GString* filter;
+    GString* message;
+    gboolean case_sensitive;
+    guint64 lines_generation;
+    // the input is only pushed to the view when a payload set it, as the
+    // user typing during the frame also changes it
+    gboolean input_set_by_payload;
+} BlocksModeFrame;
 
 typedef struct {
     PageData* page;
-    GString* event_format;
+    EventFormat* event_format;
     gint64 entry_to_focus;
     rofi_int_matcher **tokens;
+    MatchBitmap* match_bitmap;
+    guint64 query_generation; // changes with every filter pass of rofi
+    GString* query; // text rofi tokenized for the current filter pass
+    TrigramIndex* trigram_index; // NULL unless enabled with -blocks-index
+    guint64 trigram_index_reset_generation;
+    guint64 trigram_index_evicted; // page lines_evicted when last indexed
+    gchar** matched_words; // of the query the match bitmap was computed for
+    gboolean matched_caseless;
+    IconCache* icon_cache;
+    guint icon_retry;          // timeout setting the prompt icon again
+    guint icon_retry_attempts;
 
-    JsonParser* parser;
-    JsonObject* root;
     GError* error;
-    GString* active_line;
-    GString* buffer;
-    
+    LineReader* line_reader;
+    PayloadReader* payload_reader; // reads instead of line_reader, with -blocks-reader-thread
+    PayloadLines pending_lines;
+    PageData* pending_page;
+    gboolean has_pending_page;
+    guint64 payload_hash;        // of the last payload received
+    gsize payload_length;
+    gboolean payload_repeatable; // whether receiving it again changes nothing
+    GHashTable* requested_blocks; // of virtual lines asked for, not received yet
+    GArray* blocks_to_request;    // of guint, in the next FETCH_LINES events
+    guint request_idle;
+    gchar* snapshot_key;        // of the page saved on exit, with -blocks-snapshot
+    gboolean showing_snapshot;  // until the first payload replaces it
+    Trace* trace;               // NULL unless enabled with -blocks-trace
+    Stats stats;
+    gboolean stats_requested;   // by a payload, sent with the next frame
+    gint64 stats_reported_at;   // when the previous STATS event was sent
+    guint64 stats_reported_matched_lines;
+
+    BlocksModeFrame frame;
+    guint max_fps;
+    gint64 last_frame_time;
+    guint frame_timeout;
+
+    PayloadFormat protocol;
     GPid cmd_pid;
     gboolean close_on_child_exit;
-    GIOChannel* write_channel;
+    EventQueue* event_queue;
+    DelayedEvents* delayed_events;
     GIOChannel* read_channel;
     int write_channel_fd;
     int read_channel_fd;
@@ -45,7 +105,34 @@ BlocksModePrivateData* blocks_mode_private_data_new();
 
 void blocks_mode_private_data_update_destroy(BlocksModePrivateData* data);
 
-void blocks_mode_private_data_update_page(BlocksModePrivateData* data);
+// Parses a payload in the given format, and applies it to the page
+void blocks_mode_private_data_update_page(BlocksModePrivateData* data, PayloadFormat format, gchar* text, gsize length);
+
+// Applies a parsed payload to the page. built_lines, when set, holds its
+// lines already built, and is left empty.
+void blocks_mode_private_data_apply_payload(BlocksModePrivateData* data, Payload* payload, PageData* built_lines);
+
+// Whether text is the same payload as the previous one, and applying it
+// again would change nothing
+gboolean blocks_mode_private_data_is_repeated_payload(BlocksModePrivateData* data, const gchar* text, gsize length);
+
+void blocks_mode_private_data_build_pending_lines(BlocksModePrivateData* data);
+
+// Queues the block of virtual lines holding index to be fetched, unless it
+// already was. Returns whether it was queued.
+gboolean blocks_mode_private_data_request_block(BlocksModePrivateData* data, guint index);
+
+// Replaces the lines with the pending ones, unless they are the same.
+// Returns whether the lines changed.
+gboolean blocks_mode_private_data_apply_pending_lines(BlocksModePrivateData* data);
+
+void blocks_mode_private_data_begin_frame(BlocksModePrivateData* data);
+
+void blocks_mode_private_data_end_frame(BlocksModePrivateData* data);
+
+// Value of a STATS event: the counters as a JSON object. Rates are since the
+// previous call.
+gchar* blocks_mode_private_data_format_stats(BlocksModePrivateData* data);
 
 #endif // ROFI_BLOCKS_MODE_DATA_H
 
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <string.h>
+#include "content_hash.h"
+
+// constants and mixing of xxhash64, hashing one 8 byte word at a time
+static const guint64 PRIME_1 = G_GUINT64_CONSTANT(0x9e3779b185ebca87);
+static const guint64 PRIME_2 = G_GUINT64_CONSTANT(0xc2b2ae3d27d4eb4f);
+static const guint64 PRIME_3 = G_GUINT64_CONSTANT(0x165667b19e3779f9);
+
+static guint64 rotate_left(guint64 value, guint bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static guint64 content_hash_round(guint64 hash, guint64 word) {
+    word *= PRIME_2;
+    word = rotate_left(word, 31);
+    word *= PRIME_1;
+    hash ^= word;
+    return rotate_left(hash, 27) * PRIME_1 + PRIME_3;
+}
+
+guint64 content_hash(gconstpointer data, gsize length, guint64 seed) {
+    const guint8* bytes = data;
+    guint64 hash = seed + PRIME_3 + length * PRIME_1;
+    for (; length >= sizeof(guint64); length -= sizeof(guint64), bytes += sizeof(guint64)) {
+        guint64 word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = content_hash_round(hash, word);
+    }
+    if (length > 0) {
+        guint64 word = 0;
+        memcpy(&word, bytes, length);
+        hash = content_hash_round(hash, word);
+    }
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+guint64 content_hash_string(const gchar* string, guint64 seed) {
+    if (string == NULL) {
+        return content_hash_round(seed, PRIME_2);
+    }
+    return content_hash(string, strlen(string), seed);
+}
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_CONTENT_HASH_H
+#define ROFI_BLOCKS_CONTENT_HASH_H
+#include <gmodule.h>
+
+// 64 bit hash of length bytes, to tell whether contents changed. Hashes of
+// several pieces are chained by passing the previous one as seed. Values
+// are only meaningful within the process.
+guint64 content_hash(gconstpointer data, gsize length, guint64 seed);
+
+// hash of a string that may be NULL, which hashes differently from ""
+guint64 content_hash_string(const gchar* string, guint64 seed);
+
+#endif // ROFI_BLOCKS_CONTENT_HASH_H
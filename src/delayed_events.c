@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "delayed_events.h"
+
+static const gchar* EMPTY_STRING = "";
+
+static void delayed_event_init(DelayedEvent* delayed, DelayedEvents* events, gint kind) {
+    delayed->kind = kind;
+    delayed->value = g_string_new(NULL);
+    delayed->data = g_string_new(NULL);
+    delayed->events = events;
+}
+
+static void delayed_event_clear(DelayedEvent* delayed) {
+    if (delayed->timeout > 0) {
+        g_source_remove(delayed->timeout);
+    }
+    g_string_free(delayed->value, TRUE);
+    g_string_free(delayed->data, TRUE);
+}
+
+static DelayedEvent* delayed_events_get(DelayedEvents* events, gint kind) {
+    if (kind == events->input.kind) {
+        return &events->input;
+    }
+    if (kind == events->select_entry.kind) {
+        return &events->select_entry;
+    }
+    return NULL;
+}
+
+static void delayed_event_send(DelayedEvent* delayed) {
+    if (delayed->timeout > 0) {
+        g_source_remove(delayed->timeout);
+        delayed->timeout = 0;
+    }
+    if (!delayed->pending) {
+        return;
+    }
+    delayed->pending = FALSE;
+    delayed->last_sent = g_get_monotonic_time();
+    DelayedEvents* events = delayed->events;
+    events->send(delayed->kind, delayed->value->str, delayed->data->str, events->context);
+}
+
+static gboolean on_delayed_event_timeout(gpointer context) {
+    DelayedEvent* delayed = context;
+    delayed->timeout = 0;
+    delayed_event_send(delayed);
+    return G_SOURCE_REMOVE;
+}
+
+DelayedEvents* delayed_events_new(gint input_kind, gint select_entry_kind, DelayedEventsSendFunc send, gpointer context) {
+    DelayedEvents* events = g_malloc0(sizeof(*events));
+    delayed_event_init(&events->input, events, input_kind);
+    delayed_event_init(&events->select_entry, events, select_entry_kind);
+    events->send = send;
+    events->context = context;
+    return events;
+}
+
+void delayed_events_destroy(DelayedEvents* events) {
+    delayed_event_clear(&events->input);
+    delayed_event_clear(&events->select_entry);
+    g_free(events);
+}
+
+void delayed_events_flush(DelayedEvents* events) {
+    gboolean input_first = events->input.last_update <= events->select_entry.last_update;
+    delayed_event_send(input_first ? &events->input : &events->select_entry);
+    delayed_event_send(input_first ? &events->select_entry : &events->input);
+}
+
+void delayed_events_send(DelayedEvents* events, gint kind, const gchar* value, const gchar* data) {
+    events->send(kind, value, data, events->context);
+}
+
+void delayed_events_push(DelayedEvents* events, gint kind, const gchar* value, const gchar* data) {
+    DelayedEvent* delayed = delayed_events_get(events, kind);
+    if (delayed == NULL) {
+        delayed_events_flush(events);
+        events->send(kind, value, data, events->context);
+        return;
+    }
+    gint64 now = g_get_monotonic_time();
+    if (delayed->debounce_ms == 0 && delayed->throttle_ms == 0 && !delayed->pending) {
+        delayed->last_sent = now;
+        delayed->last_update = now;
+        events->send(kind, value, data, events->context);
+        return;
+    }
+
+    if (!delayed->pending) {
+        delayed->pending = TRUE;
+        delayed->pending_since = now;
+    }
+    delayed->last_update = now;
+    g_string_assign(delayed->value, value != NULL ? value : EMPTY_STRING);
+    g_string_assign(delayed->data, data != NULL ? data : EMPTY_STRING);
+
+    // debounce waits for events to stop for a while, throttle sends them at
+    // most once per interval; with both, throttle bounds the debounce wait
+    gint64 deadline;
+    if (delayed->debounce_ms > 0) {
+        deadline = now + delayed->debounce_ms * G_TIME_SPAN_MILLISECOND;
+        if (delayed->throttle_ms > 0) {
+            deadline = MIN(deadline, delayed->pending_since + delayed->throttle_ms * G_TIME_SPAN_MILLISECOND);
+        }
+    } else {
+        deadline = MAX(now, delayed->last_sent + delayed->throttle_ms * G_TIME_SPAN_MILLISECOND);
+    }
+    if (deadline <= now) {
+        delayed_event_send(delayed);
+        return;
+    }
+    if (delayed->timeout > 0) {
+        g_source_remove(delayed->timeout);
+    }
+    guint interval_ms = (deadline - now + G_TIME_SPAN_MILLISECOND - 1) / G_TIME_SPAN_MILLISECOND;
+    delayed->timeout = g_timeout_add(interval_ms, on_delayed_event_timeout, delayed);
+}
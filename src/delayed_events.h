@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_DELAYED_EVENTS_H
+#define ROFI_BLOCKS_DELAYED_EVENTS_H
+#include <gmodule.h>
+
+typedef void (*DelayedEventsSendFunc)(gint kind, const gchar* value, const gchar* data, gpointer context);
+
+typedef struct DelayedEvents DelayedEvents;
+
+// An event that newer ones of the same kind supersede, delivered once its
+// debounce or throttle delay passed. Only the newest value is kept.
+typedef struct {
+    gint kind;
+    guint debounce_ms;
+    guint throttle_ms;
+    guint timeout;
+    gboolean pending;
+    gint64 pending_since;   // when the first of the pending events happened
+    gint64 last_update;     // when the newest of the pending events happened
+    gint64 last_sent;
+    GString* value;
+    GString* data;
+    DelayedEvents* events;  // owning the event, for its timeout
+} DelayedEvent;
+
+// Holds back the INPUT and SELECT_ENTRY events of the user until their
+// delays passed, without letting later user actions overtake them
+struct DelayedEvents {
+    DelayedEvent input;
+    DelayedEvent select_entry;
+    DelayedEventsSendFunc send;
+    gpointer context;
+};
+
+DelayedEvents* delayed_events_new(gint input_kind, gint select_entry_kind, DelayedEventsSendFunc send, gpointer context);
+
+void delayed_events_destroy(DelayedEvents* events);
+
+// Delays an INPUT or SELECT_ENTRY event; any other user action first sends
+// the pending ones, such as the INPUT an ACCEPT_CUSTOM was typed with
+void delayed_events_push(DelayedEvents* events, gint kind, const gchar* value, const gchar* data);
+
+// Sends an event that is not a user action (e.g. FETCH_LINES) right away,
+// pending ones stay pending until their delays passed
+void delayed_events_send(DelayedEvents* events, gint kind, const gchar* value, const gchar* data);
+
+// Sends the pending events in the order they happened
+void delayed_events_flush(DelayedEvents* events);
+
+#endif // ROFI_BLOCKS_DELAYED_EVENTS_H
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "event_format.h"
+#include "string_utils.h"
+#include <string.h>
+
+typedef struct {
+    const gchar* name;
+    EventFormatSegmentType type;
+} EventFormatParameter;
+
+static const EventFormatParameter EVENT_FORMAT_PARAMETERS[] = {
+    { "{{event}}", EventFormatSegment_EVENT },
+    { "{{value}}", EventFormatSegment_VALUE },
+    { "{{value_escaped}}", EventFormatSegment_VALUE_ESCAPED },
+    { "{{data}}", EventFormatSegment_DATA },
+    { "{{data_escaped}}", EventFormatSegment_DATA_ESCAPED },
+};
+
+static void event_format_add_segment(EventFormat* event_format, EventFormatSegmentType type, gsize offset, gsize length) {
+    if (type == EventFormatSegment_LITERAL && length == 0) {
+        return;
+    }
+    EventFormatSegment segment = { .type = type, .offset = offset, .length = length };
+    g_array_append_val(event_format->segments, segment);
+}
+
+static void event_format_compile(EventFormat* event_format) {
+    const gchar* format = event_format->format;
+    gsize literal_start = 0;
+    const gchar* cursor = format;
+    while ((cursor = strstr(cursor, "{{")) != NULL) {
+        const EventFormatParameter* parameter = NULL;
+        for (gsize i = 0; i < G_N_ELEMENTS(EVENT_FORMAT_PARAMETERS); ++i) {
+            const gchar* name = EVENT_FORMAT_PARAMETERS[i].name;
+            if (strncmp(cursor, name, strlen(name)) == 0) {
+                parameter = &EVENT_FORMAT_PARAMETERS[i];
+                break;
+            }
+        }
+        if (parameter == NULL) {
+            // not a parameter, kept as literal text
+            cursor += 2;
+            continue;
+        }
+        gsize offset = cursor - format;
+        event_format_add_segment(event_format, EventFormatSegment_LITERAL, literal_start, offset - literal_start);
+        event_format_add_segment(event_format, parameter->type, 0, 0);
+        cursor += strlen(parameter->name);
+        literal_start = cursor - format;
+    }
+    event_format_add_segment(event_format, EventFormatSegment_LITERAL, literal_start, strlen(format) - literal_start);
+}
+
+static void event_format_append_escaped(GString* output, const gchar* str) {
+    gsize length = strlen(str);
+    gsize start = output->len;
+    g_string_set_size(output, start + str_escaped_for_json_string_length(str, length));
+    str_escape_for_json_string_into(str, length, output->str + start);
+}
+
+static void event_format_append_msgpack_uint(GString* output, guint64 value, guint bytes) {
+    for (guint i = bytes; i > 0; --i) {
+        g_string_append_c(output, (gchar) ((value >> ((i - 1) * 8)) & 0xff));
+    }
+}
+
+static void event_format_append_msgpack_str(GString* output, const gchar* str) {
+    gsize length = strlen(str);
+    if (length < 32) {
+        g_string_append_c(output, (gchar) (0xa0 | length));
+    } else if (length <= G_MAXUINT8) {
+        g_string_append_c(output, (gchar) 0xd9);
+        event_format_append_msgpack_uint(output, length, 1);
+    } else if (length <= G_MAXUINT16) {
+        g_string_append_c(output, (gchar) 0xda);
+        event_format_append_msgpack_uint(output, length, 2);
+    } else {
+        g_string_append_c(output, (gchar) 0xdb);
+        event_format_append_msgpack_uint(output, length, 4);
+    }
+    g_string_append_len(output, str, length);
+}
+
+EventFormat* event_format_new(const gchar* format) {
+    EventFormat* event_format = g_malloc0(sizeof(*event_format));
+    event_format->segments = g_array_new(FALSE, FALSE, sizeof(EventFormatSegment));
+    event_format->output = g_string_sized_new(256);
+    event_format_set(event_format, format);
+    return event_format;
+}
+
+void event_format_destroy(EventFormat* event_format) {
+    g_free(event_format->format);
+    g_array_free(event_format->segments, TRUE);
+    g_string_free(event_format->output, TRUE);
+    g_free(event_format);
+}
+
+void event_format_set(EventFormat* event_format, const gchar* format) {
+    if (event_format->format != NULL && g_strcmp0(event_format->format, format) == 0) {
+        return;
+    }
+    g_free(event_format->format);
+    event_format->format = g_strdup(format);
+    g_array_set_size(event_format->segments, 0);
+    event_format_compile(event_format);
+}
+
+GString* event_format_render(EventFormat* event_format, const gchar* event, const gchar* value, const gchar* data) {
+    value = value != NULL ? value : "";
+    data = data != NULL ? data : "";
+    GString* output = event_format->output;
+    g_string_set_size(output, 0);
+    GArray* segments = event_format->segments;
+    for (guint i = 0; i < segments->len; ++i) {
+        EventFormatSegment* segment = &g_array_index(segments, EventFormatSegment, i);
+        switch (segment->type) {
+        case EventFormatSegment_LITERAL:
+            g_string_append_len(output, event_format->format + segment->offset, segment->length);
+            break;
+        case EventFormatSegment_EVENT:
+            g_string_append(output, event);
+            break;
+        case EventFormatSegment_VALUE:
+            g_string_append(output, value);
+            break;
+        case EventFormatSegment_VALUE_ESCAPED:
+            event_format_append_escaped(output, value);
+            break;
+        case EventFormatSegment_DATA:
+            g_string_append(output, data);
+            break;
+        case EventFormatSegment_DATA_ESCAPED:
+            event_format_append_escaped(output, data);
+            break;
+        }
+    }
+    return output;
+}
+
+GString* event_format_render_msgpack(EventFormat* event_format, const gchar* event, const gchar* value, const gchar* data) {
+    GString* output = event_format->output;
+    g_string_set_size(output, EVENT_FORMAT_FRAME_HEADER_SIZE);
+    g_string_append_c(output, (gchar) 0x83); // map of 3 members
+    event_format_append_msgpack_str(output, "event");
+    event_format_append_msgpack_str(output, event);
+    event_format_append_msgpack_str(output, "value");
+    event_format_append_msgpack_str(output, value != NULL ? value : "");
+    event_format_append_msgpack_str(output, "data");
+    event_format_append_msgpack_str(output, data != NULL ? data : "");
+
+    guint32 length = output->len - EVENT_FORMAT_FRAME_HEADER_SIZE;
+    for (guint i = 0; i < EVENT_FORMAT_FRAME_HEADER_SIZE; ++i) {
+        output->str[i] = (gchar) ((length >> ((EVENT_FORMAT_FRAME_HEADER_SIZE - 1 - i) * 8)) & 0xff);
+    }
+    return output;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_EVENT_FORMAT_H
+#define ROFI_BLOCKS_EVENT_FORMAT_H
+#include <gmodule.h>
+
+// bytes of the big endian length before every frame of the msgpack protocol
+#define EVENT_FORMAT_FRAME_HEADER_SIZE 4
+
+typedef enum {
+    EventFormatSegment_LITERAL,
+    EventFormatSegment_EVENT,
+    EventFormatSegment_VALUE,
+    EventFormatSegment_VALUE_ESCAPED,
+    EventFormatSegment_DATA,
+    EventFormatSegment_DATA_ESCAPED
+} EventFormatSegmentType;
+
+typedef struct {
+    EventFormatSegmentType type;
+    gsize offset; // literal text position in the format
+    gsize length;
+} EventFormatSegment;
+
+// An event format split into literal text and {{parameter}} segments once,
+// so that events are rendered in a single pass into a reused buffer
+typedef struct {
+    gchar* format;
+    GArray* segments;
+    GString* output;
+} EventFormat;
+
+EventFormat* event_format_new(const gchar* format);
+
+void event_format_destroy(EventFormat* event_format);
+
+void event_format_set(EventFormat* event_format, const gchar* format);
+
+// Result is owned by event_format and valid until the next render
+GString* event_format_render(EventFormat* event_format, const gchar* event, const gchar* value, const gchar* data);
+
+// Renders the event as a frame of the msgpack protocol, a map with event,
+// value and data members after its big endian length. The format is not used.
+GString* event_format_render_msgpack(EventFormat* event_format, const gchar* event, const gchar* value, const gchar* data);
+
+#endif // ROFI_BLOCKS_EVENT_FORMAT_H
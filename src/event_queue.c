@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "event_queue.h"
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+// events written with a single writev call
+#define EVENT_QUEUE_MAX_IOV 64
+
+static QueuedEvent* queued_event_new(const gchar* text, gsize length, gint kind, gboolean droppable) {
+    QueuedEvent* event = g_malloc(sizeof(*event));
+    event->text = g_string_new_len(text, length);
+    event->kind = kind;
+    event->droppable = droppable;
+    return event;
+}
+
+static void queued_event_free(gpointer pointer) {
+    QueuedEvent* event = pointer;
+    g_string_free(event->text, TRUE);
+    g_free(event);
+}
+
+static void event_queue_remove_watch(EventQueue* queue) {
+    if (queue->watch > 0) {
+        g_source_remove(queue->watch);
+        queue->watch = 0;
+    }
+}
+
+static void event_queue_close(EventQueue* queue) {
+    queue->closed = TRUE;
+    queue->dropped += g_queue_get_length(queue->events);
+    while (!g_queue_is_empty(queue->events)) {
+        queued_event_free(g_queue_pop_head(queue->events));
+    }
+    queue->head_written = 0;
+    event_queue_remove_watch(queue);
+}
+
+static gboolean on_event_queue_writable(GIOChannel* source, GIOCondition condition, gpointer context) {
+    EventQueue* queue = (EventQueue*) context;
+    return event_queue_flush(queue) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static void event_queue_drop_link(EventQueue* queue, GList* link) {
+    QueuedEvent* event = link->data;
+    g_debug("dropping stale queued event of kind %d", event->kind);
+    queued_event_free(event);
+    g_queue_delete_link(queue->events, link);
+    queue->dropped++;
+}
+
+// the oldest event can only be dropped before it is partially written
+static gboolean event_queue_is_link_droppable(EventQueue* queue, GList* link) {
+    QueuedEvent* event = link->data;
+    return event->droppable && (link != queue->events->head || queue->head_written == 0);
+}
+
+// drops the queued event the new one supersedes, never crossing an event
+// that cannot be dropped, so that ordering between them is kept
+static void event_queue_drop_superseded(EventQueue* queue, gint kind) {
+    for (GList* link = queue->events->tail; link != NULL; link = link->prev) {
+        QueuedEvent* event = link->data;
+        if (!event->droppable) {
+            return;
+        }
+        if (event->kind == kind && event_queue_is_link_droppable(queue, link)) {
+            event_queue_drop_link(queue, link);
+            return;
+        }
+    }
+}
+
+static gboolean event_queue_drop_oldest_droppable(EventQueue* queue) {
+    for (GList* link = queue->events->head; link != NULL; link = link->next) {
+        if (event_queue_is_link_droppable(queue, link)) {
+            event_queue_drop_link(queue, link);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+EventQueue* event_queue_new(int fd, guint max_events) {
+    EventQueue* queue = g_malloc0(sizeof(*queue));
+    queue->fd = fd;
+    queue->max_events = max_events;
+    queue->events = g_queue_new();
+    queue->channel = g_io_channel_unix_new(fd);
+    return queue;
+}
+
+void event_queue_destroy(EventQueue* queue) {
+    g_debug("event queue: %" G_GUINT64_FORMAT " sent, %" G_GUINT64_FORMAT " dropped, peak depth %u",
+            queue->sent, queue->dropped, queue->peak_depth);
+    event_queue_remove_watch(queue);
+    g_queue_free_full(queue->events, queued_event_free);
+    g_io_channel_unref(queue->channel);
+    g_free(queue);
+}
+
+void event_queue_push(EventQueue* queue, const gchar* text, gsize length, gint kind, gboolean droppable) {
+    if (queue->closed) {
+        return;
+    }
+    if (droppable) {
+        event_queue_drop_superseded(queue, kind);
+    }
+    if (g_queue_get_length(queue->events) >= queue->max_events && !event_queue_drop_oldest_droppable(queue)) {
+        if (droppable) {
+            g_debug("event queue full, dropping event of kind %d", kind);
+            queue->dropped++;
+            return;
+        }
+        // events that cannot be dropped are queued past the limit
+    }
+    g_queue_push_tail(queue->events, queued_event_new(text, length, kind, droppable));
+    queue->peak_depth = MAX(queue->peak_depth, g_queue_get_length(queue->events));
+    if (queue->watch == 0) {
+        event_queue_flush(queue);
+    }
+}
+
+gboolean event_queue_flush(EventQueue* queue) {
+    while (!queue->closed && !g_queue_is_empty(queue->events)) {
+        struct iovec iov[EVENT_QUEUE_MAX_IOV];
+        int iov_count = 0;
+        for (GList* link = queue->events->head; link != NULL && iov_count < EVENT_QUEUE_MAX_IOV; link = link->next) {
+            GString* text = ((QueuedEvent*) link->data)->text;
+            gsize offset = iov_count == 0 ? queue->head_written : 0;
+            iov[iov_count].iov_base = text->str + offset;
+            iov[iov_count].iov_len = text->len - offset;
+            iov_count++;
+        }
+        ssize_t written = writev(queue->fd, iov, iov_count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            g_warning("unable to write events, discarding them: %s", g_strerror(errno));
+            event_queue_close(queue);
+            return FALSE;
+        }
+        gsize remaining = written;
+        while (remaining > 0) {
+            QueuedEvent* event = g_queue_peek_head(queue->events);
+            gsize left = event->text->len - queue->head_written;
+            if (remaining < left) {
+                queue->head_written += remaining;
+                break;
+            }
+            remaining -= left;
+            queued_event_free(g_queue_pop_head(queue->events));
+            queue->head_written = 0;
+            queue->sent++;
+        }
+    }
+    gboolean pending = !g_queue_is_empty(queue->events);
+    if (pending && queue->watch == 0) {
+        queue->watch = g_io_add_watch(queue->channel, G_IO_OUT | G_IO_ERR | G_IO_HUP, on_event_queue_writable, queue);
+    } else if (!pending) {
+        // pushed events are written right away again
+        event_queue_remove_watch(queue);
+    }
+    return pending;
+}
+
+void event_queue_drain(EventQueue* queue, gint timeout_ms) {
+    gint64 deadline = g_get_monotonic_time() + timeout_ms * G_TIME_SPAN_MILLISECOND;
+    while (event_queue_flush(queue)) {
+        gint64 left_ms = (deadline - g_get_monotonic_time()) / G_TIME_SPAN_MILLISECOND;
+        struct pollfd pollfd = { .fd = queue->fd, .events = POLLOUT };
+        if (left_ms <= 0 || poll(&pollfd, 1, (int) left_ms) <= 0) {
+            g_warning("event output is not being read, dropping %u events", g_queue_get_length(queue->events));
+            break;
+        }
+    }
+}
+
+guint event_queue_get_depth(EventQueue* queue) {
+    return g_queue_get_length(queue->events);
+}
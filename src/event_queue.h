@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_EVENT_QUEUE_H
+#define ROFI_BLOCKS_EVENT_QUEUE_H
+#include <gmodule.h>
+
+typedef struct {
+    GString* text;      // written as is, framing included
+    gint kind;
+    gboolean droppable; // superseded by newer events of the same kind
+} QueuedEvent;
+
+// Bounded queue of events waiting to be written to a non-blocking file
+// descriptor. Writes are attempted right away and resumed from a G_IO_OUT
+// watch whenever the reader falls behind, so pushing never blocks.
+typedef struct {
+    int fd;
+    GIOChannel* channel;
+    guint watch;
+    GQueue* events;       // of QueuedEvent*, oldest first
+    gsize head_written;   // bytes of the oldest event already written
+    guint max_events;
+    gboolean closed;      // the reader went away, events are discarded
+
+    // diagnostics
+    guint64 sent;
+    guint64 dropped;
+    guint peak_depth;
+} EventQueue;
+
+// Making fd non-blocking is left to the caller: the mode belongs to the open
+// file, which descriptors the plugin did not create share with other
+// processes. Writes to a blocking fd wait for the reader instead.
+EventQueue* event_queue_new(int fd, guint max_events);
+
+void event_queue_destroy(EventQueue* queue);
+
+void event_queue_push(EventQueue* queue, const gchar* text, gsize length, gint kind, gboolean droppable);
+
+// Writes as many queued events as the file descriptor takes, returns TRUE
+// when events are left in the queue
+gboolean event_queue_flush(EventQueue* queue);
+
+// Waits up to timeout_ms for the queued events to be written, before the
+// queue is destroyed
+void event_queue_drain(EventQueue* queue, gint timeout_ms);
+
+guint event_queue_get_depth(EventQueue* queue);
+
+#endif // ROFI_BLOCKS_EVENT_QUEUE_H
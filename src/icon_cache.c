@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "icon_cache.h"
+
+typedef struct {
+    gchar* name;
+    gint size;
+    uint32_t uid;
+} IconCacheEntry;
+
+static guint icon_cache_entry_hash(gconstpointer pointer) {
+    const IconCacheEntry* entry = pointer;
+    return g_str_hash(entry->name) * 31 + (guint) entry->size;
+}
+
+static gboolean icon_cache_entry_equal(gconstpointer a, gconstpointer b) {
+    const IconCacheEntry* entry_a = a;
+    const IconCacheEntry* entry_b = b;
+    return entry_a->size == entry_b->size && g_str_equal(entry_a->name, entry_b->name);
+}
+
+static void icon_cache_entry_free(gpointer pointer) {
+    IconCacheEntry* entry = pointer;
+    g_free(entry->name);
+    g_free(entry);
+}
+
+IconCache* icon_cache_new(IconCacheFetchFunc fetch) {
+    IconCache* cache = g_malloc0(sizeof(*cache));
+    cache->entries = g_hash_table_new_full(icon_cache_entry_hash, icon_cache_entry_equal, icon_cache_entry_free, NULL);
+    cache->fetch = fetch;
+    return cache;
+}
+
+void icon_cache_destroy(IconCache* cache) {
+    g_debug("icon cache: %u icons, %u hits, %u misses", g_hash_table_size(cache->entries), cache->hits, cache->misses);
+    g_hash_table_destroy(cache->entries);
+    g_free(cache);
+}
+
+uint32_t icon_cache_lookup(IconCache* cache, const gchar* name, gint size) {
+    // the key is only read during the lookup, so it can borrow name
+    IconCacheEntry key = { .name = (gchar*) name, .size = size };
+    IconCacheEntry* entry = g_hash_table_lookup(cache->entries, &key);
+    if (entry != NULL) {
+        cache->hits++;
+        return entry->uid;
+    }
+    cache->misses++;
+    entry = g_malloc(sizeof(*entry));
+    entry->name = g_strdup(name);
+    entry->size = size;
+    entry->uid = cache->fetch(name, size);
+    g_hash_table_add(cache->entries, entry);
+    return entry->uid;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_ICON_CACHE_H
+#define ROFI_BLOCKS_ICON_CACHE_H
+#include <gmodule.h>
+#include <stdint.h>
+
+// starts fetching an icon and returns its handle, i.e. rofi_icon_fetcher_query
+typedef uint32_t (*IconCacheFetchFunc)(const char* name, const int size);
+
+// Icon fetcher handles by icon name and size, kept for the whole session so
+// that lines sharing an icon, or coming back after a page replaced them,
+// reuse a single fetch.
+typedef struct {
+    GHashTable* entries; // of IconCacheEntry*, key and value alike
+    IconCacheFetchFunc fetch;
+    guint hits;
+    guint misses;
+} IconCache;
+
+IconCache* icon_cache_new(IconCacheFetchFunc fetch);
+
+void icon_cache_destroy(IconCache* cache);
+
+// handle of the icon name at size, fetched the first time it is asked for
+uint32_t icon_cache_lookup(IconCache* cache, const gchar* name, gint size);
+
+#endif // ROFI_BLOCKS_ICON_CACHE_H
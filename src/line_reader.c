@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memrchr
+#endif
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "line_reader.h"
+
+// size of a single read(2), the buffer grows in multiples of it
+static const gsize READ_BLOCK_SIZE = 64 * 1024;
+
+// stop filling once this much was read and at least one line is complete, so
+// a backend that never stops writing cannot starve the main loop
+static const gsize MAX_FILL_SIZE = 4 * 1024 * 1024;
+
+static const gsize FRAME_HEADER_SIZE = 4;
+
+// frames announcing more than this are taken as a broken stream
+static const gsize MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
+
+static void line_reader_compact(LineReader* reader) {
+    gsize pending = reader->end - reader->start;
+    if (reader->start > 0 && pending > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, pending);
+    }
+    reader->complete_end = 0;
+    reader->start = 0;
+    reader->end = pending;
+
+    // give back the memory of a huge payload once it was consumed
+    if (pending == 0 && reader->capacity > MAX_FILL_SIZE) {
+        reader->buffer = g_realloc(reader->buffer, READ_BLOCK_SIZE);
+        reader->capacity = READ_BLOCK_SIZE;
+    }
+}
+
+static void line_reader_reserve(LineReader* reader, gsize size) {
+    gsize capacity = reader->capacity;
+    while (capacity - reader->end < size) {
+        capacity *= 2;
+    }
+    if (capacity != reader->capacity) {
+        reader->buffer = g_realloc(reader->buffer, capacity);
+        reader->capacity = capacity;
+    }
+}
+
+static gsize line_reader_frame_length(const gchar* header) {
+    const guchar* bytes = (const guchar*) header;
+    return ((gsize) bytes[0] << 24) | ((gsize) bytes[1] << 16) | ((gsize) bytes[2] << 8) | bytes[3];
+}
+
+// Moves complete_end past every complete frame, and makes room for the whole
+// incomplete one once its length is known, so it is read in as few calls as
+// possible. Returns FALSE when a frame is too large.
+static gboolean line_reader_find_frames(LineReader* reader) {
+    while (reader->end - reader->complete_end >= FRAME_HEADER_SIZE) {
+        gsize length = line_reader_frame_length(reader->buffer + reader->complete_end);
+        if (length > MAX_FRAME_SIZE) {
+            g_warning("frame of %" G_GSIZE_FORMAT " bytes is too large, closing input", length);
+            return FALSE;
+        }
+        gsize frame_end = reader->complete_end + FRAME_HEADER_SIZE + length;
+        if (frame_end > reader->end) {
+            line_reader_reserve(reader, frame_end - reader->end);
+            break;
+        }
+        reader->complete_end = frame_end;
+    }
+    return TRUE;
+}
+
+LineReader* line_reader_new(int fd) {
+    LineReader* reader = g_malloc0(sizeof(*reader));
+    reader->fd = fd;
+    reader->capacity = READ_BLOCK_SIZE;
+    reader->buffer = g_malloc(reader->capacity);
+    return reader;
+}
+
+void line_reader_destroy(LineReader* reader) {
+    g_free(reader->buffer);
+    g_free(reader);
+}
+
+// Reads everything currently available on the file descriptor. Lines handed
+// out before this call are invalidated.
+LineReaderStatus line_reader_fill(LineReader* reader) {
+    line_reader_compact(reader);
+    if (reader->framed && !line_reader_find_frames(reader)) {
+        return LineReaderStatus_ERROR;
+    }
+    gsize total_read = 0;
+    while (total_read < MAX_FILL_SIZE || reader->complete_end == 0) {
+        line_reader_reserve(reader, READ_BLOCK_SIZE);
+        gchar* block = reader->buffer + reader->end;
+        ssize_t bytes_read = read(reader->fd, block, reader->capacity - reader->end);
+        if (bytes_read == 0) {
+            return LineReaderStatus_EOF;
+        } else if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? LineReaderStatus_AGAIN : LineReaderStatus_ERROR;
+        }
+        reader->end += bytes_read;
+        total_read += bytes_read;
+        if (reader->framed) {
+            if (!line_reader_find_frames(reader)) {
+                return LineReaderStatus_ERROR;
+            }
+            continue;
+        }
+        gchar* last_newline = memrchr(block, '\n', bytes_read);
+        if (last_newline != NULL) {
+            reader->complete_end = last_newline - reader->buffer + 1;
+        }
+    }
+    return LineReaderStatus_AGAIN;
+}
+
+// Hands out the next complete, non-empty and valid UTF-8 line. Does no I/O.
+gboolean line_reader_next_line(LineReader* reader, gchar** line, gsize* length) {
+    while (reader->start < reader->complete_end) {
+        gchar* begin = reader->buffer + reader->start;
+        gchar* newline = memchr(begin, '\n', reader->complete_end - reader->start);
+        gsize len = newline - begin;
+        *newline = '\0';
+        reader->start += len + 1;
+        if (len == 0) {
+            continue;
+        }
+        if (!g_utf8_validate(begin, len, NULL)) {
+            g_warning("dropping line with invalid UTF-8 (%" G_GSIZE_FORMAT " bytes)", len);
+            continue;
+        }
+        g_debug("received new line: %s", begin);
+        *line = begin;
+        *length = len;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+void line_reader_set_framed(LineReader* reader, gboolean framed) {
+    reader->framed = framed;
+}
+
+// Hands out the next complete, non-empty frame, without its length. Frames
+// are binary, so they are not NUL terminated. Does no I/O.
+gboolean line_reader_next_frame(LineReader* reader, gchar** frame, gsize* length) {
+    while (reader->start < reader->complete_end) {
+        gchar* begin = reader->buffer + reader->start;
+        gsize len = line_reader_frame_length(begin);
+        reader->start += FRAME_HEADER_SIZE + len;
+        if (len == 0) {
+            continue;
+        }
+        g_debug("received new frame of %" G_GSIZE_FORMAT " bytes", len);
+        *frame = begin + FRAME_HEADER_SIZE;
+        *length = len;
+        return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_LINE_READER_H
+#define ROFI_BLOCKS_LINE_READER_H
+#include <gmodule.h>
+
+typedef enum {
+    LineReaderStatus_AGAIN,
+    LineReaderStatus_EOF,
+    LineReaderStatus_ERROR
+} LineReaderStatus;
+
+// Reads newline delimited payloads from a (non-blocking) file descriptor in
+// large blocks. Lines are handed out in place: they are NUL terminated inside
+// the reader buffer and remain valid until the next call to line_reader_fill.
+// In framed mode, payloads are instead prefixed with their length as a 4 byte
+// big endian integer, and handed out with line_reader_next_frame.
+typedef struct {
+    int fd;
+    gboolean framed;
+    gchar* buffer;
+    gsize capacity;
+    gsize start;          // first byte not yet handed out
+    gsize complete_end;   // one past the last newline, or complete frame, in the buffer
+    gsize end;            // one past the last byte read
+} LineReader;
+
+LineReader* line_reader_new(int fd);
+
+void line_reader_destroy(LineReader* reader);
+
+LineReaderStatus line_reader_fill(LineReader* reader);
+
+gboolean line_reader_next_line(LineReader* reader, gchar** line, gsize* length);
+
+void line_reader_set_framed(LineReader* reader, gboolean framed);
+
+gboolean line_reader_next_frame(LineReader* reader, gchar** frame, gsize* length);
+
+#endif // ROFI_BLOCKS_LINE_READER_H
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lines_file.h"
+
+// Every integer is a little endian guint32. The header is the magic, the
+// version and the number of lines, followed by a reserved field:
+static const gchar LINES_FILE_MAGIC[4] = { 'R', 'B', 'L', 'F' };
+static const guint32 LINES_FILE_VERSION = 1;
+static const gsize LINES_FILE_HEADER_SIZE = 16;
+
+// then an entry per line, and the strings region: offsets are relative to
+// its start and every string is followed by a NUL byte
+typedef enum {
+    LinesFileEntryField_TEXT_OFFSET,
+    LinesFileEntryField_TEXT_LENGTH,
+    LinesFileEntryField_META_OFFSET,
+    LinesFileEntryField_META_LENGTH,
+    LinesFileEntryField_ICON_OFFSET,
+    LinesFileEntryField_ICON_LENGTH,
+    LinesFileEntryField_DATA_OFFSET,
+    LinesFileEntryField_DATA_LENGTH,
+    LinesFileEntryField_FLAGS,
+    LinesFileEntryField__COUNT
+} LinesFileEntryField;
+
+static const gsize LINES_FILE_ENTRY_SIZE = LinesFileEntryField__COUNT * sizeof(guint32);
+
+// meta offset of lines without meta
+static const guint32 LINES_FILE_NO_STRING = G_MAXUINT32;
+
+static const gchar* EMPTY_STRING = "";
+
+G_DEFINE_QUARK(lines-file-error-quark, lines_file_error)
+
+static guint32 lines_file_read_uint(const gchar* position) {
+    guint32 value;
+    memcpy(&value, position, sizeof(value));
+    return GUINT32_FROM_LE(value);
+}
+
+LinesFile* lines_file_open(const gchar* path, GError** error) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        g_set_error(error, LINES_FILE_ERROR, 0, "unable to open %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (gsize) st.st_size < LINES_FILE_HEADER_SIZE) {
+        g_set_error(error, LINES_FILE_ERROR, 0, "%s is not a lines file", path);
+        close(fd);
+        return NULL;
+    }
+    gsize size = st.st_size;
+    // the mapping outlives the descriptor, and stays on the same file if the
+    // backend renames a new one over it
+    gchar* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        g_set_error(error, LINES_FILE_ERROR, 0, "unable to map %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+
+    guint32 count = lines_file_read_uint(mapping + 8);
+    if (memcmp(mapping, LINES_FILE_MAGIC, sizeof(LINES_FILE_MAGIC)) != 0
+            || lines_file_read_uint(mapping + 4) != LINES_FILE_VERSION
+            || count > (size - LINES_FILE_HEADER_SIZE) / LINES_FILE_ENTRY_SIZE) {
+        g_set_error(error, LINES_FILE_ERROR, 0, "%s is not a version %u lines file", path, LINES_FILE_VERSION);
+        munmap(mapping, size);
+        return NULL;
+    }
+
+    LinesFile* file = g_malloc0(sizeof(*file));
+    file->mapping = mapping;
+    file->size = size;
+    file->count = count;
+    file->entries = mapping + LINES_FILE_HEADER_SIZE;
+    file->strings = file->entries + (gsize) count * LINES_FILE_ENTRY_SIZE;
+    file->strings_size = mapping + size - file->strings;
+    return file;
+}
+
+void lines_file_destroy(LinesFile* file) {
+    munmap(file->mapping, file->size);
+    g_free(file);
+}
+
+static gboolean lines_file_get_string(LinesFile* file, const gchar* entry, LinesFileEntryField offset_field, const gchar** result) {
+    guint32 offset = lines_file_read_uint(entry + offset_field * sizeof(guint32));
+    guint32 length = lines_file_read_uint(entry + (offset_field + 1) * sizeof(guint32));
+    if (offset == LINES_FILE_NO_STRING) {
+        *result = NULL;
+        return TRUE;
+    } else if (length == 0) {
+        *result = EMPTY_STRING;
+        return TRUE;
+    }
+    gsize end = (gsize) offset + length;
+    if (end >= file->strings_size || file->strings[end] != '\0' || !g_utf8_validate(file->strings + offset, length, NULL)) {
+        return FALSE;
+    }
+    *result = file->strings + offset;
+    return TRUE;
+}
+
+gboolean lines_file_get_entry(LinesFile* file, guint index, LinesFileEntry* entry) {
+    if (index >= file->count) {
+        return FALSE;
+    }
+    const gchar* raw = file->entries + (gsize) index * LINES_FILE_ENTRY_SIZE;
+    memset(entry, 0, sizeof(*entry));
+    entry->flags = lines_file_read_uint(raw + LinesFileEntryField_FLAGS * sizeof(guint32));
+    gboolean valid = lines_file_get_string(file, raw, LinesFileEntryField_TEXT_OFFSET, &entry->text)
+        && lines_file_get_string(file, raw, LinesFileEntryField_META_OFFSET, &entry->meta)
+        && lines_file_get_string(file, raw, LinesFileEntryField_ICON_OFFSET, &entry->icon)
+        && lines_file_get_string(file, raw, LinesFileEntryField_DATA_OFFSET, &entry->data);
+    // only meta may be missing
+    entry->text = entry->text != NULL ? entry->text : EMPTY_STRING;
+    entry->icon = entry->icon != NULL ? entry->icon : EMPTY_STRING;
+    entry->data = entry->data != NULL ? entry->data : EMPTY_STRING;
+    return valid;
+}
+
+static void lines_file_append_uint(GString* out, guint32 value) {
+    value = GUINT32_TO_LE(value);
+    g_string_append_len(out, (const gchar*) &value, sizeof(value));
+}
+
+// appends the offset and length of string to the entries, and string to
+// the strings region
+static void lines_file_append_string(GString* entries, GString* strings, const gchar* string) {
+    if (string == NULL) {
+        lines_file_append_uint(entries, LINES_FILE_NO_STRING);
+        lines_file_append_uint(entries, 0);
+        return;
+    }
+    gsize length = strlen(string);
+    lines_file_append_uint(entries, strings->len);
+    lines_file_append_uint(entries, length);
+    g_string_append_len(strings, string, length + 1);
+}
+
+gboolean lines_file_write(const gchar* path, const LinesFileEntry* entries, guint count, GError** error) {
+    GString* out = g_string_sized_new(LINES_FILE_HEADER_SIZE + (gsize) count * LINES_FILE_ENTRY_SIZE);
+    GString* strings = g_string_new(NULL);
+    g_string_append_len(out, LINES_FILE_MAGIC, sizeof(LINES_FILE_MAGIC));
+    lines_file_append_uint(out, LINES_FILE_VERSION);
+    lines_file_append_uint(out, count);
+    lines_file_append_uint(out, 0);
+    for (guint i = 0; i < count; ++i) {
+        const LinesFileEntry* entry = &entries[i];
+        lines_file_append_string(out, strings, entry->text != NULL ? entry->text : EMPTY_STRING);
+        lines_file_append_string(out, strings, entry->meta);
+        lines_file_append_string(out, strings, entry->icon != NULL ? entry->icon : EMPTY_STRING);
+        lines_file_append_string(out, strings, entry->data != NULL ? entry->data : EMPTY_STRING);
+        lines_file_append_uint(out, entry->flags);
+    }
+    if (strings->len > G_MAXUINT32) {
+        g_set_error(error, LINES_FILE_ERROR, 0, "lines are too large for a lines file");
+        g_string_free(strings, TRUE);
+        g_string_free(out, TRUE);
+        return FALSE;
+    }
+    g_string_append_len(out, strings->str, strings->len);
+    // the file is written aside and renamed over path
+    gboolean written = g_file_set_contents(path, out->str, out->len, error);
+    g_string_free(strings, TRUE);
+    g_string_free(out, TRUE);
+    return written;
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_LINES_FILE_H
+#define ROFI_BLOCKS_LINES_FILE_H
+#include <gmodule.h>
+
+#define LINES_FILE_ERROR lines_file_error_quark()
+
+// line flags, as stored in the file
+typedef enum {
+    LinesFileFlag_URGENT = 1 << 0,
+    LinesFileFlag_HIGHLIGHT = 1 << 1,
+    LinesFileFlag_MARKUP = 1 << 2,
+    LinesFileFlag_MARKUP_SET = 1 << 3, // MARKUP overrides the page default
+    LinesFileFlag_NONSELECTABLE = 1 << 4,
+    LinesFileFlag_NO_FILTER = 1 << 5
+} LinesFileFlag;
+
+// A read-only, memory mapped table of lines written by the backend: a header,
+// a fixed size entry per line and the NUL terminated strings they point to.
+// Opening it costs the same whatever the number of lines, entries are only
+// validated as they are read.
+typedef struct {
+    gchar* mapping;
+    gsize size;
+    guint count;
+    const gchar* entries;
+    const gchar* strings;
+    gsize strings_size;
+} LinesFile;
+
+// Strings of a line, pointing into the mapping
+typedef struct {
+    const gchar* text;
+    const gchar* meta; // NULL when the line has none
+    const gchar* icon;
+    const gchar* data;
+    guint32 flags;
+} LinesFileEntry;
+
+GQuark lines_file_error_quark(void);
+
+LinesFile* lines_file_open(const gchar* path, GError** error);
+
+void lines_file_destroy(LinesFile* file);
+
+// FALSE when the entry points outside of the file, or to invalid UTF-8
+gboolean lines_file_get_entry(LinesFile* file, guint index, LinesFileEntry* entry);
+
+// Writes count entries as a lines file, replacing path at once so that
+// mappings of the previous file stay valid
+gboolean lines_file_write(const gchar* path, const LinesFileEntry* entries, guint count, GError** error);
+
+#endif // ROFI_BLOCKS_LINES_FILE_H
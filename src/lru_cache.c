@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "lru_cache.h"
+
+struct LruCacheEntry {
+    guint key;
+    gpointer value;
+    LruCacheEntry* newer;
+    LruCacheEntry* older;
+};
+
+static void lru_cache_unlink(LruCache* cache, LruCacheEntry* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void lru_cache_link_newest(LruCache* cache, LruCacheEntry* entry) {
+    entry->older = cache->newest;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+static void lru_cache_free_value(LruCache* cache, gpointer value) {
+    if (cache->value_free != NULL && value != NULL) {
+        cache->value_free(value);
+    }
+}
+
+LruCache* lru_cache_new(guint capacity, GDestroyNotify value_free) {
+    LruCache* cache = g_malloc0(sizeof(*cache));
+    cache->entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+    cache->capacity = MAX(capacity, 1);
+    cache->value_free = value_free;
+    return cache;
+}
+
+void lru_cache_destroy(LruCache* cache) {
+    g_debug("lru cache: %u hits, %u misses, %u evictions", cache->hits, cache->misses, cache->evictions);
+    lru_cache_clear(cache);
+    g_hash_table_destroy(cache->entries);
+    g_free(cache);
+}
+
+gpointer lru_cache_lookup(LruCache* cache, guint key) {
+    LruCacheEntry* entry = g_hash_table_lookup(cache->entries, GUINT_TO_POINTER(key));
+    if (entry == NULL) {
+        cache->misses++;
+        return NULL;
+    }
+    cache->hits++;
+    if (entry != cache->newest) {
+        lru_cache_unlink(cache, entry);
+        lru_cache_link_newest(cache, entry);
+    }
+    return entry->value;
+}
+
+void lru_cache_insert(LruCache* cache, guint key, gpointer value) {
+    LruCacheEntry* entry = g_hash_table_lookup(cache->entries, GUINT_TO_POINTER(key));
+    if (entry != NULL) {
+        lru_cache_free_value(cache, entry->value);
+        entry->value = value;
+        lru_cache_unlink(cache, entry);
+        lru_cache_link_newest(cache, entry);
+        return;
+    }
+    if (g_hash_table_size(cache->entries) >= cache->capacity) {
+        LruCacheEntry* oldest = cache->oldest;
+        lru_cache_unlink(cache, oldest);
+        g_hash_table_remove(cache->entries, GUINT_TO_POINTER(oldest->key));
+        lru_cache_free_value(cache, oldest->value);
+        g_free(oldest);
+        cache->evictions++;
+    }
+    entry = g_malloc0(sizeof(*entry));
+    entry->key = key;
+    entry->value = value;
+    lru_cache_link_newest(cache, entry);
+    g_hash_table_insert(cache->entries, GUINT_TO_POINTER(key), entry);
+}
+
+void lru_cache_clear(LruCache* cache) {
+    LruCacheEntry* entry = cache->newest;
+    while (entry != NULL) {
+        LruCacheEntry* older = entry->older;
+        lru_cache_free_value(cache, entry->value);
+        g_free(entry);
+        entry = older;
+    }
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    g_hash_table_remove_all(cache->entries);
+}
+
+guint lru_cache_size(LruCache* cache) {
+    return g_hash_table_size(cache->entries);
+}
+
+void lru_cache_foreach(LruCache* cache, GHFunc func, gpointer user_data) {
+    for (LruCacheEntry* entry = cache->newest; entry != NULL; entry = entry->older) {
+        func(GUINT_TO_POINTER(entry->key), entry->value, user_data);
+    }
+}
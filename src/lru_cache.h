@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_LRU_CACHE_H
+#define ROFI_BLOCKS_LRU_CACHE_H
+#include <gmodule.h>
+
+typedef struct LruCacheEntry LruCacheEntry;
+
+// Values by integer key, up to a capacity past which the least recently
+// looked up or inserted value is freed
+typedef struct {
+    GHashTable* entries; // of LruCacheEntry*, by key
+    LruCacheEntry* newest;
+    LruCacheEntry* oldest;
+    guint capacity;
+    GDestroyNotify value_free;
+    guint hits;
+    guint misses;
+    guint evictions;
+} LruCache;
+
+LruCache* lru_cache_new(guint capacity, GDestroyNotify value_free);
+
+void lru_cache_destroy(LruCache* cache);
+
+// value of key, NULL when it is not cached
+gpointer lru_cache_lookup(LruCache* cache, guint key);
+
+// caches value for key, freeing the value it replaces and, when full, the
+// least recently used one
+void lru_cache_insert(LruCache* cache, guint key, gpointer value);
+
+void lru_cache_clear(LruCache* cache);
+
+guint lru_cache_size(LruCache* cache);
+
+// calls func with the key and value of every entry, newest first, without
+// changing their order
+void lru_cache_foreach(LruCache* cache, GHFunc func, gpointer user_data);
+
+#endif // ROFI_BLOCKS_LRU_CACHE_H
@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <string.h>
+#include "match_bitmap.h"
+#include "stats.h"
+
+// lines per word of the bitmap; tasks own whole words, so that workers never
+// write to the same one
+#define MATCH_BITMAP_WORD_BITS 64
+
+// below this many lines, the bitmap is computed by the calling thread alone
+static const guint MIN_PARALLEL_LINES = 8192;
+
+// tasks per thread, so that slow ranges (e.g. long lines) balance out
+static const guint TASKS_PER_THREAD = 4;
+
+typedef struct {
+    MatchBitmap* bitmap;
+    const guint* candidates; // when set, start and end index it
+    guint start;
+    guint end;
+} MatchBitmapTask;
+
+static void match_bitmap_compute_range(MatchBitmap* bitmap, guint start, guint end) {
+    for (guint word = start / MATCH_BITMAP_WORD_BITS; word * MATCH_BITMAP_WORD_BITS < end; ++word) {
+        guint first = word * MATCH_BITMAP_WORD_BITS;
+        guint last = MIN(first + MATCH_BITMAP_WORD_BITS, end);
+        guint64 bits = 0;
+        for (guint index = first; index < last; ++index) {
+            if (bitmap->match(bitmap->context, index)) {
+                bits |= G_GUINT64_CONSTANT(1) << (index - first);
+            }
+        }
+        bitmap->bits[word] = bits;
+    }
+}
+
+// bits of lines that are not candidates must already be cleared
+static void match_bitmap_compute_candidates(MatchBitmap* bitmap, const guint* candidates, guint start, guint end) {
+    for (guint i = start; i < end; ++i) {
+        guint index = candidates[i];
+        if (bitmap->match(bitmap->context, index)) {
+            bitmap->bits[index / MATCH_BITMAP_WORD_BITS] |= G_GUINT64_CONSTANT(1) << (index % MATCH_BITMAP_WORD_BITS);
+        }
+    }
+}
+
+static void match_bitmap_run_task(gpointer data, gpointer user_data) {
+    MatchBitmapTask* task = data;
+    MatchBitmap* bitmap = task->bitmap;
+    if (task->candidates != NULL) {
+        match_bitmap_compute_candidates(bitmap, task->candidates, task->start, task->end);
+    } else {
+        match_bitmap_compute_range(bitmap, task->start, task->end);
+    }
+    g_free(task);
+    g_mutex_lock(&bitmap->batch_lock);
+    if (--bitmap->pending_tasks == 0) {
+        g_cond_signal(&bitmap->batch_done);
+    }
+    g_mutex_unlock(&bitmap->batch_lock);
+}
+
+static void match_bitmap_push_task(MatchBitmap* bitmap, const guint* candidates, guint start, guint end) {
+    MatchBitmapTask* task = g_malloc(sizeof(*task));
+    task->bitmap = bitmap;
+    task->candidates = candidates;
+    task->start = start;
+    task->end = end;
+    bitmap->pending_tasks++;
+    g_thread_pool_push(bitmap->pool, task, NULL);
+}
+
+static void match_bitmap_wait_tasks(MatchBitmap* bitmap) {
+    g_mutex_lock(&bitmap->batch_lock);
+    while (bitmap->pending_tasks > 0) {
+        g_cond_wait(&bitmap->batch_done, &bitmap->batch_lock);
+    }
+    g_mutex_unlock(&bitmap->batch_lock);
+}
+
+static void match_bitmap_compute_all(MatchBitmap* bitmap, guint length, guint words) {
+    if (bitmap->pool == NULL || length < MIN_PARALLEL_LINES) {
+        match_bitmap_compute_range(bitmap, 0, length);
+        return;
+    }
+    guint tasks = bitmap->threads * TASKS_PER_THREAD;
+    guint words_per_task = MAX((words + tasks - 1) / tasks, 1);
+    guint lines_per_task = words_per_task * MATCH_BITMAP_WORD_BITS;
+    g_mutex_lock(&bitmap->batch_lock);
+    for (guint start = 0; start < length; start += lines_per_task) {
+        match_bitmap_push_task(bitmap, NULL, start, MIN(start + lines_per_task, length));
+    }
+    g_mutex_unlock(&bitmap->batch_lock);
+    match_bitmap_wait_tasks(bitmap);
+}
+
+// only the candidates are matched, every other line is known not to match
+static void match_bitmap_compute_candidates_of(MatchBitmap* bitmap, GArray* candidates, guint words) {
+    memset(bitmap->bits, 0, words * sizeof(guint64));
+    const guint* lines = (const guint*) candidates->data;
+    guint count = candidates->len;
+    if (bitmap->pool == NULL || count < MIN_PARALLEL_LINES) {
+        match_bitmap_compute_candidates(bitmap, lines, 0, count);
+        return;
+    }
+    guint per_task = MAX(count / (bitmap->threads * TASKS_PER_THREAD), 1);
+    g_mutex_lock(&bitmap->batch_lock);
+    guint start = 0;
+    while (start < count) {
+        guint end = MIN(start + per_task, count);
+        // candidates of a word all go to the same task
+        while (end < count && lines[end] / MATCH_BITMAP_WORD_BITS == lines[end - 1] / MATCH_BITMAP_WORD_BITS) {
+            end++;
+        }
+        match_bitmap_push_task(bitmap, lines, start, end);
+        start = end;
+    }
+    g_mutex_unlock(&bitmap->batch_lock);
+    match_bitmap_wait_tasks(bitmap);
+}
+
+static void match_bitmap_compute(MatchBitmap* bitmap, guint length, GArray* candidates) {
+    guint words = (length + MATCH_BITMAP_WORD_BITS - 1) / MATCH_BITMAP_WORD_BITS;
+    if (words > bitmap->capacity || bitmap->bits == NULL) {
+        g_free(bitmap->bits);
+        bitmap->capacity = MAX(words, 1);
+        bitmap->bits = g_new(guint64, bitmap->capacity);
+    }
+    bitmap->length = length;
+    if (candidates != NULL) {
+        match_bitmap_compute_candidates_of(bitmap, candidates, words);
+    } else {
+        match_bitmap_compute_all(bitmap, length, words);
+    }
+}
+
+MatchBitmap* match_bitmap_new(guint threads) {
+    MatchBitmap* bitmap = g_malloc0(sizeof(*bitmap));
+    bitmap->threads = threads > 0 ? threads : g_get_num_processors();
+    g_rw_lock_init(&bitmap->lock);
+    g_mutex_init(&bitmap->batch_lock);
+    g_cond_init(&bitmap->batch_done);
+    if (bitmap->threads > 1) {
+        GError* error = NULL;
+        bitmap->pool = g_thread_pool_new(match_bitmap_run_task, NULL, bitmap->threads, TRUE, &error);
+        if (bitmap->pool == NULL) {
+            g_warning("unable to start filter threads, filtering on a single thread: %s", error->message);
+            g_error_free(error);
+        }
+    }
+    return bitmap;
+}
+
+void match_bitmap_destroy(MatchBitmap* bitmap) {
+    if (bitmap->pool != NULL) {
+        g_thread_pool_free(bitmap->pool, FALSE, TRUE);
+    }
+    g_rw_lock_clear(&bitmap->lock);
+    g_mutex_clear(&bitmap->batch_lock);
+    g_cond_clear(&bitmap->batch_done);
+    g_free(bitmap->bits);
+    g_free(bitmap);
+}
+
+static gboolean match_bitmap_is_current(MatchBitmap* bitmap, guint64 query_generation, guint64 lines_generation, guint length) {
+    return bitmap->valid && bitmap->length == length
+        && bitmap->query_generation == query_generation && bitmap->lines_generation == lines_generation;
+}
+
+static gboolean match_bitmap_get_bit(MatchBitmap* bitmap, guint index) {
+    return (bitmap->bits[index / MATCH_BITMAP_WORD_BITS] >> (index % MATCH_BITMAP_WORD_BITS)) & 1;
+}
+
+gboolean match_bitmap_test(MatchBitmap* bitmap, guint64 query_generation, guint64 lines_generation, guint length,
+                           MatchBitmapFunc match, MatchBitmapCandidatesFunc candidates, gpointer context, guint index) {
+    if (index >= length) {
+        return FALSE;
+    }
+    // rofi filters from several threads, that only share the lock for reading
+    // once the bitmap is up to date
+    g_rw_lock_reader_lock(&bitmap->lock);
+    if (match_bitmap_is_current(bitmap, query_generation, lines_generation, length)) {
+        gboolean result = match_bitmap_get_bit(bitmap, index);
+        g_rw_lock_reader_unlock(&bitmap->lock);
+        return result;
+    }
+    g_rw_lock_reader_unlock(&bitmap->lock);
+
+    g_rw_lock_writer_lock(&bitmap->lock);
+    if (!match_bitmap_is_current(bitmap, query_generation, lines_generation, length)) {
+        gint64 start = g_get_monotonic_time();
+        bitmap->match = match;
+        bitmap->context = context;
+        GArray* candidate_lines = candidates != NULL ? candidates(context) : NULL;
+        match_bitmap_compute(bitmap, length, candidate_lines);
+        guint candidate_count = candidate_lines != NULL ? candidate_lines->len : length;
+        stats_add(&bitmap->matched_lines, candidate_count);
+        if (candidate_lines != NULL) {
+            g_debug("%u of %u lines are candidates", candidate_lines->len, length);
+            g_array_free(candidate_lines, TRUE);
+        }
+        bitmap->match = NULL;
+        bitmap->context = NULL;
+        bitmap->valid = TRUE;
+        bitmap->query_generation = query_generation;
+        bitmap->lines_generation = lines_generation;
+        g_debug("matched %u lines in %" G_GINT64_FORMAT " us", length, g_get_monotonic_time() - start);
+        trace_end(bitmap->trace, "match", start, "\"lines\":%u, \"candidates\":%u", length, candidate_count);
+    }
+    gboolean result = match_bitmap_get_bit(bitmap, index);
+    g_rw_lock_writer_unlock(&bitmap->lock);
+    return result;
+}
+
+GArray* match_bitmap_get_matches(MatchBitmap* bitmap, guint64 lines_generation, guint length) {
+    if (bitmap->bits == NULL || bitmap->lines_generation != lines_generation || bitmap->length != length) {
+        return NULL;
+    }
+    GArray* lines = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint words = (length + MATCH_BITMAP_WORD_BITS - 1) / MATCH_BITMAP_WORD_BITS;
+    for (guint word = 0; word < words; ++word) {
+        guint64 bits = bitmap->bits[word];
+        for (guint bit = 0; bits != 0; ++bit, bits >>= 1) {
+            if (bits & 1) {
+                guint index = word * MATCH_BITMAP_WORD_BITS + bit;
+                g_array_append_val(lines, index);
+            }
+        }
+    }
+    return lines;
+}
+
+void match_bitmap_remap(MatchBitmap* bitmap, guint64 lines_generation, guint64 new_lines_generation,
+                        const guint* previous, guint length) {
+    g_rw_lock_writer_lock(&bitmap->lock);
+    if (bitmap->bits == NULL || bitmap->lines_generation != lines_generation) {
+        g_rw_lock_writer_unlock(&bitmap->lock);
+        return;
+    }
+    guint words = (length + MATCH_BITMAP_WORD_BITS - 1) / MATCH_BITMAP_WORD_BITS;
+    guint64* bits = g_new0(guint64, MAX(words, 1));
+    for (guint index = 0; index < length; ++index) {
+        guint previous_index = previous[index];
+        gboolean set = previous_index == G_MAXUINT
+            || (previous_index < bitmap->length && match_bitmap_get_bit(bitmap, previous_index));
+        if (set) {
+            bits[index / MATCH_BITMAP_WORD_BITS] |= G_GUINT64_CONSTANT(1) << (index % MATCH_BITMAP_WORD_BITS);
+        }
+    }
+    g_free(bitmap->bits);
+    bitmap->bits = bits;
+    bitmap->capacity = MAX(words, 1);
+    bitmap->length = length;
+    bitmap->lines_generation = new_lines_generation;
+    bitmap->valid = FALSE;
+    g_rw_lock_writer_unlock(&bitmap->lock);
+}
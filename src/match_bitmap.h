@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_MATCH_BITMAP_H
+#define ROFI_BLOCKS_MATCH_BITMAP_H
+#include <gmodule.h>
+#include "trace.h"
+
+// whether line index matches the query; called from worker threads
+typedef gboolean (*MatchBitmapFunc)(gpointer context, guint index);
+
+// sorted lines that may match the query, NULL when any line may; the
+// bitmap frees the array
+typedef GArray* (*MatchBitmapCandidatesFunc)(gpointer context);
+
+// Which lines match the current query, one bit per line. The bitmap is
+// computed for every line at once, split across a thread pool, the first
+// time a line is tested after the query or the lines changed; every other
+// test is a bit lookup.
+typedef struct {
+    GThreadPool* pool;
+    guint threads;
+    GRWLock lock;         // written while the bitmap is computed
+    guint64* bits;
+    gsize capacity;       // words allocated for bits
+    guint length;         // lines the bitmap was computed for
+    gboolean valid;
+    guint64 query_generation;
+    guint64 lines_generation;
+
+    // batch being computed by the pool
+    MatchBitmapFunc match;
+    gpointer context;
+    GMutex batch_lock;
+    GCond batch_done;
+    guint pending_tasks;
+    Trace* trace;         // spans of computing the bitmap, may be NULL
+    guint64 matched_lines; // in total, for statistics
+} MatchBitmap;
+
+// threads is the size of the pool, 0 for one per processor
+MatchBitmap* match_bitmap_new(guint threads);
+
+void match_bitmap_destroy(MatchBitmap* bitmap);
+
+// Tests line index, computing the whole bitmap with match first if it was
+// computed for other generations or number of lines. When candidates is set,
+// only the lines it returns are matched. Safe to call from several threads
+// at once.
+gboolean match_bitmap_test(MatchBitmap* bitmap, guint64 query_generation, guint64 lines_generation, guint length,
+                           MatchBitmapFunc match, MatchBitmapCandidatesFunc candidates, gpointer context, guint index);
+
+// Sorted lines that matched the previous query, to narrow the next one down
+// from them, along with lines added by match_bitmap_remap since. NULL when
+// the bitmap was computed for other lines. Only to be called from a
+// MatchBitmapCandidatesFunc, while the bitmap is locked.
+GArray* match_bitmap_get_matches(MatchBitmap* bitmap, guint64 lines_generation, guint length);
+
+// Moves the results for lines of lines_generation to where previous says
+// they now are, for the lines of new_lines_generation. Lines without a
+// previous index (G_MAXUINT) count as matches, so that match_bitmap_get_matches
+// returns them; every line is still matched again on the next test.
+void match_bitmap_remap(MatchBitmap* bitmap, guint64 lines_generation, guint64 new_lines_generation,
+                        const guint* previous, guint length);
+
+#endif // ROFI_BLOCKS_MATCH_BITMAP_H
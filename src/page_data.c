@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 // Copyright (C) 2020 Omar Castro
-#include "json_glib_extensions.h"
 #include "page_data.h"
+#include "content_hash.h"
 #include <rofi/helper.h>
+#include <string.h>
+#include <pango/pango.h>
 
 static const gchar* EMPTY_STRING = "";
 
@@ -18,6 +20,9 @@ PageData* page_data_new() {
     page->case_sensitive = FALSE;
     page->input = g_string_sized_new(256);
     page->lines = g_array_new(FALSE, TRUE, sizeof(LineData));
+    page->arena = string_arena_new();
+    page->strings = string_intern_new();
+    g_mutex_init(&page->file_lines_lock);
     return page;
 }
 
@@ -32,6 +37,9 @@ void page_data_destroy(PageData* page) {
     page->trigger != NULL && g_string_free(page->trigger, TRUE);
     g_string_free(page->input, TRUE);
     g_array_free(page->lines, TRUE);
+    string_arena_destroy(page->arena);
+    string_intern_destroy(page->strings);
+    g_mutex_clear(&page->file_lines_lock);
     g_free(page);
 }
 
@@ -98,18 +106,332 @@ void page_data_set_filter(PageData* page, const char* filter) {
 
 
 
+// index in lines_file of the first line, the oldest ones are over max_lines
+static guint page_data_get_lines_file_first(PageData* page) {
+    guint count = page->lines_file->count;
+    return (page->max_lines > 0 && count > page->max_lines) ? count - page->max_lines : 0;
+}
+
+static LineData* page_data_get_file_line(PageData* page, guint index);
+
+static LineData* page_data_get_virtual_line(PageData* page, guint index, LineData* else_value);
+
 size_t page_data_get_number_of_lines(PageData* page) {
+    if (page->virtual_blocks != NULL) {
+        return page->virtual_count;
+    } else if (page->lines_file != NULL) {
+        return page->lines_file->count - page_data_get_lines_file_first(page);
+    }
     return page->lines->len;
 }
 
 LineData* page_data_get_line_by_index_or_else(PageData* page, unsigned int index, LineData* else_value) {
-    if (page == NULL || index >= page->lines->len) {
+    if (page == NULL || index >= page_data_get_number_of_lines(page)) {
         return else_value;
+    } else if (page->virtual_blocks != NULL) {
+        return page_data_get_virtual_line(page, index, else_value);
+    } else if (page->lines_file != NULL) {
+        return page_data_get_file_line(page, page_data_get_lines_file_first(page) + index);
+    }
+    guint position = page->lines_head + index;
+    if (position >= page->lines->len) {
+        position -= page->lines->len;
+    }
+    LineData* result = &g_array_index(page->lines, LineData, position);
+    return result;
+}
+
+static void line_data_free_strings(PageData* page, LineData* line) {
+    if (line->strings_chunk != NULL) {
+        string_arena_release(page->arena, line->strings_chunk);
+    }
+    string_intern_unref(page->strings, line->meta);
+    string_intern_unref(page->strings, line->icon);
+    string_intern_unref(page->strings, line->data);
+}
+
+static guint64 line_data_hash(LineData* line) {
+    guint64 hash = content_hash_string(line->text, 0);
+    hash = content_hash_string(line->meta, hash);
+    hash = content_hash_string(line->icon, hash);
+    hash = content_hash_string(line->data, hash);
+    guint8 flags = line->urgent | line->highlight << 1 | line->markup << 2 | line->nonselectable << 3 | line->filter << 4;
+    return content_hash(&flags, sizeof(flags), hash);
+}
+
+// copies string at the cursor of an arena allocation
+static gchar* line_data_copy_string(gchar** cursor, const gchar* string, gsize length) {
+    if (string == NULL) {
+        return NULL;
     }
-    LineData* result = &g_array_index(page->lines, LineData, index);
+    gchar* result = *cursor;
+    memcpy(result, string, length + 1);
+    *cursor += length + 1;
     return result;
 }
 
+// moves the first line back to the start of the array
+static void page_data_unwrap_lines(PageData* page) {
+    if (page->lines_head == 0) {
+        return;
+    }
+    GArray* lines = page->lines;
+    GArray* unwrapped = g_array_sized_new(FALSE, TRUE, sizeof(LineData), lines->len);
+    g_array_append_vals(unwrapped, &g_array_index(lines, LineData, page->lines_head), lines->len - page->lines_head);
+    g_array_append_vals(unwrapped, lines->data, page->lines_head);
+    g_array_free(lines, TRUE);
+    page->lines = unwrapped;
+    page->lines_head = 0;
+}
+
+// drops the oldest lines above max_lines
+static void page_data_trim_lines(PageData* page) {
+    GArray* lines = page->lines;
+    if (page->max_lines == 0 || lines->len <= page->max_lines) {
+        return;
+    }
+    page_data_unwrap_lines(page);
+    lines = page->lines;
+    guint evicted = lines->len - page->max_lines;
+    for (guint i = 0; i < evicted; ++i) {
+        line_data_free_strings(page, &g_array_index(lines, LineData, i));
+    }
+    g_array_remove_range(lines, 0, evicted);
+}
+
+void page_data_set_max_lines(PageData* page, guint max_lines) {
+    if (page->max_lines == max_lines) {
+        return;
+    }
+    page_data_unwrap_lines(page);
+    page->max_lines = max_lines;
+    page->lines_generation++;
+    page->lines_reset_generation++;
+    page->lines_evicted = 0;
+    page_data_trim_lines(page);
+}
+
+// replaces the lines of page with the ones of source, leaving source empty
+void page_data_take_lines(PageData* page, PageData* source) {
+    page_data_clear_lines(page);
+    GArray* lines = page->lines;
+    StringArena* arena = page->arena;
+    StringIntern* strings = page->strings;
+    page->lines = source->lines;
+    page->lines_head = source->lines_head;
+    page->arena = source->arena;
+    page->strings = source->strings;
+    page->lines_file = source->lines_file;
+    page->file_lines = source->file_lines;
+    page->virtual_blocks = source->virtual_blocks;
+    page->virtual_count = source->virtual_count;
+    source->lines = lines;
+    source->lines_head = 0;
+    source->arena = arena;
+    source->strings = strings;
+    source->lines_file = NULL;
+    source->file_lines = NULL;
+    source->virtual_blocks = NULL;
+    source->virtual_count = 0;
+    source->lines_generation++;
+    source->lines_reset_generation++;
+    source->lines_evicted = 0;
+    page_data_unwrap_lines(page);
+    page_data_trim_lines(page);
+}
+
+
+// the plain text of the markup, or NULL when it does not parse
+static gchar* line_data_strip_markup(const gchar* markup) {
+    gchar* text = NULL;
+    if (!pango_parse_markup(markup, -1, 0, NULL, &text, NULL, NULL)) {
+        return NULL;
+    }
+    return text;
+}
+
+// stripped text of the strings matched against the filter, NULL when they
+// are matched as they are: meta is always matched without markup, text only
+// when it is markup
+static gchar* line_data_strip_match_text(const gchar* label, const gchar* meta, gboolean markup) {
+    if (meta != NULL) {
+        return line_data_strip_markup(meta);
+    } else if (markup && label != NULL) {
+        return line_data_strip_markup(label);
+    }
+    return NULL;
+}
+
+// reads a line of lines_file the first time it is needed; its strings stay
+// in the mapping, only the stripped match text is copied to the arena. Lines
+// already read are found without locking: their text is published last. The
+// markup is stripped outside of the lock, which is only held to fill the line
+// and allocate from the arena, so filter threads read new lines in parallel.
+static LineData* page_data_get_file_line(PageData* page, guint index) {
+    LineData* line = &((LineData*) page->file_lines)[index];
+    if (g_atomic_pointer_get(&line->text) != NULL) {
+        return line;
+    }
+    LinesFileEntry entry;
+    if (!lines_file_get_entry(page->lines_file, index, &entry)) {
+        g_warning("invalid line %u in lines file", index);
+        entry = (LinesFileEntry) { .text = EMPTY_STRING, .icon = EMPTY_STRING, .data = EMPTY_STRING };
+    }
+    gboolean markup = (entry.flags & LinesFileFlag_MARKUP_SET)
+        ? (entry.flags & LinesFileFlag_MARKUP) != 0
+        : page->markup_default == MarkupStatus_ENABLED;
+    gchar* stripped = line_data_strip_match_text(entry.text, entry.meta, markup);
+
+    g_mutex_lock(&page->file_lines_lock);
+    if (line->text != NULL) {
+        // read by another thread meanwhile
+        g_mutex_unlock(&page->file_lines_lock);
+        g_free(stripped);
+        return line;
+    }
+    line->meta = (gchar*) entry.meta;
+    line->icon = (gchar*) entry.icon;
+    line->data = (gchar*) entry.data;
+    line->urgent = (entry.flags & LinesFileFlag_URGENT) != 0;
+    line->highlight = (entry.flags & LinesFileFlag_HIGHLIGHT) != 0;
+    line->markup = markup;
+    line->nonselectable = (entry.flags & LinesFileFlag_NONSELECTABLE) != 0;
+    line->filter = (entry.flags & LinesFileFlag_NO_FILTER) == 0;
+    if (stripped != NULL) {
+        gsize length = strlen(stripped);
+        gchar* cursor = string_arena_alloc(page->arena, length + 1, &line->strings_chunk);
+        line->match_text = line_data_copy_string(&cursor, stripped, length);
+    } else {
+        line->match_text = (gchar*) (entry.meta != NULL ? entry.meta : entry.text);
+    }
+    g_atomic_pointer_set(&line->text, (gchar*) entry.text);
+    g_mutex_unlock(&page->file_lines_lock);
+    g_free(stripped);
+    return line;
+}
+
+// turns the lines of lines_file into regular lines, for lines to be appended
+static void page_data_copy_lines_file(PageData* page) {
+    LinesFile* file = page->lines_file;
+    guint first = page_data_get_lines_file_first(page);
+    string_arena_reset(page->arena);
+    page->lines_file = NULL;
+    g_free(page->file_lines);
+    page->file_lines = NULL;
+    for (guint i = first; i < file->count; ++i) {
+        LinesFileEntry entry;
+        if (!lines_file_get_entry(file, i, &entry)) {
+            entry = (LinesFileEntry) { .text = EMPTY_STRING, .icon = EMPTY_STRING, .data = EMPTY_STRING };
+        }
+        gboolean markup = (entry.flags & LinesFileFlag_MARKUP_SET)
+            ? (entry.flags & LinesFileFlag_MARKUP) != 0
+            : page->markup_default == MarkupStatus_ENABLED;
+        page_data_add_line(page, entry.text, entry.meta, entry.icon, entry.data,
+                           (entry.flags & LinesFileFlag_URGENT) != 0,
+                           (entry.flags & LinesFileFlag_HIGHLIGHT) != 0,
+                           markup,
+                           (entry.flags & LinesFileFlag_NONSELECTABLE) != 0,
+                           (entry.flags & LinesFileFlag_NO_FILTER) == 0);
+    }
+    lines_file_destroy(file);
+}
+
+void page_data_set_lines_file(PageData* page, LinesFile* file) {
+    page_data_clear_lines(page);
+    page->lines_file = file;
+    page->file_lines = g_new0(LineData, file->count);
+}
+
+gboolean page_data_write_lines_file(PageData* page, const gchar* path, GError** error) {
+    guint count = page_data_get_number_of_lines(page);
+    LinesFileEntry* entries = g_new0(LinesFileEntry, count);
+    for (guint i = 0; i < count; ++i) {
+        LineData* line = page_data_get_line_by_index_or_else(page, i, NULL);
+        entries[i] = (LinesFileEntry) {
+            .text = line->text,
+            .meta = line->meta,
+            .icon = line->icon,
+            .data = line->data,
+            .flags = (line->urgent ? LinesFileFlag_URGENT : 0)
+                | (line->highlight ? LinesFileFlag_HIGHLIGHT : 0)
+                | (line->markup ? LinesFileFlag_MARKUP : 0)
+                | LinesFileFlag_MARKUP_SET
+                | (line->nonselectable ? LinesFileFlag_NONSELECTABLE : 0)
+                | (line->filter ? 0 : LinesFileFlag_NO_FILTER)
+        };
+    }
+    gboolean written = lines_file_write(path, entries, count, error);
+    g_free(entries);
+    return written;
+}
+
+static void page_data_destroy_virtual_block(gpointer block) {
+    page_data_destroy((PageData*) block);
+}
+
+void page_data_set_virtual_lines(PageData* page, guint count) {
+    page_data_clear_lines(page);
+    page->virtual_blocks = lru_cache_new(PAGE_DATA_VIRTUAL_MAX_BLOCKS, page_data_destroy_virtual_block);
+    page->virtual_count = count;
+}
+
+gboolean page_data_is_virtual(PageData* page) {
+    return page->virtual_blocks != NULL;
+}
+
+static void page_data_add_block_memory_size(gpointer key, gpointer block, gpointer size) {
+    *((gsize*) size) += page_data_get_memory_size((PageData*) block);
+}
+
+gsize page_data_get_memory_size(PageData* page) {
+    gsize size = page->lines->len * sizeof(LineData) + page->arena->mapped + page->strings->bytes;
+    if (page->file_lines != NULL) {
+        size += page->lines_file->count * sizeof(LineData);
+    }
+    if (page->virtual_blocks != NULL) {
+        lru_cache_foreach(page->virtual_blocks, page_data_add_block_memory_size, &size);
+    }
+    return size;
+}
+
+static LineData* page_data_get_virtual_line(PageData* page, guint index, LineData* else_value) {
+    PageData* block = lru_cache_lookup(page->virtual_blocks, index / PAGE_DATA_VIRTUAL_BLOCK_SIZE);
+    if (block == NULL) {
+        return else_value;
+    }
+    return page_data_get_line_by_index_or_else(block, index % PAGE_DATA_VIRTUAL_BLOCK_SIZE, else_value);
+}
+
+guint page_data_set_virtual_window(PageData* page, guint offset, PageData* window) {
+    guint length = page_data_get_number_of_lines(window);
+    guint end = MIN((guint64) offset + length, page->virtual_count);
+    guint first_block = ((guint64) offset + PAGE_DATA_VIRTUAL_BLOCK_SIZE - 1) / PAGE_DATA_VIRTUAL_BLOCK_SIZE;
+    guint loaded = 0;
+    guint blocks = 0;
+    for (guint b = first_block; (guint64) b * PAGE_DATA_VIRTUAL_BLOCK_SIZE < end; ++b) {
+        guint block_start = b * PAGE_DATA_VIRTUAL_BLOCK_SIZE;
+        guint block_end = MIN(block_start + PAGE_DATA_VIRTUAL_BLOCK_SIZE, page->virtual_count);
+        if (block_end > end) {
+            break;
+        }
+        PageData* block = page_data_new();
+        for (guint i = block_start; i < block_end; ++i) {
+            LineData* line = page_data_get_line_by_index_or_else(window, i - offset, NULL);
+            page_data_add_line(block, line->text, line->meta, line->icon, line->data, line->urgent,
+                               line->highlight, line->markup, line->nonselectable, line->filter);
+        }
+        lru_cache_insert(page->virtual_blocks, b, block);
+        loaded += block_end - block_start;
+        blocks++;
+    }
+    if (loaded < length) {
+        g_debug("dropped %u lines of a window not covering whole blocks", length - loaded);
+    }
+    if (blocks > 0) {
+        page->lines_generation++;
+    }
+    return blocks;
+}
 
 void page_data_add_line(PageData* page,
                         const gchar* label,
@@ -121,49 +443,159 @@ void page_data_add_line(PageData* page,
                         gboolean markup,
                         gboolean nonselectable,
                         gboolean filter) {
+    if (page->lines_file != NULL) {
+        page_data_copy_lines_file(page);
+    } else if (page->virtual_blocks != NULL) {
+        // lines the backend keeps cannot be appended to
+        page_data_clear_lines(page);
+    }
+    page->lines_generation++;
+    GArray* lines = page->lines;
+    LineData* oldest = NULL;
+    if (page->max_lines > 0 && lines->len >= page->max_lines) {
+        // released first, so that its chunk can be reused right away
+        oldest = &g_array_index(lines, LineData, page->lines_head);
+        line_data_free_strings(page, oldest);
+    }
+    gchar* stripped = line_data_strip_match_text(label, meta, markup);
+    // the strings unique to the line share a single arena allocation, the
+    // ones that tend to repeat across lines are interned
+    gsize label_length = label != NULL ? strlen(label) : 0;
+    gsize stripped_length = stripped != NULL ? strlen(stripped) : 0;
+    gsize size = label_length + stripped_length + 2;
+    StringArenaChunk* strings_chunk;
+    gchar* cursor = string_arena_alloc(page->arena, size, &strings_chunk);
     LineData line = {
-        .text = g_strdup(label),
-        .meta = g_strdup(meta),
-        .icon = g_strdup(icon),
-        .data = g_strdup(data),
+        .text = line_data_copy_string(&cursor, label, label_length),
+        .meta = (gchar*) string_intern_ref(page->strings, meta),
+        .icon = (gchar*) string_intern_ref(page->strings, icon),
+        .data = (gchar*) string_intern_ref(page->strings, data),
+        .match_text = line_data_copy_string(&cursor, stripped, stripped_length),
+        .strings_chunk = strings_chunk,
         .urgent = urgent,
         .highlight = highlight,
         .markup = markup,
         .nonselectable = nonselectable,
         .filter = filter
     };
-    g_array_append_val(page->lines, line);
+    g_free(stripped);
+    line.hash = line_data_hash(&line);
+    if (line.match_text == NULL) {
+        line.match_text = line.meta != NULL ? line.meta : line.text;
+    }
+    if (oldest != NULL) {
+        // ring buffer is full, the new line takes the place of the oldest
+        *oldest = line;
+        page->lines_evicted++;
+        page->lines_head = (page->lines_head + 1) % lines->len;
+    } else {
+        g_array_append_val(lines, line);
+    }
+}
+
+static gboolean line_data_equal(LineData* a, LineData* b) {
+    return a->hash == b->hash
+        && a->urgent == b->urgent && a->highlight == b->highlight && a->markup == b->markup
+        && a->nonselectable == b->nonselectable && a->filter == b->filter
+        && g_strcmp0(a->text, b->text) == 0 && g_strcmp0(a->meta, b->meta) == 0
+        && g_strcmp0(a->icon, b->icon) == 0 && g_strcmp0(a->data, b->data) == 0;
+}
+
+static void line_data_keep_cache(LineData* line, LineData* previous) {
+    line->icon_fetch_uid = previous->icon_fetch_uid;
 }
 
-void page_data_add_line_json_node(PageData* page, JsonNode* node) {
-    if (JSON_NODE_HOLDS_VALUE(node) && json_node_get_value_type(node) == G_TYPE_STRING) {
-        page_data_add_line(page, json_node_get_string(node), NULL, EMPTY_STRING, EMPTY_STRING, FALSE, FALSE, page->markup_default == MarkupStatus_ENABLED, FALSE, TRUE);
-    } else if (JSON_NODE_HOLDS_OBJECT(node)) {
-        JsonObject* line_obj = json_node_get_object(node);
-        const gchar* text = json_object_get_string_member_or_else(line_obj, "text", EMPTY_STRING);
-        const gchar* meta = json_object_get_string_member_or_else(line_obj, "meta", NULL);
-        const gchar* icon = json_object_get_string_member_or_else(line_obj, "icon", EMPTY_STRING);
-        const gchar* data = json_object_get_string_member_or_else(line_obj, "data", EMPTY_STRING);
-        gboolean urgent = json_object_get_boolean_member_or_else(line_obj, "urgent", FALSE);
-        gboolean highlight = json_object_get_boolean_member_or_else(line_obj, "highlight", FALSE);
-        gboolean markup = json_object_get_boolean_member_or_else(line_obj, "markup", page->markup_default == MarkupStatus_ENABLED);
-        gboolean nonselectable = json_object_get_boolean_member_or_else(line_obj, "nonselectable", FALSE);
-        gboolean filter = json_object_get_boolean_member_or_else(line_obj, "filter", TRUE);
-        page_data_add_line(page, text, meta, icon, data, urgent, highlight, markup, nonselectable, filter);
+gboolean page_data_match_lines(PageData* page, PageData* source, GArray* previous) {
+    guint length = page_data_get_number_of_lines(source);
+    guint page_length = page_data_get_number_of_lines(page);
+    g_array_set_size(previous, length);
+    guint* previous_index = (guint*) previous->data;
+    if (page->lines_file != NULL || source->lines_file != NULL
+            || page->virtual_blocks != NULL || source->virtual_blocks != NULL) {
+        // lines of lines files and virtual pages are only read when needed,
+        // and never hashed
+        memset(previous_index, 0xff, length * sizeof(guint));
+        return FALSE;
     }
+
+    // lines in the same place first, as most lines do not move
+    guint same = 0;
+    for (; same < MIN(length, page_length); ++same) {
+        LineData* line = page_data_get_line_by_index_or_else(source, same, NULL);
+        LineData* page_line = page_data_get_line_by_index_or_else(page, same, NULL);
+        if (!line_data_equal(line, page_line)) {
+            break;
+        }
+        line_data_keep_cache(line, page_line);
+        previous_index[same] = same;
+    }
+    if (same == length && same == page_length) {
+        return TRUE;
+    }
+
+    // the other lines by hash, equal lines are paired in order: each hash
+    // maps to the first unpaired line having it, next chains the others
+    GHashTable* first_with_hash = g_hash_table_new(g_int64_hash, g_int64_equal);
+    guint* next = g_new(guint, page_length);
+    for (guint i = page_length; i > same; --i) {
+        LineData* page_line = page_data_get_line_by_index_or_else(page, i - 1, NULL);
+        gpointer head = g_hash_table_lookup(first_with_hash, &page_line->hash);
+        next[i - 1] = head != NULL ? GPOINTER_TO_UINT(head) - 1 : G_MAXUINT;
+        g_hash_table_insert(first_with_hash, &page_line->hash, GUINT_TO_POINTER(i));
+    }
+    guint kept = same;
+    for (guint i = same; i < length; ++i) {
+        LineData* line = page_data_get_line_by_index_or_else(source, i, NULL);
+        gpointer head = g_hash_table_lookup(first_with_hash, &line->hash);
+        previous_index[i] = G_MAXUINT;
+        if (head == NULL) {
+            continue;
+        }
+        guint index = GPOINTER_TO_UINT(head) - 1;
+        LineData* page_line = page_data_get_line_by_index_or_else(page, index, NULL);
+        if (!line_data_equal(line, page_line)) {
+            continue; // hash collision
+        }
+        if (next[index] == G_MAXUINT) {
+            g_hash_table_remove(first_with_hash, &page_line->hash);
+        } else {
+            g_hash_table_insert(first_with_hash, &page_line->hash, GUINT_TO_POINTER(next[index] + 1));
+        }
+        line_data_keep_cache(line, page_line);
+        previous_index[i] = index;
+        kept++;
+    }
+    g_debug("%u of %u lines did not change", kept, length);
+    g_hash_table_destroy(first_with_hash);
+    g_free(next);
+    return FALSE;
 }
 
 void page_data_clear_lines(PageData* page) {
-    GArray* lines = page->lines;
-    int size = lines->len;
-    for (int i = 0; i < size; ++i) {
-        LineData line = g_array_index(lines, LineData, i);
-        g_free(line.text);
-        g_free(line.meta);
-        g_free(line.icon);
-        g_free(line.data);
+    if (page->lines_file != NULL) {
+        lines_file_destroy(page->lines_file);
+        page->lines_file = NULL;
+        g_free(page->file_lines);
+        page->file_lines = NULL;
+    }
+    if (page->virtual_blocks != NULL) {
+        lru_cache_destroy(page->virtual_blocks);
+        page->virtual_blocks = NULL;
+        page->virtual_count = 0;
+    }
+    string_intern_log_stats(page->strings);
+    for (guint i = 0; i < page->lines->len; ++i) {
+        LineData* line = &g_array_index(page->lines, LineData, i);
+        string_intern_unref(page->strings, line->meta);
+        string_intern_unref(page->strings, line->icon);
+        string_intern_unref(page->strings, line->data);
     }
+    string_arena_reset(page->arena);
+    page->lines_generation++;
+    page->lines_reset_generation++;
+    page->lines_evicted = 0;
     g_array_set_size(page->lines, 0);
+    page->lines_head = 0;
 }
 
 
@@ -5,7 +5,15 @@
 #define ROFI_BLOCKS_PAGE_DATA_H
 #include <gmodule.h>
 #include <stdint.h>
-#include <json-glib/json-glib.h>
+#include "string_arena.h"
+#include "lines_file.h"
+#include "string_intern.h"
+#include "lru_cache.h"
+
+// lines of a virtual page are fetched from the backend in blocks of this many
+#define PAGE_DATA_VIRTUAL_BLOCK_SIZE 64
+// blocks of a virtual page kept at once
+#define PAGE_DATA_VIRTUAL_MAX_BLOCKS 256
 
 typedef enum {
     MarkupStatus_UNDEFINED = 0,
@@ -25,6 +33,21 @@ typedef struct {
     GString* filter;
     GString* trigger;
     GArray* lines;
+    guint lines_head; // array index of the first line, once the ring wrapped
+    guint max_lines; // 0 when unbounded
+    StringArena* arena; // owns the text of every line
+    StringIntern* strings; // owns their meta, icon and data
+    LinesFile* lines_file; // when set, lines are read from it instead
+    gpointer file_lines; // LineData of lines_file, zeroed until first read
+    GMutex file_lines_lock; // held to fill lines of lines_file, which filter
+                            // threads read
+    LruCache* virtual_blocks; // when set, lines are fetched by block instead,
+                              // a PageData each; only read from the main loop
+    guint virtual_count;
+    guint64 lines_generation; // changes whenever lines do
+    guint64 lines_reset_generation; // changes when lines are removed, not appended
+    guint64 lines_evicted; // oldest lines the full ring dropped to append
+                           // others, since lines_reset_generation changed
 } PageData;
 
 typedef struct {
@@ -32,12 +55,15 @@ typedef struct {
     gchar* meta;
     gchar* icon;
     gchar* data;
+    gchar* match_text; // text matched against the filter, with markup stripped
     gboolean urgent;
     gboolean highlight;
     gboolean markup;
     gboolean nonselectable;
     gboolean filter;
     uint32_t icon_fetch_uid; //cache icon uid
+    guint64 hash; // of the content, 0 for lines of a lines file
+    StringArenaChunk* strings_chunk; // arena chunk holding text and match text
 } LineData;
 
 PageData* page_data_new();
@@ -75,8 +101,37 @@ void page_data_add_line(PageData* page,
                         gboolean nonselectable,
                         gboolean filter);
 
-void page_data_add_line_json_node(PageData* page, JsonNode* node);
-
 void page_data_clear_lines(PageData* page);
 
+void page_data_set_max_lines(PageData* page, guint max_lines);
+
+void page_data_take_lines(PageData* page, PageData* source);
+
+// Finds, for every line of source, an equal line of page, and carries over
+// what page cached about it. previous receives the index in page of each
+// line of source, G_MAXUINT for lines that are new or changed. Returns
+// whether source has the same lines as page, in the same order.
+gboolean page_data_match_lines(PageData* page, PageData* source, GArray* previous);
+
+// replaces the lines of page with the ones of file, which the page now owns
+void page_data_set_lines_file(PageData* page, LinesFile* file);
+
+// Writes the lines of page as a lines file at path, with their markup
+gboolean page_data_write_lines_file(PageData* page, const gchar* path, GError** error);
+
+// Replaces the lines of page with count lines the backend keeps, none of them
+// loaded: getting a line that is not loaded returns the else value
+void page_data_set_virtual_lines(PageData* page, guint count);
+
+gboolean page_data_is_virtual(PageData* page);
+
+// Approximate bytes held by the lines of page: their data, strings and
+// loaded virtual blocks. Lines files count their lines, not their mapping.
+gsize page_data_get_memory_size(PageData* page);
+
+// Loads the lines of window in a virtual page, the first one at offset. Only
+// whole blocks are kept, and the least recently used ones are evicted.
+// Returns how many blocks were loaded, from the first one starting at offset.
+guint page_data_set_virtual_window(PageData* page, guint offset, PageData* window);
+
 #endif // ROFI_BLOCKS_PAGE_DATA_H
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <errno.h>
+#include <stdlib.h>
+#include "page_snapshot.h"
+#include "string_utils.h"
+
+G_DEFINE_QUARK(page-snapshot-error-quark, page_snapshot_error)
+
+static gchar* page_snapshot_get_directory(void) {
+    return g_build_filename(g_get_user_cache_dir(), "rofi-blocks", NULL);
+}
+
+// path of the snapshot file of key with extension
+static gchar* page_snapshot_get_path(const gchar* key, const gchar* extension) {
+    gchar* directory = page_snapshot_get_directory();
+    gchar* digest = g_compute_checksum_for_string(G_CHECKSUM_SHA256, key, -1);
+    gchar* name = g_strdup_printf("%s%s", digest, extension);
+    gchar* path = g_build_filename(directory, name, NULL);
+    g_free(name);
+    g_free(digest);
+    g_free(directory);
+    return path;
+}
+
+static void page_snapshot_append_string(GString* payload, const gchar* name, const gchar* value) {
+    g_string_append_printf(payload, "%s\"%s\": ", payload->len > 1 ? ", " : "", name);
+    if (value == NULL) {
+        g_string_append(payload, "null");
+        return;
+    }
+    char* escaped = str_new_escaped_for_json_string(value);
+    g_string_append_printf(payload, "\"%s\"", escaped);
+    free(escaped);
+}
+
+static const gchar* page_snapshot_get_string(GString* member) {
+    return member != NULL ? member->str : NULL;
+}
+
+gboolean page_snapshot_save(PageData* page, const gchar* key, GError** error) {
+    if (page_data_is_virtual(page)) {
+        g_debug("not saving a snapshot of virtual lines");
+        return TRUE;
+    }
+    gchar* lines_path = page_snapshot_get_path(key, ".lines");
+    gchar* payload_path = page_snapshot_get_path(key, ".json");
+    gchar* directory = page_snapshot_get_directory();
+    gboolean saved = FALSE;
+    if (g_mkdir_with_parents(directory, 0700) != 0) {
+        g_set_error(error, PAGE_SNAPSHOT_ERROR, 0, "unable to create %s: %s", directory, g_strerror(errno));
+    } else if (page_data_write_lines_file(page, lines_path, error)) {
+        GString* payload = g_string_new("{");
+        page_snapshot_append_string(payload, "prompt", page_snapshot_get_string(page->prompt));
+        page_snapshot_append_string(payload, "message", page_snapshot_get_string(page->message));
+        page_snapshot_append_string(payload, "icon", page_snapshot_get_string(page->icon));
+        page_snapshot_append_string(payload, "lines_file", lines_path);
+        g_string_append(payload, "}\n");
+        saved = g_file_set_contents(payload_path, payload->str, payload->len, error);
+        g_string_free(payload, TRUE);
+    }
+    g_free(directory);
+    g_free(payload_path);
+    g_free(lines_path);
+    return saved;
+}
+
+gchar* page_snapshot_load(const gchar* key, gsize* length) {
+    gchar* payload_path = page_snapshot_get_path(key, ".json");
+    gchar* payload = NULL;
+    if (!g_file_get_contents(payload_path, &payload, length, NULL)) {
+        g_debug("no snapshot at %s", payload_path);
+        payload = NULL;
+    }
+    g_free(payload_path);
+    return payload;
+}
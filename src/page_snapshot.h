@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_PAGE_SNAPSHOT_H
+#define ROFI_BLOCKS_PAGE_SNAPSHOT_H
+#include <gmodule.h>
+#include "page_data.h"
+
+#define PAGE_SNAPSHOT_ERROR page_snapshot_error_quark()
+
+// The last page shown for a backend, saved in the user cache directory under
+// a key such as its command, to be shown on the next launch until the
+// backend sends its first payload. A snapshot is a lines file, mapped when
+// loaded, and a payload setting the prompt, message and icon along with it.
+
+GQuark page_snapshot_error_quark(void);
+
+// Saves the lines, prompt, message and icon of page. Virtual lines are not
+// saved.
+gboolean page_snapshot_save(PageData* page, const gchar* key, GError** error);
+
+// JSON payload restoring the page saved under key, NULL when there is none
+gchar* page_snapshot_load(const gchar* key, gsize* length);
+
+#endif // ROFI_BLOCKS_PAGE_SNAPSHOT_H
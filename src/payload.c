@@ -0,0 +1,602 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stddef.h>
+#include <string.h>
+#include "payload.h"
+#include "payload_msgpack.h"
+
+// Streaming parser for output payloads. Instead of building a JsonNode tree,
+// the top level object is read straight into a Payload: strings are unescaped
+// in place and arrays of lines are only validated and counted. Lines are
+// built into LineData later, with payload_build_lines, and only for the
+// arrays that end up being used.
+
+static const gchar* EMPTY_STRING = "";
+
+// nesting allowed inside values we do not know about
+static const guint MAX_DEPTH = 512;
+
+typedef struct {
+    gchar* begin;
+    gchar* cursor;
+    gchar* end;
+} JsonCursor;
+
+static const struct {
+    const gchar* name;
+    PayloadFieldType type;
+    size_t offset;
+} PAYLOAD_FIELDS[] = {
+    { "icon", PayloadField_STRING, offsetof(Payload, icon) },
+    { "placeholder", PayloadField_STRING, offsetof(Payload, placeholder) },
+    { "filter", PayloadField_STRING, offsetof(Payload, filter) },
+    { "message", PayloadField_STRING, offsetof(Payload, message) },
+    { "overlay", PayloadField_STRING, offsetof(Payload, overlay) },
+    { "prompt", PayloadField_STRING, offsetof(Payload, prompt) },
+    { "input", PayloadField_STRING, offsetof(Payload, input) },
+    { "trigger", PayloadField_STRING, offsetof(Payload, trigger) },
+    { "event_format", PayloadField_STRING, offsetof(Payload, event_format) },
+    { "lines_file", PayloadField_STRING, offsetof(Payload, lines_file) },
+    { "case_sensitive", PayloadField_BOOLEAN, offsetof(Payload, case_sensitive) },
+    { "close_on_exit", PayloadField_BOOLEAN, offsetof(Payload, close_on_exit) },
+    { "stats", PayloadField_BOOLEAN, offsetof(Payload, stats) },
+    { "selected_line", PayloadField_INT, offsetof(Payload, selected_line) },
+    { "max_lines", PayloadField_INT, offsetof(Payload, max_lines) },
+    { "lines_count", PayloadField_INT, offsetof(Payload, lines_count) },
+    { "lines_offset", PayloadField_INT, offsetof(Payload, lines_offset) },
+    { "debounce", PayloadField_EVENT_DELAYS, offsetof(Payload, debounce) },
+    { "throttle", PayloadField_EVENT_DELAYS, offsetof(Payload, throttle) },
+    { "lines", PayloadField_LINES, offsetof(Payload, lines) },
+    { "lines_append", PayloadField_LINES, offsetof(Payload, lines_append) },
+};
+
+G_DEFINE_QUARK(payload-error-quark, payload_error)
+
+
+//// tokenizer
+
+static int json_cursor_peek(JsonCursor* c) {
+    while (c->cursor < c->end) {
+        switch (*c->cursor) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            c->cursor++;
+            break;
+        default:
+            return (guchar) *c->cursor;
+        }
+    }
+    return -1;
+}
+
+static gboolean json_cursor_expect(JsonCursor* c, gchar expected) {
+    if (json_cursor_peek(c) != expected) {
+        return FALSE;
+    }
+    c->cursor++;
+    return TRUE;
+}
+
+static gboolean json_cursor_read_hex4(const gchar* in, gunichar* result) {
+    gunichar value = 0;
+    for (int i = 0; i < 4; ++i) {
+        int digit = g_ascii_xdigit_value(in[i]);
+        if (digit < 0) {
+            return FALSE;
+        }
+        value = (value << 4) | digit;
+    }
+    *result = value;
+    return TRUE;
+}
+
+// The cursor is on the opening quote. When value is not NULL, the string is
+// unescaped in place (escapes never get longer once decoded) and NUL
+// terminated; otherwise it is only validated.
+static gboolean json_cursor_scan_string(JsonCursor* c, gchar** value) {
+    gboolean decode = value != NULL;
+    gchar* in = c->cursor + 1;
+    gchar* out = in;
+    gchar* end = c->end;
+    while (in < end) {
+        gchar ch = *in;
+        if (ch == '"') {
+            if (decode) {
+                *out = '\0';
+                *value = c->cursor + 1;
+            }
+            c->cursor = in + 1;
+            return TRUE;
+        } else if (ch != '\\') {
+            if (decode) {
+                *(out++) = ch;
+            }
+            in++;
+            continue;
+        }
+
+        if (in + 1 >= end) {
+            return FALSE;
+        }
+        gchar escaped = in[1];
+        in += 2;
+        switch (escaped) {
+        case '"':
+        case '\\':
+        case '/':
+            ch = escaped;
+            break;
+        case 'b':
+            ch = '\b';
+            break;
+        case 'f':
+            ch = '\f';
+            break;
+        case 'n':
+            ch = '\n';
+            break;
+        case 'r':
+            ch = '\r';
+            break;
+        case 't':
+            ch = '\t';
+            break;
+        case 'u': {
+            gunichar codepoint;
+            if (in + 4 > end || !json_cursor_read_hex4(in, &codepoint)) {
+                return FALSE;
+            }
+            in += 4;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                gunichar low;
+                if (in + 6 <= end && in[0] == '\\' && in[1] == 'u'
+                    && json_cursor_read_hex4(in + 2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                } else {
+                    codepoint = 0xFFFD;
+                }
+            } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                codepoint = 0xFFFD;
+            }
+            if (decode) {
+                out += g_unichar_to_utf8(codepoint, out);
+            }
+            continue;
+        }
+        default:
+            return FALSE;
+        }
+        if (decode) {
+            *(out++) = ch;
+        }
+    }
+    return FALSE;
+}
+
+static gboolean json_cursor_scan_number(JsonCursor* c, gboolean* is_integer, gint64* value) {
+    gchar* begin = c->cursor;
+    gchar* p = begin;
+    gchar* end = c->end;
+    gboolean integer = TRUE;
+
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p < end && *p == '0') {
+        p++;
+    } else if (p < end && *p >= '1' && *p <= '9') {
+        while (p < end && g_ascii_isdigit(*p)) { p++; }
+    } else {
+        return FALSE;
+    }
+    if (p < end && *p == '.') {
+        integer = FALSE;
+        p++;
+        if (p >= end || !g_ascii_isdigit(*p)) { return FALSE; }
+        while (p < end && g_ascii_isdigit(*p)) { p++; }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        integer = FALSE;
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) { p++; }
+        if (p >= end || !g_ascii_isdigit(*p)) { return FALSE; }
+        while (p < end && g_ascii_isdigit(*p)) { p++; }
+    }
+
+    gchar digits[24];
+    gsize length = p - begin;
+    if (integer && length < sizeof(digits)) {
+        memcpy(digits, begin, length);
+        digits[length] = '\0';
+        *value = g_ascii_strtoll(digits, NULL, 10);
+    } else {
+        integer = FALSE;
+    }
+    *is_integer = integer;
+    c->cursor = p;
+    return TRUE;
+}
+
+static gboolean json_cursor_scan_literal(JsonCursor* c, const gchar* literal) {
+    gsize length = strlen(literal);
+    if ((gsize) (c->end - c->cursor) < length || memcmp(c->cursor, literal, length) != 0) {
+        return FALSE;
+    }
+    c->cursor += length;
+    return TRUE;
+}
+
+static gboolean json_cursor_skip_value(JsonCursor* c, guint depth);
+
+static gboolean json_cursor_skip_array(JsonCursor* c, guint depth, guint* count) {
+    guint elements = 0;
+    c->cursor++;
+    if (json_cursor_peek(c) == ']') {
+        c->cursor++;
+    } else {
+        while (TRUE) {
+            if (!json_cursor_skip_value(c, depth + 1)) {
+                return FALSE;
+            }
+            elements++;
+            int next = json_cursor_peek(c);
+            if (next != ']' && next != ',') {
+                return FALSE;
+            }
+            c->cursor++;
+            if (next == ']') {
+                break;
+            }
+        }
+    }
+    if (count != NULL) {
+        *count = elements;
+    }
+    return TRUE;
+}
+
+// Reads up to the value of the next object member. The cursor must be past
+// the opening brace (first) or past the previous value. *key is set to NULL
+// once the closing brace was read.
+static gboolean json_cursor_next_member(JsonCursor* c, gboolean first, gchar** key, gboolean decode) {
+    int next = json_cursor_peek(c);
+    if (next == '}') {
+        c->cursor++;
+        *key = NULL;
+        return TRUE;
+    }
+    if (!first) {
+        if (next != ',') {
+            return FALSE;
+        }
+        c->cursor++;
+        next = json_cursor_peek(c);
+    }
+    if (next != '"') {
+        return FALSE;
+    }
+    if (!json_cursor_scan_string(c, decode ? key : NULL)) {
+        return FALSE;
+    }
+    if (!decode) {
+        *key = (gchar*) EMPTY_STRING; // any key but NULL
+    }
+    return json_cursor_expect(c, ':');
+}
+
+static gboolean json_cursor_skip_object(JsonCursor* c, guint depth) {
+    gchar* key;
+    c->cursor++;
+    for (gboolean first = TRUE; ; first = FALSE) {
+        if (!json_cursor_next_member(c, first, &key, FALSE)) {
+            return FALSE;
+        } else if (key == NULL) {
+            return TRUE;
+        } else if (!json_cursor_skip_value(c, depth + 1)) {
+            return FALSE;
+        }
+    }
+}
+
+// validates a value without modifying it
+static gboolean json_cursor_skip_value(JsonCursor* c, guint depth) {
+    gboolean is_integer;
+    gint64 value;
+    if (depth > MAX_DEPTH) {
+        return FALSE;
+    }
+    switch (json_cursor_peek(c)) {
+    case '"':
+        return json_cursor_scan_string(c, NULL);
+    case '{':
+        return json_cursor_skip_object(c, depth);
+    case '[':
+        return json_cursor_skip_array(c, depth, NULL);
+    case 't':
+        return json_cursor_scan_literal(c, "true");
+    case 'f':
+        return json_cursor_scan_literal(c, "false");
+    case 'n':
+        return json_cursor_scan_literal(c, "null");
+    default:
+        return json_cursor_scan_number(c, &is_integer, &value);
+    }
+}
+
+
+//// payload fields
+
+// Values of the wrong type are ignored, as if the member was not there
+static gboolean payload_parse_string(JsonCursor* c, PayloadString* field) {
+    gchar* value;
+    switch (json_cursor_peek(c)) {
+    case '"':
+        if (!json_cursor_scan_string(c, &value)) {
+            return FALSE;
+        }
+        field->present = TRUE;
+        field->value = value;
+        return TRUE;
+    case 'n':
+        field->present = TRUE;
+        field->value = NULL;
+        return json_cursor_scan_literal(c, "null");
+    default:
+        field->present = FALSE;
+        return json_cursor_skip_value(c, 1);
+    }
+}
+
+static gboolean payload_parse_boolean(JsonCursor* c, PayloadBoolean* field) {
+    switch (json_cursor_peek(c)) {
+    case 't':
+        field->present = TRUE;
+        field->value = TRUE;
+        return json_cursor_scan_literal(c, "true");
+    case 'f':
+        field->present = TRUE;
+        field->value = FALSE;
+        return json_cursor_scan_literal(c, "false");
+    default:
+        field->present = FALSE;
+        return json_cursor_skip_value(c, 1);
+    }
+}
+
+static gboolean payload_parse_int(JsonCursor* c, PayloadInt* field) {
+    int next = json_cursor_peek(c);
+    field->present = TRUE;
+    field->is_integer = FALSE;
+    if (next == '-' || g_ascii_isdigit(next)) {
+        return json_cursor_scan_number(c, &field->is_integer, &field->value);
+    }
+    return json_cursor_skip_value(c, 1);
+}
+
+static gboolean payload_parse_event_delays(JsonCursor* c, PayloadEventDelays* field) {
+    memset(field, 0, sizeof(*field));
+    if (json_cursor_peek(c) != '{') {
+        return json_cursor_skip_value(c, 1);
+    }
+    gchar* key;
+    c->cursor++;
+    for (gboolean first = TRUE; ; first = FALSE) {
+        gboolean valid;
+        if (!json_cursor_next_member(c, first, &key, TRUE)) {
+            return FALSE;
+        } else if (key == NULL) {
+            return TRUE;
+        } else if (strcmp(key, "input") == 0) {
+            valid = payload_parse_int(c, &field->input);
+        } else if (strcmp(key, "select_entry") == 0) {
+            valid = payload_parse_int(c, &field->select_entry);
+        } else {
+            valid = json_cursor_skip_value(c, 2);
+        }
+        if (!valid) {
+            return FALSE;
+        }
+    }
+}
+
+static gboolean payload_parse_lines(JsonCursor* c, PayloadLines* field) {
+    if (json_cursor_peek(c) != '[') {
+        field->start = NULL;
+        return json_cursor_skip_value(c, 1);
+    }
+    field->start = c->cursor;
+    field->format = PayloadFormat_JSON;
+    if (!json_cursor_skip_array(c, 1, &field->count)) {
+        return FALSE;
+    }
+    field->length = c->cursor - field->start;
+    return TRUE;
+}
+
+gpointer payload_lookup_field(Payload* payload, const gchar* key, gsize key_length, PayloadFieldType* type) {
+    for (gsize i = 0; i < G_N_ELEMENTS(PAYLOAD_FIELDS); ++i) {
+        const gchar* name = PAYLOAD_FIELDS[i].name;
+        if (strlen(name) == key_length && memcmp(name, key, key_length) == 0) {
+            *type = PAYLOAD_FIELDS[i].type;
+            return ((gchar*) payload) + PAYLOAD_FIELDS[i].offset;
+        }
+    }
+    return NULL;
+}
+
+static gboolean payload_parse_member(JsonCursor* c, Payload* payload, const gchar* key) {
+    PayloadFieldType type;
+    gpointer field = payload_lookup_field(payload, key, strlen(key), &type);
+    if (field == NULL) {
+        return json_cursor_skip_value(c, 1);
+    }
+    switch (type) {
+    case PayloadField_STRING:
+        return payload_parse_string(c, field);
+    case PayloadField_BOOLEAN:
+        return payload_parse_boolean(c, field);
+    case PayloadField_INT:
+        return payload_parse_int(c, field);
+    case PayloadField_EVENT_DELAYS:
+        return payload_parse_event_delays(c, field);
+    case PayloadField_LINES:
+        return payload_parse_lines(c, field);
+    }
+    return FALSE;
+}
+
+gboolean payload_parse_json(Payload* payload, gchar* json, gsize length, GError** error) {
+    JsonCursor c = { .begin = json, .cursor = json, .end = json + length };
+    memset(payload, 0, sizeof(*payload));
+
+    gboolean valid = json_cursor_peek(&c) == '{';
+    if (valid) {
+        gchar* key;
+        c.cursor++;
+        for (gboolean first = TRUE; ; first = FALSE) {
+            valid = json_cursor_next_member(&c, first, &key, TRUE);
+            if (!valid || key == NULL) {
+                break;
+            }
+            valid = payload_parse_member(&c, payload, key);
+            if (!valid) {
+                break;
+            }
+        }
+    }
+    valid = valid && json_cursor_peek(&c) == -1;
+
+    if (!valid) {
+        g_set_error(error, PAYLOAD_ERROR, 0, "invalid JSON object at offset %" G_GSIZE_FORMAT,
+                    (gsize) (c.cursor - c.begin));
+    }
+    return valid;
+}
+
+
+//// lines
+
+static gboolean payload_parse_line_string(JsonCursor* c, const gchar** value, const gchar* else_value) {
+    gchar* str;
+    if (json_cursor_peek(c) == '"') {
+        if (!json_cursor_scan_string(c, &str)) {
+            return FALSE;
+        }
+        *value = str;
+        return TRUE;
+    }
+    *value = else_value;
+    return json_cursor_skip_value(c, 1);
+}
+
+static gboolean payload_parse_line_boolean(JsonCursor* c, gboolean* value, gboolean else_value) {
+    PayloadBoolean field;
+    if (!payload_parse_boolean(c, &field)) {
+        return FALSE;
+    }
+    *value = field.present ? field.value : else_value;
+    return TRUE;
+}
+
+static gboolean payload_build_line(JsonCursor* c, PageData* page, gboolean markup_default) {
+    int next = json_cursor_peek(c);
+    if (next == '"') {
+        gchar* text;
+        if (!json_cursor_scan_string(c, &text)) {
+            return FALSE;
+        }
+        page_data_add_line(page, text, NULL, EMPTY_STRING, EMPTY_STRING, FALSE, FALSE, markup_default, FALSE, TRUE);
+        return TRUE;
+    } else if (next != '{') {
+        return json_cursor_skip_value(c, 1);
+    }
+
+    const gchar* text = EMPTY_STRING;
+    const gchar* meta = NULL;
+    const gchar* icon = EMPTY_STRING;
+    const gchar* data = EMPTY_STRING;
+    gboolean urgent = FALSE;
+    gboolean highlight = FALSE;
+    gboolean markup = markup_default;
+    gboolean nonselectable = FALSE;
+    gboolean filter = TRUE;
+
+    gchar* key;
+    gboolean valid = TRUE;
+    c->cursor++;
+    for (gboolean first = TRUE; valid; first = FALSE) {
+        if (!json_cursor_next_member(c, first, &key, TRUE)) {
+            return FALSE;
+        } else if (key == NULL) {
+            break;
+        } else if (strcmp(key, "text") == 0) {
+            valid = payload_parse_line_string(c, &text, EMPTY_STRING);
+        } else if (strcmp(key, "meta") == 0) {
+            valid = payload_parse_line_string(c, &meta, NULL);
+        } else if (strcmp(key, "icon") == 0) {
+            valid = payload_parse_line_string(c, &icon, EMPTY_STRING);
+        } else if (strcmp(key, "data") == 0) {
+            valid = payload_parse_line_string(c, &data, EMPTY_STRING);
+        } else if (strcmp(key, "urgent") == 0) {
+            valid = payload_parse_line_boolean(c, &urgent, FALSE);
+        } else if (strcmp(key, "highlight") == 0) {
+            valid = payload_parse_line_boolean(c, &highlight, FALSE);
+        } else if (strcmp(key, "markup") == 0) {
+            valid = payload_parse_line_boolean(c, &markup, markup_default);
+        } else if (strcmp(key, "nonselectable") == 0) {
+            valid = payload_parse_line_boolean(c, &nonselectable, FALSE);
+        } else if (strcmp(key, "filter") == 0) {
+            valid = payload_parse_line_boolean(c, &filter, TRUE);
+        } else {
+            valid = json_cursor_skip_value(c, 1);
+        }
+    }
+    if (valid) {
+        page_data_add_line(page, text, meta, icon, data, urgent, highlight, markup, nonselectable, filter);
+    }
+    return valid;
+}
+
+// Builds the lines of a validated array into the page, leaving out the first
+// skip ones. Strings are unescaped in place, the array can be built only once.
+void payload_build_lines(PayloadLines* lines, PageData* page, guint skip) {
+    if (lines->start == NULL) {
+        return;
+    } else if (lines->format == PayloadFormat_MSGPACK) {
+        payload_msgpack_build_lines(lines, page, skip);
+        return;
+    }
+    JsonCursor c = { .begin = lines->start, .cursor = lines->start + 1, .end = lines->start + lines->length };
+    gboolean markup_default = page->markup_default == MarkupStatus_ENABLED;
+    for (guint i = 0; i < lines->count; ++i) {
+        if (i > 0 && !json_cursor_expect(&c, ',')) {
+            break;
+        }
+        gboolean valid = i < skip
+            ? json_cursor_skip_value(&c, 1)
+            : payload_build_line(&c, page, markup_default);
+        if (!valid) {
+            g_warning("stopped building lines at offset %" G_GSIZE_FORMAT, (gsize) (c.cursor - c.begin));
+            break;
+        }
+    }
+    lines->start = NULL;
+}
+
+guint payload_lines_to_skip(PayloadLines* lines, guint max_lines) {
+    return (max_lines > 0 && lines->count > max_lines) ? lines->count - max_lines : 0;
+}
+
+guint payload_get_max_lines(Payload* payload) {
+    gint64 max_lines = payload->max_lines.is_integer ? payload->max_lines.value : 0;
+    return (guint) CLAMP(max_lines, 0, G_MAXUINT);
+}
+
+gboolean payload_is_idempotent(Payload* payload) {
+    return !payload->input.present && !payload->trigger.present && !payload->selected_line.present
+        && payload->lines_append.start == NULL && !payload->lines_file.present
+        && !payload->lines_count.present && !(payload->stats.present && payload->stats.value);
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_PAYLOAD_H
+#define ROFI_BLOCKS_PAYLOAD_H
+#include <gmodule.h>
+#include "page_data.h"
+
+#define PAYLOAD_ERROR payload_error_quark()
+
+typedef enum {
+    PayloadFormat_JSON,
+    PayloadFormat_MSGPACK
+} PayloadFormat;
+
+typedef enum {
+    PayloadField_STRING,
+    PayloadField_BOOLEAN,
+    PayloadField_INT,
+    PayloadField_EVENT_DELAYS,
+    PayloadField_LINES
+} PayloadFieldType;
+
+typedef struct {
+    gboolean present;
+    const gchar* value; // NULL when the payload sets it to null
+} PayloadString;
+
+typedef struct {
+    gboolean present;
+    gboolean value;
+} PayloadBoolean;
+
+typedef struct {
+    gboolean present;
+    gboolean is_integer;
+    gint64 value;
+} PayloadInt;
+
+// Delays, in milliseconds, of the events that newer ones supersede
+typedef struct {
+    PayloadInt input;
+    PayloadInt select_entry;
+} PayloadEventDelays;
+
+// A validated, not yet built, array of lines inside the payload buffer
+typedef struct {
+    gchar* start; // NULL when absent
+    gsize length;
+    guint count;
+    PayloadFormat format;
+} PayloadLines;
+
+// Output payload fields, as read from a single line. Strings are decoded in
+// place and point into the parsed buffer.
+typedef struct {
+    PayloadString icon;
+    PayloadString placeholder;
+    PayloadString filter;
+    PayloadString message;
+    PayloadString overlay;
+    PayloadString prompt;
+    PayloadString input;
+    PayloadString trigger;
+    PayloadString event_format;
+    PayloadString lines_file;
+    PayloadBoolean case_sensitive;
+    PayloadBoolean close_on_exit;
+    PayloadBoolean stats;    // asks for a STATS event
+    PayloadInt selected_line;
+    PayloadInt max_lines;
+    PayloadInt lines_count;  // makes the lines virtual, fetched on demand
+    PayloadInt lines_offset; // of lines, a window of the virtual lines
+    PayloadEventDelays debounce;
+    PayloadEventDelays throttle;
+    PayloadLines lines;
+    PayloadLines lines_append;
+} Payload;
+
+GQuark payload_error_quark(void);
+
+gboolean payload_parse_json(Payload* payload, gchar* json, gsize length, GError** error);
+
+gboolean payload_parse_msgpack(Payload* payload, gchar* msgpack, gsize length, GError** error);
+
+// Member of payload named key, NULL when there is none
+gpointer payload_lookup_field(Payload* payload, const gchar* key, gsize key_length, PayloadFieldType* type);
+
+void payload_build_lines(PayloadLines* lines, PageData* page, guint skip);
+
+// Lines at the start of lines that max_lines would evict right away, and
+// are therefore never built
+guint payload_lines_to_skip(PayloadLines* lines, guint max_lines);
+
+// The max_lines field, when present, 0 meaning unbounded
+guint payload_get_max_lines(Payload* payload);
+
+// Whether applying payload again right after itself changes nothing: every
+// field sets state, except the ones that act each time they are received
+gboolean payload_is_idempotent(Payload* payload);
+
+#endif // ROFI_BLOCKS_PAYLOAD_H
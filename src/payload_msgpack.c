@@ -0,0 +1,492 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <string.h>
+#include "payload_msgpack.h"
+
+// Parser for output payloads sent as MessagePack maps, the binary counterpart
+// of the JSON one: the top level map is read straight into a Payload, and
+// arrays of lines are only validated until they are built. Like the JSON of
+// a line, the whole payload is rejected when any string is not UTF-8, so that
+// building lines never stops halfway. Strings are NUL terminated in place by
+// moving them back over their own header.
+
+static const gchar* EMPTY_STRING = "";
+
+// nesting allowed inside values we do not know about
+static const guint MAX_DEPTH = 512;
+
+typedef struct {
+    guchar* begin;
+    guchar* cursor;
+    guchar* end;
+} MsgpackCursor;
+
+typedef enum {
+    MsgpackType_NIL,
+    MsgpackType_BOOLEAN,
+    MsgpackType_INT,
+    MsgpackType_FLOAT,
+    MsgpackType_STR,
+    MsgpackType_BIN,
+    MsgpackType_EXT,
+    MsgpackType_ARRAY,
+    MsgpackType_MAP
+} MsgpackType;
+
+typedef struct {
+    MsgpackType type;
+    guchar* start;   // first byte of the header
+    guint64 length;  // bytes that follow the header, or elements of arrays and members of maps
+    gint64 integer;  // value of integers and booleans
+} MsgpackValue;
+
+
+//// tokenizer
+
+static gboolean msgpack_cursor_read_uint(MsgpackCursor* c, guint bytes, guint64* value) {
+    if ((gsize) (c->end - c->cursor) < bytes) {
+        return FALSE;
+    }
+    guint64 result = 0;
+    for (guint i = 0; i < bytes; ++i) {
+        result = (result << 8) | c->cursor[i];
+    }
+    c->cursor += bytes;
+    *value = result;
+    return TRUE;
+}
+
+static gboolean msgpack_cursor_read_sized(MsgpackCursor* c, MsgpackValue* value, MsgpackType type, guint size_bytes) {
+    value->type = type;
+    return msgpack_cursor_read_uint(c, size_bytes, &value->length);
+}
+
+static gboolean msgpack_cursor_read_integer(MsgpackCursor* c, MsgpackValue* value, guint bytes, gboolean is_signed) {
+    guint64 raw;
+    if (!msgpack_cursor_read_uint(c, bytes, &raw)) {
+        return FALSE;
+    }
+    value->type = MsgpackType_INT;
+    if (!is_signed) {
+        value->integer = raw > G_MAXINT64 ? G_MAXINT64 : (gint64) raw;
+    } else if (bytes == 8) {
+        value->integer = (gint64) raw;
+    } else {
+        // sign extends the value to 64 bits
+        guint shift = 64 - bytes * 8;
+        value->integer = ((gint64) (raw << shift)) >> shift;
+    }
+    return TRUE;
+}
+
+// Reads the header of the next value, the cursor is left at its contents
+static gboolean msgpack_cursor_read_header(MsgpackCursor* c, MsgpackValue* value) {
+    if (c->cursor >= c->end) {
+        return FALSE;
+    }
+    value->start = c->cursor;
+    value->length = 0;
+    value->integer = 0;
+    guchar byte = *(c->cursor++);
+    if (byte <= 0x7f || byte >= 0xe0) {
+        value->type = MsgpackType_INT;
+        value->integer = (gint8) byte;
+        value->integer = byte <= 0x7f ? byte : value->integer;
+        return TRUE;
+    } else if (byte <= 0x8f) {
+        value->type = MsgpackType_MAP;
+        value->length = byte & 0x0f;
+        return TRUE;
+    } else if (byte <= 0x9f) {
+        value->type = MsgpackType_ARRAY;
+        value->length = byte & 0x0f;
+        return TRUE;
+    } else if (byte <= 0xbf) {
+        value->type = MsgpackType_STR;
+        value->length = byte & 0x1f;
+        return TRUE;
+    }
+    switch (byte) {
+    case 0xc0:
+        value->type = MsgpackType_NIL;
+        return TRUE;
+    case 0xc2:
+    case 0xc3:
+        value->type = MsgpackType_BOOLEAN;
+        value->integer = byte == 0xc3;
+        return TRUE;
+    case 0xc4: return msgpack_cursor_read_sized(c, value, MsgpackType_BIN, 1);
+    case 0xc5: return msgpack_cursor_read_sized(c, value, MsgpackType_BIN, 2);
+    case 0xc6: return msgpack_cursor_read_sized(c, value, MsgpackType_BIN, 4);
+    case 0xc7:
+    case 0xc8:
+    case 0xc9:
+        // the extension type byte follows the size
+        if (!msgpack_cursor_read_sized(c, value, MsgpackType_EXT, 1 << (byte - 0xc7))) {
+            return FALSE;
+        }
+        value->length++;
+        return TRUE;
+    case 0xca:
+    case 0xcb:
+        value->type = MsgpackType_FLOAT;
+        value->length = byte == 0xca ? 4 : 8;
+        return TRUE;
+    case 0xcc: return msgpack_cursor_read_integer(c, value, 1, FALSE);
+    case 0xcd: return msgpack_cursor_read_integer(c, value, 2, FALSE);
+    case 0xce: return msgpack_cursor_read_integer(c, value, 4, FALSE);
+    case 0xcf: return msgpack_cursor_read_integer(c, value, 8, FALSE);
+    case 0xd0: return msgpack_cursor_read_integer(c, value, 1, TRUE);
+    case 0xd1: return msgpack_cursor_read_integer(c, value, 2, TRUE);
+    case 0xd2: return msgpack_cursor_read_integer(c, value, 4, TRUE);
+    case 0xd3: return msgpack_cursor_read_integer(c, value, 8, TRUE);
+    case 0xd4:
+    case 0xd5:
+    case 0xd6:
+    case 0xd7:
+    case 0xd8:
+        value->type = MsgpackType_EXT;
+        value->length = 1 + (1 << (byte - 0xd4));
+        return TRUE;
+    case 0xd9: return msgpack_cursor_read_sized(c, value, MsgpackType_STR, 1);
+    case 0xda: return msgpack_cursor_read_sized(c, value, MsgpackType_STR, 2);
+    case 0xdb: return msgpack_cursor_read_sized(c, value, MsgpackType_STR, 4);
+    case 0xdc: return msgpack_cursor_read_sized(c, value, MsgpackType_ARRAY, 2);
+    case 0xdd: return msgpack_cursor_read_sized(c, value, MsgpackType_ARRAY, 4);
+    case 0xde: return msgpack_cursor_read_sized(c, value, MsgpackType_MAP, 2);
+    case 0xdf: return msgpack_cursor_read_sized(c, value, MsgpackType_MAP, 4);
+    default:
+        return FALSE; // 0xc1 is never used
+    }
+}
+
+static gboolean msgpack_cursor_skip_bytes(MsgpackCursor* c, guint64 length) {
+    if ((guint64) (c->end - c->cursor) < length) {
+        return FALSE;
+    }
+    c->cursor += length;
+    return TRUE;
+}
+
+static gboolean msgpack_cursor_skip_string(MsgpackCursor* c, MsgpackValue* value) {
+    if ((guint64) (c->end - c->cursor) < value->length
+            || !g_utf8_validate((gchar*) c->cursor, (gssize) value->length, NULL)) {
+        return FALSE;
+    }
+    c->cursor += value->length;
+    return TRUE;
+}
+
+static gboolean msgpack_cursor_skip_value(MsgpackCursor* c, guint depth);
+
+// validates the contents of a value whose header was read, without modifying it
+static gboolean msgpack_cursor_skip_contents(MsgpackCursor* c, MsgpackValue* value, guint depth) {
+    switch (value->type) {
+    case MsgpackType_STR:
+        return msgpack_cursor_skip_string(c, value);
+    case MsgpackType_FLOAT:
+    case MsgpackType_BIN:
+    case MsgpackType_EXT:
+        return msgpack_cursor_skip_bytes(c, value->length);
+    case MsgpackType_ARRAY:
+    case MsgpackType_MAP: {
+        guint64 elements = value->type == MsgpackType_MAP ? value->length * 2 : value->length;
+        for (guint64 i = 0; i < elements; ++i) {
+            if (!msgpack_cursor_skip_value(c, depth + 1)) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    default:
+        return TRUE;
+    }
+}
+
+static gboolean msgpack_cursor_skip_value(MsgpackCursor* c, guint depth) {
+    MsgpackValue value;
+    if (depth > MAX_DEPTH || !msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    }
+    return msgpack_cursor_skip_contents(c, &value, depth);
+}
+
+// Moves the contents of a str value that was validated back over its header,
+// which is at least one byte long, to NUL terminate it in place
+static gboolean msgpack_cursor_move_string(MsgpackCursor* c, MsgpackValue* value, gchar** result) {
+    gsize length = value->length;
+    if ((guint64) (c->end - c->cursor) < value->length) {
+        return FALSE;
+    }
+    memmove(value->start, c->cursor, length);
+    value->start[length] = '\0';
+    c->cursor += length;
+    *result = (gchar*) value->start;
+    return TRUE;
+}
+
+static gboolean msgpack_cursor_decode_string(MsgpackCursor* c, MsgpackValue* value, gchar** result) {
+    if ((guint64) (c->end - c->cursor) < value->length
+            || !g_utf8_validate((gchar*) c->cursor, (gssize) value->length, NULL)) {
+        return FALSE;
+    }
+    return msgpack_cursor_move_string(c, value, result);
+}
+
+// Reads a map key, which is left as is and not NUL terminated
+static gboolean msgpack_cursor_read_key(MsgpackCursor* c, const gchar** key, gsize* key_length) {
+    MsgpackValue value;
+    if (!msgpack_cursor_read_header(c, &value) || value.type != MsgpackType_STR) {
+        return FALSE;
+    }
+    *key = (const gchar*) c->cursor;
+    *key_length = value.length;
+    return msgpack_cursor_skip_bytes(c, value.length);
+}
+
+static gboolean msgpack_key_equals(const gchar* key, gsize key_length, const gchar* name) {
+    return strlen(name) == key_length && memcmp(key, name, key_length) == 0;
+}
+
+
+//// payload fields
+
+// Values of the wrong type are ignored, as if the member was not there
+static gboolean payload_msgpack_parse_string(MsgpackCursor* c, PayloadString* field) {
+    MsgpackValue value;
+    gchar* str;
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    }
+    switch (value.type) {
+    case MsgpackType_STR:
+        if (!msgpack_cursor_decode_string(c, &value, &str)) {
+            return FALSE;
+        }
+        field->present = TRUE;
+        field->value = str;
+        return TRUE;
+    case MsgpackType_NIL:
+        field->present = TRUE;
+        field->value = NULL;
+        return TRUE;
+    default:
+        field->present = FALSE;
+        return msgpack_cursor_skip_contents(c, &value, 1);
+    }
+}
+
+static gboolean payload_msgpack_parse_boolean(MsgpackCursor* c, PayloadBoolean* field) {
+    MsgpackValue value;
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    }
+    field->present = value.type == MsgpackType_BOOLEAN;
+    field->value = value.integer != 0;
+    return msgpack_cursor_skip_contents(c, &value, 1);
+}
+
+static gboolean payload_msgpack_parse_int(MsgpackCursor* c, PayloadInt* field) {
+    MsgpackValue value;
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    }
+    field->present = TRUE;
+    field->is_integer = value.type == MsgpackType_INT;
+    field->value = value.integer;
+    return msgpack_cursor_skip_contents(c, &value, 1);
+}
+
+static gboolean payload_msgpack_parse_event_delays(MsgpackCursor* c, PayloadEventDelays* field) {
+    MsgpackValue value;
+    memset(field, 0, sizeof(*field));
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    } else if (value.type != MsgpackType_MAP) {
+        return msgpack_cursor_skip_contents(c, &value, 1);
+    }
+    for (guint64 i = 0; i < value.length; ++i) {
+        const gchar* key;
+        gsize key_length;
+        gboolean valid = msgpack_cursor_read_key(c, &key, &key_length);
+        if (valid && msgpack_key_equals(key, key_length, "input")) {
+            valid = payload_msgpack_parse_int(c, &field->input);
+        } else if (valid && msgpack_key_equals(key, key_length, "select_entry")) {
+            valid = payload_msgpack_parse_int(c, &field->select_entry);
+        } else if (valid) {
+            valid = msgpack_cursor_skip_value(c, 2);
+        }
+        if (!valid) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean payload_msgpack_parse_lines(MsgpackCursor* c, PayloadLines* field) {
+    MsgpackValue value;
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    } else if (value.type != MsgpackType_ARRAY) {
+        field->start = NULL;
+        return msgpack_cursor_skip_contents(c, &value, 1);
+    }
+    if (value.length > G_MAXUINT || !msgpack_cursor_skip_contents(c, &value, 1)) {
+        return FALSE;
+    }
+    field->start = (gchar*) value.start;
+    field->length = c->cursor - value.start;
+    field->count = value.length;
+    field->format = PayloadFormat_MSGPACK;
+    return TRUE;
+}
+
+static gboolean payload_msgpack_parse_member(MsgpackCursor* c, Payload* payload, const gchar* key, gsize key_length) {
+    PayloadFieldType type;
+    gpointer field = payload_lookup_field(payload, key, key_length, &type);
+    if (field == NULL) {
+        return msgpack_cursor_skip_value(c, 1);
+    }
+    switch (type) {
+    case PayloadField_STRING:
+        return payload_msgpack_parse_string(c, field);
+    case PayloadField_BOOLEAN:
+        return payload_msgpack_parse_boolean(c, field);
+    case PayloadField_INT:
+        return payload_msgpack_parse_int(c, field);
+    case PayloadField_EVENT_DELAYS:
+        return payload_msgpack_parse_event_delays(c, field);
+    case PayloadField_LINES:
+        return payload_msgpack_parse_lines(c, field);
+    }
+    return FALSE;
+}
+
+gboolean payload_parse_msgpack(Payload* payload, gchar* msgpack, gsize length, GError** error) {
+    guchar* begin = (guchar*) msgpack;
+    MsgpackCursor c = { .begin = begin, .cursor = begin, .end = begin + length };
+    memset(payload, 0, sizeof(*payload));
+
+    MsgpackValue map;
+    gboolean valid = msgpack_cursor_read_header(&c, &map) && map.type == MsgpackType_MAP;
+    for (guint64 i = 0; valid && i < map.length; ++i) {
+        const gchar* key;
+        gsize key_length;
+        valid = msgpack_cursor_read_key(&c, &key, &key_length)
+            && payload_msgpack_parse_member(&c, payload, key, key_length);
+    }
+    valid = valid && c.cursor == c.end;
+
+    if (!valid) {
+        g_set_error(error, PAYLOAD_ERROR, 0, "invalid MessagePack map at offset %" G_GSIZE_FORMAT,
+                    (gsize) (c.cursor - c.begin));
+    }
+    return valid;
+}
+
+
+//// lines
+
+// strings of lines were validated when the payload was parsed
+
+static gboolean payload_msgpack_parse_line_string(MsgpackCursor* c, const gchar** result, const gchar* else_value) {
+    MsgpackValue value;
+    gchar* str;
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    } else if (value.type != MsgpackType_STR) {
+        *result = else_value;
+        return msgpack_cursor_skip_contents(c, &value, 1);
+    } else if (!msgpack_cursor_move_string(c, &value, &str)) {
+        return FALSE;
+    }
+    *result = str;
+    return TRUE;
+}
+
+static gboolean payload_msgpack_parse_line_boolean(MsgpackCursor* c, gboolean* result, gboolean else_value) {
+    PayloadBoolean field;
+    if (!payload_msgpack_parse_boolean(c, &field)) {
+        return FALSE;
+    }
+    *result = field.present ? field.value : else_value;
+    return TRUE;
+}
+
+static gboolean payload_msgpack_build_line(MsgpackCursor* c, PageData* page, gboolean markup_default) {
+    MsgpackValue value;
+    if (!msgpack_cursor_read_header(c, &value)) {
+        return FALSE;
+    } else if (value.type == MsgpackType_STR) {
+        gchar* text;
+        if (!msgpack_cursor_move_string(c, &value, &text)) {
+            return FALSE;
+        }
+        page_data_add_line(page, text, NULL, EMPTY_STRING, EMPTY_STRING, FALSE, FALSE, markup_default, FALSE, TRUE);
+        return TRUE;
+    } else if (value.type != MsgpackType_MAP) {
+        return msgpack_cursor_skip_contents(c, &value, 1);
+    }
+
+    const gchar* text = EMPTY_STRING;
+    const gchar* meta = NULL;
+    const gchar* icon = EMPTY_STRING;
+    const gchar* data = EMPTY_STRING;
+    gboolean urgent = FALSE;
+    gboolean highlight = FALSE;
+    gboolean markup = markup_default;
+    gboolean nonselectable = FALSE;
+    gboolean filter = TRUE;
+
+    for (guint64 i = 0; i < value.length; ++i) {
+        const gchar* key;
+        gsize key_length;
+        gboolean valid;
+        if (!msgpack_cursor_read_key(c, &key, &key_length)) {
+            return FALSE;
+        } else if (msgpack_key_equals(key, key_length, "text")) {
+            valid = payload_msgpack_parse_line_string(c, &text, EMPTY_STRING);
+        } else if (msgpack_key_equals(key, key_length, "meta")) {
+            valid = payload_msgpack_parse_line_string(c, &meta, NULL);
+        } else if (msgpack_key_equals(key, key_length, "icon")) {
+            valid = payload_msgpack_parse_line_string(c, &icon, EMPTY_STRING);
+        } else if (msgpack_key_equals(key, key_length, "data")) {
+            valid = payload_msgpack_parse_line_string(c, &data, EMPTY_STRING);
+        } else if (msgpack_key_equals(key, key_length, "urgent")) {
+            valid = payload_msgpack_parse_line_boolean(c, &urgent, FALSE);
+        } else if (msgpack_key_equals(key, key_length, "highlight")) {
+            valid = payload_msgpack_parse_line_boolean(c, &highlight, FALSE);
+        } else if (msgpack_key_equals(key, key_length, "markup")) {
+            valid = payload_msgpack_parse_line_boolean(c, &markup, markup_default);
+        } else if (msgpack_key_equals(key, key_length, "nonselectable")) {
+            valid = payload_msgpack_parse_line_boolean(c, &nonselectable, FALSE);
+        } else if (msgpack_key_equals(key, key_length, "filter")) {
+            valid = payload_msgpack_parse_line_boolean(c, &filter, TRUE);
+        } else {
+            valid = msgpack_cursor_skip_value(c, 1);
+        }
+        if (!valid) {
+            return FALSE;
+        }
+    }
+    page_data_add_line(page, text, meta, icon, data, urgent, highlight, markup, nonselectable, filter);
+    return TRUE;
+}
+
+void payload_msgpack_build_lines(PayloadLines* lines, PageData* page, guint skip) {
+    guchar* begin = (guchar*) lines->start;
+    MsgpackCursor c = { .begin = begin, .cursor = begin, .end = begin + lines->length };
+    MsgpackValue array;
+    gboolean markup_default = page->markup_default == MarkupStatus_ENABLED;
+    msgpack_cursor_read_header(&c, &array);
+    for (guint i = 0; i < lines->count; ++i) {
+        gboolean valid = i < skip
+            ? msgpack_cursor_skip_value(&c, 1)
+            : payload_msgpack_build_line(&c, page, markup_default);
+        if (!valid) {
+            g_warning("stopped building lines at offset %" G_GSIZE_FORMAT, (gsize) (c.cursor - c.begin));
+            break;
+        }
+    }
+    lines->start = NULL;
+}
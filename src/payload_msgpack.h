@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_PAYLOAD_MSGPACK_H
+#define ROFI_BLOCKS_PAYLOAD_MSGPACK_H
+#include "payload.h"
+
+// Builds lines parsed by payload_parse_msgpack, see payload_build_lines
+void payload_msgpack_build_lines(PayloadLines* lines, PageData* page, guint skip);
+
+#endif // ROFI_BLOCKS_PAYLOAD_MSGPACK_H
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "payload_reader.h"
+#include "content_hash.h"
+
+static void payload_reader_item_free(gpointer pointer) {
+    PayloadReaderItem* item = pointer;
+    if (item->lines != NULL) {
+        page_data_destroy(item->lines);
+    }
+    g_free(item->text);
+    g_free(item);
+}
+
+// main loop side: hands every queued item over
+static gboolean payload_reader_dispatch(gpointer context) {
+    PayloadReader* reader = context;
+    // cleared first, items pushed from now on schedule another dispatch
+    g_atomic_int_set(&reader->dispatch_pending, 0);
+    PayloadReaderItem* item;
+    while ((item = g_async_queue_try_pop(reader->items)) != NULL) {
+        reader->func(item, reader->context);
+        payload_reader_item_free(item);
+    }
+    reader->func(NULL, reader->context);
+    return G_SOURCE_REMOVE;
+}
+
+static void payload_reader_schedule_dispatch(PayloadReader* reader) {
+    if (g_atomic_int_compare_and_exchange(&reader->dispatch_pending, 0, 1)) {
+        g_idle_add(payload_reader_dispatch, reader);
+    }
+}
+
+static gboolean payload_reader_is_repeated(PayloadReader* reader, const gchar* text, gsize length) {
+    guint64 hash = content_hash(text, length, 0);
+    gboolean repeated = reader->payload_repeatable && reader->payload_hash == hash && reader->payload_length == length;
+    reader->payload_hash = hash;
+    reader->payload_length = length;
+    return repeated;
+}
+
+static void payload_reader_handle(PayloadReader* reader, const gchar* text, gsize length) {
+    stats_add(&reader->stats->payloads_received, 1);
+    stats_add(&reader->stats->bytes_read, length);
+    if (payload_reader_is_repeated(reader, text, length)) {
+        g_debug("skipping payload identical to the previous one");
+        stats_add(&reader->stats->payloads_coalesced, 1);
+        return;
+    }
+    PayloadReaderItem* item = g_malloc0(sizeof(*item));
+    // the reader buffer is reused by the next read, and the payload is
+    // handled once the main loop gets to it
+    item->text = g_malloc(length + 1);
+    memcpy(item->text, text, length);
+    item->text[length] = '\0';
+    GError* error = NULL;
+    gint64 start = g_get_monotonic_time();
+    gboolean parsed = reader->format == PayloadFormat_MSGPACK
+        ? payload_parse_msgpack(&item->payload, item->text, length, &error)
+        : payload_parse_json(&item->payload, item->text, length, &error);
+    stats_add_parse_time(reader->stats, g_get_monotonic_time() - start);
+    trace_end(reader->trace, "parse", start, "\"bytes\":%zu", length);
+    reader->payload_repeatable = FALSE;
+    if (!parsed) {
+        fprintf(stderr, "Unable to parse line: %s\n", error->message);
+        g_error_free(error);
+        payload_reader_item_free(item);
+        return;
+    }
+    Payload* payload = &item->payload;
+    reader->payload_repeatable = payload_is_idempotent(payload);
+    if (payload->max_lines.present) {
+        reader->max_lines = payload_get_max_lines(payload);
+    }
+    if (payload->lines.start != NULL) {
+        // a window of virtual lines is never trimmed to max_lines
+        guint max_lines = payload->lines_offset.present ? 0 : reader->max_lines;
+        item->lines = page_data_new();
+        item->lines->markup_default = reader->markup_default;
+        page_data_set_max_lines(item->lines, max_lines);
+        start = trace_begin(reader->trace);
+        payload_build_lines(&payload->lines, item->lines, payload_lines_to_skip(&payload->lines, max_lines));
+        trace_end(reader->trace, "build_lines", start, "\"lines\":%zu", page_data_get_number_of_lines(item->lines));
+    }
+    g_async_queue_push(reader->items, item);
+}
+
+static gpointer payload_reader_run(gpointer context) {
+    PayloadReader* reader = context;
+    struct pollfd fds[] = {
+        { .fd = reader->line_reader->fd, .events = POLLIN },
+        { .fd = reader->stop_pipe[0], .events = POLLIN }
+    };
+    while (TRUE) {
+        if (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            g_warning("unable to wait for payloads: %s", g_strerror(errno));
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        gint64 start = trace_begin(reader->trace);
+        LineReaderStatus status = line_reader_fill(reader->line_reader);
+        trace_end(reader->trace, "read", start, NULL);
+        gchar* text;
+        gsize length;
+        while (reader->format == PayloadFormat_MSGPACK
+               ? line_reader_next_frame(reader->line_reader, &text, &length)
+               : line_reader_next_line(reader->line_reader, &text, &length)) {
+            payload_reader_handle(reader, text, length);
+        }
+        payload_reader_schedule_dispatch(reader);
+        if (status == LineReaderStatus_EOF || status == LineReaderStatus_ERROR) {
+            g_debug("input closed, stopping reader thread");
+            break;
+        }
+    }
+    return NULL;
+}
+
+PayloadReader* payload_reader_new(int fd, PayloadFormat format, MarkupStatus markup_default, guint max_lines,
+                                  Trace* trace, Stats* stats, PayloadReaderFunc func, gpointer context) {
+    PayloadReader* reader = g_malloc0(sizeof(*reader));
+    reader->line_reader = line_reader_new(fd);
+    line_reader_set_framed(reader->line_reader, format == PayloadFormat_MSGPACK);
+    reader->format = format;
+    reader->markup_default = markup_default;
+    reader->max_lines = max_lines;
+    reader->trace = trace;
+    reader->stats = stats;
+    reader->items = g_async_queue_new_full(payload_reader_item_free);
+    reader->func = func;
+    reader->context = context;
+    if (pipe(reader->stop_pipe) != 0) {
+        g_error("unable to create reader thread pipe: %s", g_strerror(errno));
+    }
+    reader->thread = g_thread_new("blocks-reader", payload_reader_run, reader);
+    return reader;
+}
+
+void payload_reader_destroy(PayloadReader* reader) {
+    if (write(reader->stop_pipe[1], "", 1) != 1) {
+        g_warning("unable to stop reader thread: %s", g_strerror(errno));
+    }
+    g_thread_join(reader->thread);
+    close(reader->stop_pipe[0]);
+    close(reader->stop_pipe[1]);
+    while (g_source_remove_by_user_data(reader)) {
+        // a dispatch of items that are dropped
+    }
+    g_async_queue_unref(reader->items);
+    line_reader_destroy(reader->line_reader);
+    g_free(reader);
+}
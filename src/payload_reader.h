@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_PAYLOAD_READER_H
+#define ROFI_BLOCKS_PAYLOAD_READER_H
+#include <gmodule.h>
+#include "line_reader.h"
+#include "payload.h"
+#include "trace.h"
+#include "stats.h"
+
+// A payload read and parsed by the reader thread
+typedef struct {
+    gchar* text;      // the payload, parsed in place
+    Payload payload;  // pointing into text
+    PageData* lines;  // payload.lines built, NULL when it has none
+} PayloadReaderItem;
+
+// called on the main loop with each item, in order, then with NULL once the
+// items read so far were handled; items are freed afterwards
+typedef void (*PayloadReaderFunc)(PayloadReaderItem* item, gpointer context);
+
+// Reads payloads from a file descriptor on a thread of its own, which also
+// parses them and builds their lines, so that the main loop only applies
+// finished pages. Payloads identical to the previous one are dropped there.
+typedef struct {
+    GThread* thread;
+    LineReader* line_reader;
+    PayloadFormat format;
+    MarkupStatus markup_default;
+    guint max_lines;       // as set by the payloads read so far
+    int stop_pipe[2];      // written to, to stop the thread
+    GAsyncQueue* items;    // of PayloadReaderItem*, handed to the main loop
+    gint dispatch_pending; // whether an idle source will dispatch the items
+    PayloadReaderFunc func;
+    gpointer context;
+    guint64 payload_hash;  // of the last payload read
+    gsize payload_length;
+    gboolean payload_repeatable;
+    Trace* trace;          // may be NULL
+    Stats* stats;          // counts the payloads read and parsed
+} PayloadReader;
+
+// Starts reading fd, which must be non-blocking. Lines are built with the
+// markup default and max_lines of the page they go to. Reading, parsing and
+// building spans go to trace, when not NULL, and payloads are counted in
+// stats.
+PayloadReader* payload_reader_new(int fd, PayloadFormat format, MarkupStatus markup_default, guint max_lines,
+                                  Trace* trace, Stats* stats, PayloadReaderFunc func, gpointer context);
+
+// Stops the thread, dropping payloads that were not handled yet
+void payload_reader_destroy(PayloadReader* reader);
+
+#endif // ROFI_BLOCKS_PAYLOAD_READER_H
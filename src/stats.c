@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <string.h>
+#include "stats.h"
+
+void stats_init(Stats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->started = g_get_monotonic_time();
+}
+
+void stats_add_parse_time(Stats* stats, gint64 microseconds) {
+    // bucket i holds times up to 2^i microseconds
+    guint bucket = 0;
+    while (bucket < STATS_PARSE_TIME_BUCKETS - 1 && (G_GINT64_CONSTANT(1) << bucket) < microseconds) {
+        bucket++;
+    }
+    stats_add(&stats->parse_times[bucket], 1);
+}
+
+guint64 stats_get_parse_time_percentile(Stats* stats, guint percent) {
+    guint64 counts[STATS_PARSE_TIME_BUCKETS];
+    guint64 total = 0;
+    for (guint i = 0; i < STATS_PARSE_TIME_BUCKETS; ++i) {
+        counts[i] = stats_get(&stats->parse_times[i]);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // rank of the parse, counting from 1, under which percent of them are
+    guint64 rank = MAX((total * MIN(percent, 100) + 99) / 100, 1);
+    guint64 seen = 0;
+    for (guint i = 0; i < STATS_PARSE_TIME_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return G_GUINT64_CONSTANT(1) << i;
+        }
+    }
+    return G_GUINT64_CONSTANT(1) << (STATS_PARSE_TIME_BUCKETS - 1);
+}
+
+void stats_append_json(Stats* stats, GString* out) {
+    g_string_append_printf(out,
+        "\"uptime_ms\":%" G_GINT64_FORMAT ", \"payloads_received\":%" G_GUINT64_FORMAT
+        ", \"payloads_coalesced\":%" G_GUINT64_FORMAT ", \"bytes_read\":%" G_GUINT64_FORMAT
+        ", \"parse_time_us\":{\"p50\":%" G_GUINT64_FORMAT ", \"p90\":%" G_GUINT64_FORMAT
+        ", \"p99\":%" G_GUINT64_FORMAT ", \"max\":%" G_GUINT64_FORMAT "}",
+        (g_get_monotonic_time() - stats->started) / 1000, stats_get(&stats->payloads_received),
+        stats_get(&stats->payloads_coalesced), stats_get(&stats->bytes_read),
+        stats_get_parse_time_percentile(stats, 50), stats_get_parse_time_percentile(stats, 90),
+        stats_get_parse_time_percentile(stats, 99), stats_get_parse_time_percentile(stats, 100));
+}
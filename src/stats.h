@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_STATS_H
+#define ROFI_BLOCKS_STATS_H
+#include <gmodule.h>
+
+// parse times are counted in buckets of up to 2^i microseconds
+#define STATS_PARSE_TIME_BUCKETS 32
+
+// Counters of the payloads read and parsed, reported to the backend in STATS
+// events. The main loop and the reader thread update them without locks,
+// with relaxed atomic adds, and reports only need them roughly consistent.
+typedef struct {
+    gint64 started;              // monotonic time counting started
+    guint64 payloads_received;
+    guint64 payloads_coalesced;  // skipped as repeated, or superseded before their lines were built
+    guint64 bytes_read;          // of payloads, framing excluded
+    guint64 parse_times[STATS_PARSE_TIME_BUCKETS];
+} Stats;
+
+void stats_init(Stats* stats);
+
+static inline void stats_add(guint64* counter, guint64 value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline guint64 stats_get(const guint64* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void stats_add_parse_time(Stats* stats, gint64 microseconds);
+
+// Time under which percent of the parses took, in microseconds, rounded up
+// to a power of two; 0 before any parse
+guint64 stats_get_parse_time_percentile(Stats* stats, guint percent);
+
+// appends the counters as members of a JSON object, without braces
+void stats_append_json(Stats* stats, GString* out);
+
+#endif // ROFI_BLOCKS_STATS_H
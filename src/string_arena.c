@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "string_arena.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+// chunks are mapped directly instead of going through malloc, whose dynamic
+// mmap threshold would otherwise keep released chunks on the heap
+#define CHUNK_SIZE (256 * 1024)
+
+struct StringArenaChunk {
+    StringArenaChunk* prev;
+    StringArenaChunk* next;
+    gsize size;
+    gsize used;
+    guint live;
+};
+
+static const gsize CHUNK_HEADER_SIZE = sizeof(StringArenaChunk);
+
+static StringArenaChunk* string_arena_map_chunk(StringArena* arena, gsize size) {
+    gsize page_size = (gsize) sysconf(_SC_PAGESIZE);
+    size = (size + page_size - 1) / page_size * page_size;
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        g_error("string_arena: unable to map %" G_GSIZE_FORMAT " bytes", size);
+    }
+    StringArenaChunk* chunk = memory;
+    chunk->prev = NULL;
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    chunk->used = CHUNK_HEADER_SIZE;
+    chunk->live = 0;
+    if (arena->chunks != NULL) {
+        arena->chunks->prev = chunk;
+    }
+    arena->chunks = chunk;
+    arena->mapped += size;
+    return chunk;
+}
+
+static void string_arena_unmap_chunk(StringArena* arena, StringArenaChunk* chunk) {
+    if (chunk->prev != NULL) {
+        chunk->prev->next = chunk->next;
+    } else {
+        arena->chunks = chunk->next;
+    }
+    if (chunk->next != NULL) {
+        chunk->next->prev = chunk->prev;
+    }
+    if (arena->current == chunk) {
+        arena->current = NULL;
+    }
+    arena->mapped -= chunk->size;
+    munmap(chunk, chunk->size);
+}
+
+StringArena* string_arena_new(void) {
+    return g_malloc0(sizeof(StringArena));
+}
+
+void string_arena_destroy(StringArena* arena) {
+    while (arena->chunks != NULL) {
+        string_arena_unmap_chunk(arena, arena->chunks);
+    }
+    g_free(arena);
+}
+
+gchar* string_arena_alloc(StringArena* arena, gsize size, StringArenaChunk** chunk_result) {
+    StringArenaChunk* chunk = arena->current;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        if (CHUNK_HEADER_SIZE + size > CHUNK_SIZE) {
+            // too large to share a chunk, it gets one of its own
+            chunk = string_arena_map_chunk(arena, CHUNK_HEADER_SIZE + size);
+        } else {
+            chunk = string_arena_map_chunk(arena, CHUNK_SIZE);
+            arena->current = chunk;
+        }
+    }
+    gchar* result = (gchar*) chunk + chunk->used;
+    chunk->used += size;
+    chunk->live++;
+    *chunk_result = chunk;
+    return result;
+}
+
+void string_arena_release(StringArena* arena, StringArenaChunk* chunk) {
+    if (--chunk->live > 0) {
+        return;
+    }
+    if (chunk == arena->current) {
+        chunk->used = CHUNK_HEADER_SIZE;
+    } else {
+        string_arena_unmap_chunk(arena, chunk);
+    }
+}
+
+void string_arena_reset(StringArena* arena) {
+    StringArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        StringArenaChunk* next = chunk->next;
+        if (chunk == arena->current) {
+            chunk->used = CHUNK_HEADER_SIZE;
+            chunk->live = 0;
+        } else {
+            string_arena_unmap_chunk(arena, chunk);
+        }
+        chunk = next;
+    }
+}
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_STRING_ARENA_H
+#define ROFI_BLOCKS_STRING_ARENA_H
+#include <gmodule.h>
+
+typedef struct StringArenaChunk StringArenaChunk;
+
+// Bump allocator for line strings. Memory is mapped in chunks straight from
+// the OS, each chunk counting its live allocations: a chunk is unmapped as
+// soon as it is empty, and a reset unmaps everything but the current chunk.
+typedef struct {
+    StringArenaChunk* current; // chunk small allocations are bumped from
+    StringArenaChunk* chunks;  // every chunk, current one included
+    gsize mapped;              // bytes currently mapped
+} StringArena;
+
+StringArena* string_arena_new(void);
+
+void string_arena_destroy(StringArena* arena);
+
+// size bytes that stay valid until released, or until the arena is reset
+gchar* string_arena_alloc(StringArena* arena, gsize size, StringArenaChunk** chunk);
+
+void string_arena_release(StringArena* arena, StringArenaChunk* chunk);
+
+void string_arena_reset(StringArena* arena);
+
+#endif // ROFI_BLOCKS_STRING_ARENA_H
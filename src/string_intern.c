@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stddef.h>
+#include <string.h>
+#include "string_intern.h"
+
+typedef struct {
+    guint refcount;
+    gchar string[];
+} StringInternEntry;
+
+static StringInternEntry* string_intern_get_entry(const gchar* string) {
+    return (StringInternEntry*) (string - offsetof(StringInternEntry, string));
+}
+
+StringIntern* string_intern_new(void) {
+    StringIntern* intern = g_malloc0(sizeof(*intern));
+    // keys point into the entries, that are freed along with them
+    intern->strings = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    return intern;
+}
+
+void string_intern_destroy(StringIntern* intern) {
+    g_hash_table_destroy(intern->strings);
+    g_free(intern);
+}
+
+const gchar* string_intern_ref(StringIntern* intern, const gchar* string) {
+    if (string == NULL) {
+        return NULL;
+    }
+    intern->lookups++;
+    StringInternEntry* entry = g_hash_table_lookup(intern->strings, string);
+    if (entry != NULL) {
+        intern->hits++;
+        entry->refcount++;
+        return entry->string;
+    }
+    gsize length = strlen(string);
+    entry = g_malloc(sizeof(*entry) + length + 1);
+    entry->refcount = 1;
+    memcpy(entry->string, string, length + 1);
+    g_hash_table_insert(intern->strings, entry->string, entry);
+    intern->bytes += length + 1;
+    return entry->string;
+}
+
+void string_intern_unref(StringIntern* intern, const gchar* string) {
+    if (string == NULL) {
+        return;
+    }
+    StringInternEntry* entry = string_intern_get_entry(string);
+    if (--entry->refcount == 0) {
+        intern->bytes -= strlen(string) + 1;
+        g_hash_table_remove(intern->strings, string);
+    }
+}
+
+void string_intern_log_stats(StringIntern* intern) {
+    if (intern->lookups == 0) {
+        return;
+    }
+    g_debug("interned strings: %u distinct using %" G_GSIZE_FORMAT " bytes, %" G_GUINT64_FORMAT
+            " of %" G_GUINT64_FORMAT " lookups hit (%.1f%%)",
+            g_hash_table_size(intern->strings), intern->bytes, intern->hits, intern->lookups,
+            100.0 * intern->hits / intern->lookups);
+}
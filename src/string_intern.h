@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_STRING_INTERN_H
+#define ROFI_BLOCKS_STRING_INTERN_H
+#include <gmodule.h>
+
+// Reference counted table of strings that repeat across lines (icon names,
+// tags), so that equal values share a single copy. A string is freed once
+// its last reference is released.
+typedef struct {
+    GHashTable* strings; // of string -> StringInternEntry* holding it
+    guint64 lookups;
+    guint64 hits;
+    gsize bytes;         // held by distinct strings
+} StringIntern;
+
+StringIntern* string_intern_new(void);
+
+void string_intern_destroy(StringIntern* intern);
+
+// the shared copy of string, NULL for NULL; interned strings are equal
+// only when their pointers are
+const gchar* string_intern_ref(StringIntern* intern, const gchar* string);
+
+// releases a string returned by string_intern_ref, NULL is ignored
+void string_intern_unref(StringIntern* intern, const gchar* string);
+
+// logs how many lookups found an interned string
+void string_intern_log_stats(StringIntern* intern);
+
+#endif // ROFI_BLOCKS_STRING_INTERN_H
@@ -5,52 +5,105 @@
 #include <stdio.h>
 #include <string.h>
 #include "string_utils.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 //// private methods
 
-static void str_escape_for_json_string(const char* in, char* out) {
-    while (*in) {
-        switch (*in) {
-        case '\\':
-            *(out++) = '\\';
-            *(out++) = *in;
-            break;
-        case '"':
-            *(out++) = '\\';
-            *(out++) = '"';
-            break;
-        case '\t':
-            *(out++) = '\\';
-            *(out++) = 't';
-            break;
-        case '\r':
-            *(out++) = '\\';
-            *(out++) = 'r';
-            break;
-        case '\f':
-            *(out++) = '\\';
-            *(out++) = 'f';
-            break;
-        case '\b':
-            *(out++) = '\\';
-            *(out++) = 'b';
-            break;
-        case '\n':
-            *(out++) = '\\';
-            *(out++) = 'n';
-            break;
-        default:
-            *(out++) = *in;
-            break;
-        }
-        in++;
+// character written after the backslash for each byte that must be escaped
+// in a json string, 'u' for the \u00XX form, or 0 when copied as is
+static const char JSON_ESCAPES[256] = {
+    ['"'] = '"', ['\\'] = '\\',
+    ['\b'] = 'b', ['\f'] = 'f', ['\n'] = 'n', ['\r'] = 'r', ['\t'] = 't',
+    [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+    [0x0b] = 'u', [0x0e] = 'u', [0x0f] = 'u',
+    [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+    [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+};
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static size_t str_json_escape_extra_length(unsigned char c) {
+    char escape = JSON_ESCAPES[c];
+    return escape == 0 ? 0 : escape == 'u' ? 5 : 1;
+}
+
+static char* str_json_escape_char(unsigned char c, char* out) {
+    char escape = JSON_ESCAPES[c];
+    if (escape == 0) {
+        *(out++) = c;
+    } else if (escape == 'u') {
+        memcpy(out, "\\u00", 4);
+        out[4] = HEX_DIGITS[c >> 4];
+        out[5] = HEX_DIGITS[c & 0xf];
+        out += 6;
+    } else {
+        *(out++) = '\\';
+        *(out++) = escape;
     }
+    return out;
 }
 
+#ifdef __SSE2__
+#define JSON_ESCAPE_BLOCK_SIZE 16
+
+// bit i is set when the byte i of the block must be escaped
+static unsigned int str_json_escape_block_mask(const char* block) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*) block);
+    __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+    __m128i quote = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'));
+    __m128i backslash = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'));
+    return _mm_movemask_epi8(_mm_or_si128(control, _mm_or_si128(quote, backslash)));
+}
+#endif
+
 
 //// public methods
 
+size_t str_escaped_for_json_string_length(const char* in, size_t length) {
+    size_t result = length;
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + JSON_ESCAPE_BLOCK_SIZE <= length; i += JSON_ESCAPE_BLOCK_SIZE) {
+        unsigned int mask = str_json_escape_block_mask(in + i);
+        while (mask != 0) {
+            result += str_json_escape_extra_length(in[i + __builtin_ctz(mask)]);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < length; ++i) {
+        result += str_json_escape_extra_length(in[i]);
+    }
+    return result;
+}
+
+char* str_escape_for_json_string_into(const char* in, size_t length, char* out) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + JSON_ESCAPE_BLOCK_SIZE <= length; i += JSON_ESCAPE_BLOCK_SIZE) {
+        unsigned int mask = str_json_escape_block_mask(in + i);
+        size_t copied = 0;
+        // bytes between escapes are copied as runs
+        while (mask != 0) {
+            size_t position = __builtin_ctz(mask);
+            memcpy(out, in + i + copied, position - copied);
+            out = str_json_escape_char(in[i + position], out + position - copied);
+            copied = position + 1;
+            mask &= mask - 1;
+        }
+        memcpy(out, in + i + copied, JSON_ESCAPE_BLOCK_SIZE - copied);
+        out += JSON_ESCAPE_BLOCK_SIZE - copied;
+    }
+#endif
+    for (; i < length; ++i) {
+        out = str_json_escape_char(in[i], out);
+    }
+    return out;
+}
+
 // Result is an allocated a new string
 char* str_replace(const char* orig, const char* rep, const char* with) {
     char* result;    // the return string
@@ -115,8 +168,10 @@ char* str_replace_in_escaped(char** orig, const char* rep, const char* with) {
 }
 
 char* str_new_escaped_for_json_string(const char* str_to_escape) {
-    int len = strlen(str_to_escape);
-    char* result = (char*) calloc(len*2, sizeof(char));
-    str_escape_for_json_string(str_to_escape, result);
+    size_t length = strlen(str_to_escape);
+    char* result = malloc(str_escaped_for_json_string_length(str_to_escape, length) + 1);
+    if (!result)
+        return NULL;
+    *str_escape_for_json_string_into(str_to_escape, length, result) = '\0';
     return result;
 }
@@ -3,6 +3,7 @@
 
 #ifndef ROFI_BLOCKS_STRING_UTILS_H
 #define ROFI_BLOCKS_STRING_UTILS_H
+#include <stddef.h>
 
 // Result is an allocated a new string
 char* str_replace(const char* orig, const char* rep, const char* with);
@@ -13,4 +14,11 @@ char* str_replace_in_escaped(char** orig, const char* rep, const char* with);
 
 char* str_new_escaped_for_json_string(const char* str_to_escape);
 
+// Length of the first length bytes of in once escaped, without a NUL
+size_t str_escaped_for_json_string_length(const char* in, size_t length);
+
+// out must hold str_escaped_for_json_string_length bytes. Returns the end of
+// the escaped string, which is not NUL terminated
+char* str_escape_for_json_string_into(const char* in, size_t length, char* out);
+
 #endif // ROFI_BLOCKS_STRING_UTILS_H
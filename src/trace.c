@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+G_DEFINE_QUARK(trace-error-quark, trace_error)
+
+Trace* trace_new(const gchar* path, GError** error) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        g_set_error(error, TRACE_ERROR, 0, "unable to open %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+    Trace* trace = g_malloc0(sizeof(*trace));
+    trace->file = file;
+    g_mutex_init(&trace->lock);
+    trace->threads = g_hash_table_new(g_direct_hash, g_direct_equal);
+    trace->origin = g_get_monotonic_time();
+    // the JSON array format, where the closing bracket is optional
+    fprintf(file, "[{\"name\":\"process_name\", \"ph\":\"M\", \"pid\":%d, \"args\":{\"name\":\"rofi-blocks\"}}",
+            (int) getpid());
+    return trace;
+}
+
+void trace_destroy(Trace* trace) {
+    if (trace == NULL) {
+        return;
+    }
+    fputs("\n]\n", trace->file);
+    fclose(trace->file);
+    g_hash_table_destroy(trace->threads);
+    g_mutex_clear(&trace->lock);
+    g_free(trace);
+}
+
+// numbered in the order they first end a span, the first being the main loop
+static guint trace_thread_id(Trace* trace) {
+    GThread* thread = g_thread_self();
+    guint id = GPOINTER_TO_UINT(g_hash_table_lookup(trace->threads, thread));
+    if (id == 0) {
+        id = g_hash_table_size(trace->threads) + 1;
+        g_hash_table_insert(trace->threads, thread, GUINT_TO_POINTER(id));
+    }
+    return id;
+}
+
+void trace_end(Trace* trace, const gchar* name, gint64 start, const gchar* args_format, ...) {
+    if (trace == NULL) {
+        return;
+    }
+    gint64 end = g_get_monotonic_time();
+    g_mutex_lock(&trace->lock);
+    fprintf(trace->file, ",\n{\"name\":\"%s\", \"cat\":\"blocks\", \"ph\":\"X\", \"ts\":%" G_GINT64_FORMAT
+            ", \"dur\":%" G_GINT64_FORMAT ", \"pid\":%d, \"tid\":%u",
+            name, start - trace->origin, end - start, (int) getpid(), trace_thread_id(trace));
+    if (args_format != NULL) {
+        va_list args;
+        va_start(args, args_format);
+        fputs(", \"args\":{", trace->file);
+        vfprintf(trace->file, args_format, args);
+        fputc('}', trace->file);
+        va_end(args);
+    }
+    fputc('}', trace->file);
+    g_mutex_unlock(&trace->lock);
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_TRACE_H
+#define ROFI_BLOCKS_TRACE_H
+#include <stdio.h>
+#include <gmodule.h>
+
+#define TRACE_ERROR trace_error_quark()
+
+// Spans of time spent in each stage, written to a file as Chrome trace
+// events, which chrome://tracing and Perfetto open. Spans are written as
+// they end, in a format that stays valid when rofi does not exit cleanly.
+// Where tracing is off the trace is NULL, and every call does nothing.
+typedef struct {
+    FILE* file;
+    GMutex lock;         // spans also end on the reader and match threads
+    GHashTable* threads; // small ids of the threads seen, by GThread*
+    gint64 origin;       // monotonic time timestamps are relative to
+} Trace;
+
+GQuark trace_error_quark(void);
+
+Trace* trace_new(const gchar* path, GError** error);
+
+// finishes and closes the file
+void trace_destroy(Trace* trace);
+
+// start time of a span, to end with trace_end; 0 when trace is NULL
+static inline gint64 trace_begin(Trace* trace) {
+    return trace != NULL ? g_get_monotonic_time() : 0;
+}
+
+// Writes the span name, from start until now. args_format, when not NULL,
+// formats the members of the span arguments object, as in "\"bytes\":%zu".
+void trace_end(Trace* trace, const gchar* name, gint64 start, const gchar* args_format, ...) G_GNUC_PRINTF(4, 5);
+
+#endif // ROFI_BLOCKS_TRACE_H
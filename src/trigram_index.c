@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <string.h>
+#include "trigram_index.h"
+
+#define TRIGRAM_SIZE 3
+
+// rough cost of a posting list besides its deltas: the list, its byte array
+// and a hash table entry
+static const gsize POSTINGS_OVERHEAD = sizeof(TrigramPostings) + sizeof(GByteArray) + 4 * sizeof(gpointer);
+
+static void trigram_postings_free(gpointer pointer) {
+    TrigramPostings* postings = pointer;
+    g_byte_array_free(postings->deltas, TRUE);
+    g_free(postings);
+}
+
+static void trigram_postings_append(TrigramPostings* postings, guint line) {
+    guint delta = line - postings->last;
+    while (delta >= 0x80) {
+        guint8 byte = (delta & 0x7f) | 0x80;
+        g_byte_array_append(postings->deltas, &byte, 1);
+        delta >>= 7;
+    }
+    guint8 byte = delta;
+    g_byte_array_append(postings->deltas, &byte, 1);
+    postings->last = line;
+    postings->count++;
+}
+
+typedef struct {
+    const guint8* cursor;
+    const guint8* end;
+    guint line;
+} TrigramPostingsReader;
+
+static gboolean trigram_postings_reader_next(TrigramPostingsReader* reader) {
+    guint delta = 0;
+    for (guint shift = 0; reader->cursor < reader->end; shift += 7) {
+        guint8 byte = *(reader->cursor++);
+        delta |= (guint) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            reader->line += delta;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Case folds text into index->folded: ASCII is lowered in place, anything
+// else goes through g_utf8_casefold
+static void trigram_index_fold(TrigramIndex* index, const gchar* text) {
+    GString* folded = index->folded;
+    g_string_truncate(folded, 0);
+    for (const gchar* c = text; *c != '\0'; ++c) {
+        if ((guchar) *c >= 0x80) {
+            gchar* unicode_folded = g_utf8_casefold(text, -1);
+            g_string_assign(folded, unicode_folded);
+            g_free(unicode_folded);
+            return;
+        }
+        g_string_append_c(folded, g_ascii_tolower(*c));
+    }
+}
+
+static guint trigram_key(const gchar* text) {
+    const guchar* bytes = (const guchar*) text;
+    return ((guint) bytes[0] << 16) | ((guint) bytes[1] << 8) | bytes[2];
+}
+
+TrigramIndex* trigram_index_new(void) {
+    TrigramIndex* index = g_malloc0(sizeof(*index));
+    index->postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, trigram_postings_free);
+    index->always = g_array_new(FALSE, FALSE, sizeof(guint));
+    index->folded = g_string_sized_new(256);
+    return index;
+}
+
+void trigram_index_destroy(TrigramIndex* index) {
+    g_hash_table_destroy(index->postings);
+    g_array_free(index->always, TRUE);
+    g_string_free(index->folded, TRUE);
+    g_free(index);
+}
+
+void trigram_index_clear(TrigramIndex* index) {
+    g_hash_table_remove_all(index->postings);
+    g_array_set_size(index->always, 0);
+    index->lines = 0;
+    index->dropped = 0;
+    index->memory = 0;
+}
+
+void trigram_index_add(TrigramIndex* index, const gchar* text, gboolean always) {
+    guint line = index->lines++;
+    if (always) {
+        g_array_append_val(index->always, line);
+        index->memory += sizeof(guint);
+        return;
+    }
+    trigram_index_fold(index, text);
+    GString* folded = index->folded;
+    for (gsize i = 0; i + TRIGRAM_SIZE <= folded->len; ++i) {
+        gpointer key = GUINT_TO_POINTER(trigram_key(folded->str + i));
+        TrigramPostings* postings = g_hash_table_lookup(index->postings, key);
+        if (postings == NULL) {
+            postings = g_malloc0(sizeof(*postings));
+            postings->deltas = g_byte_array_new();
+            g_hash_table_insert(index->postings, key, postings);
+            index->memory += POSTINGS_OVERHEAD;
+        } else if (postings->last == line) {
+            continue; // repeated in the same line
+        }
+        guint before = postings->deltas->len;
+        trigram_postings_append(postings, line);
+        index->memory += postings->deltas->len - before;
+    }
+}
+
+void trigram_index_drop(TrigramIndex* index, guint count) {
+    index->dropped += MIN(count, trigram_index_get_number_of_lines(index));
+}
+
+// keeps the candidates that are also in postings
+static void trigram_index_intersect(GArray* candidates, TrigramPostings* postings) {
+    TrigramPostingsReader reader = {
+        .cursor = postings->deltas->data,
+        .end = postings->deltas->data + postings->deltas->len,
+        .line = 0
+    };
+    gboolean has_line = trigram_postings_reader_next(&reader);
+    guint kept = 0;
+    for (guint i = 0; i < candidates->len && has_line; ++i) {
+        guint candidate = g_array_index(candidates, guint, i);
+        while (has_line && reader.line < candidate) {
+            has_line = trigram_postings_reader_next(&reader);
+        }
+        if (has_line && reader.line == candidate) {
+            g_array_index(candidates, guint, kept++) = candidate;
+        }
+    }
+    g_array_set_size(candidates, kept);
+}
+
+static gint trigram_postings_compare_count(gconstpointer a, gconstpointer b) {
+    const TrigramPostings* postings_a = *(TrigramPostings* const*) a;
+    const TrigramPostings* postings_b = *(TrigramPostings* const*) b;
+    return (postings_a->count > postings_b->count) - (postings_a->count < postings_b->count);
+}
+
+// merges the sorted always lines into the sorted candidates
+static GArray* trigram_index_add_always(TrigramIndex* index, GArray* candidates) {
+    if (index->always->len == 0) {
+        return candidates;
+    }
+    GArray* merged = g_array_sized_new(FALSE, FALSE, sizeof(guint), candidates->len + index->always->len);
+    guint i = 0;
+    guint j = 0;
+    while (i < candidates->len || j < index->always->len) {
+        gboolean take_candidate = j >= index->always->len
+            || (i < candidates->len && g_array_index(candidates, guint, i) < g_array_index(index->always, guint, j));
+        guint line = take_candidate ? g_array_index(candidates, guint, i++) : g_array_index(index->always, guint, j++);
+        g_array_append_val(merged, line);
+    }
+    g_array_free(candidates, TRUE);
+    return merged;
+}
+
+// leaves the dropped lines out of the sorted lines, numbered from the first
+// line kept
+static void trigram_index_renumber(TrigramIndex* index, GArray* lines) {
+    if (index->dropped == 0) {
+        return;
+    }
+    guint kept = 0;
+    for (guint i = 0; i < lines->len; ++i) {
+        guint line = g_array_index(lines, guint, i);
+        if (line >= index->dropped) {
+            g_array_index(lines, guint, kept++) = line - index->dropped;
+        }
+    }
+    g_array_set_size(lines, kept);
+}
+
+GArray* trigram_index_query(TrigramIndex* index, const gchar* const* needles) {
+    GPtrArray* lists = g_ptr_array_new();
+    gboolean missing = FALSE;
+    for (const gchar* const* needle = needles; !missing && *needle != NULL; ++needle) {
+        trigram_index_fold(index, *needle);
+        GString* folded = index->folded;
+        for (gsize i = 0; i + TRIGRAM_SIZE <= folded->len; ++i) {
+            TrigramPostings* postings = g_hash_table_lookup(index->postings, GUINT_TO_POINTER(trigram_key(folded->str + i)));
+            if (postings == NULL) {
+                missing = TRUE;
+                break;
+            }
+            g_ptr_array_add(lists, postings);
+        }
+    }
+    if (!missing && lists->len == 0) {
+        g_ptr_array_free(lists, TRUE);
+        return NULL;
+    }
+
+    GArray* candidates = g_array_new(FALSE, FALSE, sizeof(guint));
+    if (!missing) {
+        // starts from the shortest list, so that the candidates only shrink
+        g_ptr_array_sort(lists, trigram_postings_compare_count);
+        TrigramPostings* shortest = g_ptr_array_index(lists, 0);
+        TrigramPostingsReader reader = {
+            .cursor = shortest->deltas->data,
+            .end = shortest->deltas->data + shortest->deltas->len,
+            .line = 0
+        };
+        while (trigram_postings_reader_next(&reader)) {
+            g_array_append_val(candidates, reader.line);
+        }
+        for (guint i = 1; i < lists->len && candidates->len > 0; ++i) {
+            trigram_index_intersect(candidates, g_ptr_array_index(lists, i));
+        }
+    }
+    g_ptr_array_free(lists, TRUE);
+    candidates = trigram_index_add_always(index, candidates);
+    trigram_index_renumber(index, candidates);
+    return candidates;
+}
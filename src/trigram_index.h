@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_TRIGRAM_INDEX_H
+#define ROFI_BLOCKS_TRIGRAM_INDEX_H
+#include <gmodule.h>
+
+// Lines containing each trigram of case folded text, as line numbers
+// delta encoded in variable length integers
+typedef struct {
+    GByteArray* deltas;
+    guint last;   // last line added
+    guint count;
+} TrigramPostings;
+
+// Inverted index from trigrams to the lines containing them, to find the
+// lines that may contain a substring without scanning every line. Lines are
+// appended, and the oldest ones dropped; anything else needs the index to be
+// cleared.
+typedef struct {
+    GHashTable* postings; // of trigram -> TrigramPostings*
+    GArray* always;       // lines that every query returns
+    guint lines;          // lines indexed so far
+    guint dropped;        // oldest lines left out of queries, which number
+                          // lines from the first one kept
+    gsize memory;         // approximate bytes used
+    GString* folded;      // scratch buffer
+} TrigramIndex;
+
+TrigramIndex* trigram_index_new(void);
+
+void trigram_index_destroy(TrigramIndex* index);
+
+void trigram_index_clear(TrigramIndex* index);
+
+// Indexes text as the next line, always lines are returned by every query
+void trigram_index_add(TrigramIndex* index, const gchar* text, gboolean always);
+
+// Drops the count oldest lines that were not dropped yet. Their postings are
+// kept until the index is cleared, so that dropping takes no time.
+void trigram_index_drop(TrigramIndex* index, guint count);
+
+// lines indexed and not dropped
+static inline guint trigram_index_get_number_of_lines(TrigramIndex* index) {
+    return index->lines - index->dropped;
+}
+
+// Sorted lines that may contain every needle, case insensitively. NULL when
+// no needle is long enough to tell, i.e. when any line may.
+GArray* trigram_index_query(TrigramIndex* index, const gchar* const* needles);
+
+#endif // ROFI_BLOCKS_TRIGRAM_INDEX_H
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "unix_socket.h"
+
+// connections waiting to be accepted
+static const int UNIX_SOCKET_BACKLOG = 16;
+
+G_DEFINE_QUARK(unix-socket-error-quark, unix_socket_error)
+
+// opens a socket for path, -1 when path does not fit in an address
+static int unix_socket_open(const gchar* path, struct sockaddr_un* address, GError** error) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        g_set_error(error, UNIX_SOCKET_ERROR, 0, "socket path %s is too long", path);
+        return -1;
+    }
+    strcpy(address->sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_set_error(error, UNIX_SOCKET_ERROR, 0, "unable to create socket: %s", g_strerror(errno));
+    }
+    return fd;
+}
+
+int unix_socket_connect(const gchar* path, GError** error) {
+    struct sockaddr_un address;
+    int fd = unix_socket_open(path, &address, error);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        g_set_error(error, UNIX_SOCKET_ERROR, 0, "unable to connect to %s: %s", path, g_strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int unix_socket_listen(const gchar* path, GError** error) {
+    struct sockaddr_un address;
+    int fd = unix_socket_open(path, &address, error);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, UNIX_SOCKET_BACKLOG) != 0) {
+        g_set_error(error, UNIX_SOCKET_ERROR, 0, "unable to listen at %s: %s", path, g_strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+#ifndef ROFI_BLOCKS_UNIX_SOCKET_H
+#define ROFI_BLOCKS_UNIX_SOCKET_H
+#include <gmodule.h>
+
+#define UNIX_SOCKET_ERROR unix_socket_error_quark()
+
+GQuark unix_socket_error_quark(void);
+
+// Connects to the stream socket listening at path, returns the connected
+// descriptor or -1 on error
+int unix_socket_connect(const gchar* path, GError** error);
+
+// Listens at path, replacing any socket left there; used by backends, such
+// as the test daemon
+int unix_socket_listen(const gchar* path, GError** error);
+
+#endif // ROFI_BLOCKS_UNIX_SOCKET_H
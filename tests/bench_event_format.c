@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <gmodule.h>
+#include "../src/event_format.h"
+#include "../src/string_utils.h"
+
+// Compares rendering events with a compiled EventFormat against the previous
+// chain of str_replace calls, with the default event format.
+
+#define EVENTS 1000000
+
+static const char* FORMAT = "{\"event\":\"{{event}}\", \"value\":\"{{value_escaped}}\", \"data\":\"{{data_escaped}}\"}";
+static const char* VALUE = "some entry text with \"quotes\" in it";
+static const char* DATA = "entry-data:42";
+
+static gsize render_with_str_replace(void) {
+    gsize total = 0;
+    for (int i = 0; i < EVENTS; ++i) {
+        char* result = str_replace(FORMAT, "{{event}}", "SELECT_ENTRY");
+        result = str_replace_in(&result, "{{value}}", VALUE);
+        result = str_replace_in(&result, "{{data}}", DATA);
+        result = str_replace_in_escaped(&result, "{{value_escaped}}", VALUE);
+        result = str_replace_in_escaped(&result, "{{data_escaped}}", DATA);
+        total += strlen(result);
+        free(result);
+    }
+    return total;
+}
+
+static gsize render_with_event_format(void) {
+    gsize total = 0;
+    EventFormat* event_format = event_format_new(FORMAT);
+    for (int i = 0; i < EVENTS; ++i) {
+        total += event_format_render(event_format, "SELECT_ENTRY", VALUE, DATA)->len;
+    }
+    event_format_destroy(event_format);
+    return total;
+}
+
+static void run(const char* name, gsize (*render)(void)) {
+    gint64 start = g_get_monotonic_time();
+    gsize total = render();
+    gint64 elapsed = g_get_monotonic_time() - start;
+    printf("%-14s %10zu bytes %10.2f ms %8.1f ns/event\n", name, total, elapsed / 1000.0,
+           elapsed * 1000.0 / EVENTS);
+}
+
+int main(void) {
+    printf("events: %d\n", EVENTS);
+    run("str_replace", render_with_str_replace);
+    run("event_format", render_with_event_format);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <gmodule.h>
+#include "../src/line_reader.h"
+
+// Compares the block based LineReader against the previous reader, which
+// pulled one code point at a time from a GIOChannel.
+
+#define LINES_PER_PAYLOAD 20000
+#define PAYLOADS 10
+
+static int write_payloads_to_tmp_file(void) {
+    char path[] = "/tmp/bench_line_reader_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    GString* payload = g_string_sized_new(1024 * 1024);
+    for (int p = 0; p < PAYLOADS; ++p) {
+        g_string_assign(payload, "{\"prompt\":\"bench\", \"lines\":[");
+        for (int i = 0; i < LINES_PER_PAYLOAD; ++i) {
+            g_string_append_printf(payload, "%s{\"text\":\"line %d of payload %d – ünïcödé\", \"icon\":\"folder\", \"data\":\"%d\"}",
+                                   i == 0 ? "" : ",", i, p, i);
+        }
+        g_string_append(payload, "]}\n");
+        if (write(fd, payload->str, payload->len) != (ssize_t) payload->len) {
+            perror("write");
+            exit(1);
+        }
+    }
+    g_string_free(payload, TRUE);
+    return fd;
+}
+
+static gsize read_with_unichar_channel(int fd) {
+    GIOChannel* channel = g_io_channel_unix_new(fd);
+    GString* buffer = g_string_sized_new(1024);
+    GString* active_line = g_string_sized_new(1024);
+    gsize lines = 0;
+    gunichar unichar;
+    while (g_io_channel_read_unichar(channel, &unichar, NULL) == G_IO_STATUS_NORMAL) {
+        g_string_append_unichar(buffer, unichar);
+        if (unichar == '\n') {
+            if (buffer->len > 1) {
+                g_string_assign(active_line, buffer->str);
+                lines++;
+            }
+            g_string_set_size(buffer, 0);
+        }
+    }
+    g_io_channel_unref(channel);
+    g_string_free(buffer, TRUE);
+    g_string_free(active_line, TRUE);
+    return lines;
+}
+
+static gsize read_with_line_reader(int fd) {
+    LineReader* reader = line_reader_new(fd);
+    gsize lines = 0;
+    gchar* line;
+    gsize length;
+    LineReaderStatus status;
+    do {
+        status = line_reader_fill(reader);
+        while (line_reader_next_line(reader, &line, &length)) {
+            lines++;
+        }
+    } while (status == LineReaderStatus_AGAIN);
+    line_reader_destroy(reader);
+    return lines;
+}
+
+static void run(const char* name, gsize (*reader)(int), int fd, off_t size) {
+    lseek(fd, 0, SEEK_SET);
+    gint64 start = g_get_monotonic_time();
+    gsize lines = reader(fd);
+    gint64 elapsed = g_get_monotonic_time() - start;
+    printf("%-20s %4zu lines %10.2f ms %10.2f MiB/s\n", name, lines, elapsed / 1000.0,
+           (size / (1024.0 * 1024.0)) / (elapsed / (double) G_USEC_PER_SEC));
+}
+
+int main(void) {
+    int fd = write_payloads_to_tmp_file();
+    off_t size = lseek(fd, 0, SEEK_END);
+    printf("input: %d payloads, %.2f MiB\n", PAYLOADS, size / (1024.0 * 1024.0));
+    run("g_io_channel_unichar", read_with_unichar_channel, fd, size);
+    run("line_reader", read_with_line_reader, fd, size);
+    close(fd);
+    return 0;
+}
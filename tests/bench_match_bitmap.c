@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmodule.h>
+#include "../src/match_bitmap.h"
+
+// How computing the match bitmap of a large list scales with the number of
+// threads. Lines are matched case insensitively against a few words, which
+// stands in for rofi's token matcher.
+
+static const int ROUNDS = 5;
+
+typedef struct {
+    gchar** lines;
+    const gchar* const* words;
+} BenchContext;
+
+static gboolean match_words(gpointer context, guint index) {
+    BenchContext* bench = context;
+    gchar* folded = g_utf8_casefold(bench->lines[index], -1);
+    gboolean result = TRUE;
+    for (const gchar* const* word = bench->words; result && *word != NULL; ++word) {
+        result = strstr(folded, *word) != NULL;
+    }
+    g_free(folded);
+    return result;
+}
+
+static void run(guint threads, BenchContext* context, guint length) {
+    MatchBitmap* bitmap = match_bitmap_new(threads);
+    gint64 best = G_MAXINT64;
+    guint matches = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        gint64 start = g_get_monotonic_time();
+        matches = 0;
+        for (guint i = 0; i < length; ++i) {
+            matches += match_bitmap_test(bitmap, round, 0, length, match_words, NULL, context, i);
+        }
+        best = MIN(best, g_get_monotonic_time() - start);
+    }
+    printf("%3u threads %10.2f ms %8u matches\n", threads, best / 1000.0, matches);
+    match_bitmap_destroy(bitmap);
+}
+
+int main(int argc, char** argv) {
+    guint length = argc > 1 ? atoi(argv[1]) : 500000;
+    guint max_threads = argc > 2 ? atoi(argv[2]) : g_get_num_processors();
+    static const gchar* const words[] = { "entry", "7", NULL };
+    BenchContext context = { .lines = g_new(gchar*, length), .words = words };
+    for (guint i = 0; i < length; ++i) {
+        context.lines[i] = g_strdup_printf("Entry number %u of the list, with some more text to match", i);
+    }
+    printf("%u lines, %u processors\n", length, g_get_num_processors());
+    for (guint threads = 1; threads < max_threads; threads *= 2) {
+        run(threads, &context, length);
+    }
+    run(max_threads, &context, length);
+    for (guint i = 0; i < length; ++i) {
+        g_free(context.lines[i]);
+    }
+    g_free(context.lines);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <gmodule.h>
+#include <json-glib/json-glib.h>
+#include "../src/payload.h"
+
+// Compares the streaming payload parser against the previous json-glib based
+// one on the existing payload format. Every parser runs in its own process so
+// that its peak RSS can be measured.
+
+static const gchar* EMPTY_STRING = "";
+
+static GString* generate_payload(int lines) {
+    GString* payload = g_string_sized_new(lines * 120);
+    g_string_append(payload, "{\"prompt\":\"bench\", \"message\":\"a message\", \"lines\":[");
+    for (int i = 0; i < lines; ++i) {
+        g_string_append_printf(payload,
+            "%s{\"text\":\"entry number %d with some \\\"escaped\\\" text\", \"icon\":\"folder\", \"urgent\":%s, \"data\":\"id:%d\"}",
+            i == 0 ? "" : ",", i, i % 10 == 0 ? "true" : "false", i);
+    }
+    g_string_append(payload, "]}");
+    return payload;
+}
+
+// previous implementation, building the lines out of a JsonNode tree
+static const gchar* json_member_string_or_else(JsonObject* object, const gchar* member, const gchar* else_value) {
+    JsonNode* node = json_object_get_member(object, member);
+    return node != NULL && json_node_get_value_type(node) == G_TYPE_STRING ? json_node_get_string(node) : else_value;
+}
+
+static gboolean json_member_boolean_or_else(JsonObject* object, const gchar* member, gboolean else_value) {
+    JsonNode* node = json_object_get_member(object, member);
+    return node != NULL && json_node_get_value_type(node) == G_TYPE_BOOLEAN ? json_node_get_boolean(node) : else_value;
+}
+
+static void parse_with_json_glib(gchar* json, gsize length, PageData* page) {
+    JsonParser* parser = json_parser_new();
+    if (!json_parser_load_from_data(parser, json, length, NULL)) {
+        exit(1);
+    }
+    JsonObject* root = json_node_get_object(json_parser_get_root(parser));
+    JsonArray* lines = json_object_get_array_member(root, "lines");
+    guint len = json_array_get_length(lines);
+    for (guint i = 0; i < len; ++i) {
+        JsonNode* node = json_array_get_element(lines, i);
+        if (JSON_NODE_HOLDS_OBJECT(node)) {
+            JsonObject* line = json_node_get_object(node);
+            page_data_add_line(page,
+                json_member_string_or_else(line, "text", EMPTY_STRING),
+                json_member_string_or_else(line, "meta", NULL),
+                json_member_string_or_else(line, "icon", EMPTY_STRING),
+                json_member_string_or_else(line, "data", EMPTY_STRING),
+                json_member_boolean_or_else(line, "urgent", FALSE),
+                json_member_boolean_or_else(line, "highlight", FALSE),
+                json_member_boolean_or_else(line, "markup", FALSE),
+                json_member_boolean_or_else(line, "nonselectable", FALSE),
+                json_member_boolean_or_else(line, "filter", TRUE));
+        }
+    }
+    g_object_unref(parser);
+}
+
+static void parse_streaming(gchar* json, gsize length, PageData* page) {
+    Payload payload;
+    if (!payload_parse_json(&payload, json, length, NULL)) {
+        exit(1);
+    }
+    payload_build_lines(&payload.lines, page, 0);
+}
+
+static glong current_rss_kib(void) {
+    glong pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*d %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void run(const char* name, void (*parse)(gchar*, gsize, PageData*), GString* payload) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        gchar* json = g_strndup(payload->str, payload->len);
+        glong rss_before = current_rss_kib();
+        PageData* page = page_data_new();
+        gint64 start = g_get_monotonic_time();
+        parse(json, payload->len, page);
+        gint64 elapsed = g_get_monotonic_time() - start;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        printf("%-10s %8zu lines %10.2f ms   peak RSS +%8ld KiB\n", name,
+               page_data_get_number_of_lines(page), elapsed / 1000.0, usage.ru_maxrss - rss_before);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : 200000;
+    GString* payload = generate_payload(lines);
+    printf("payload: %d lines, %.2f MiB\n", lines, payload->len / (1024.0 * 1024.0));
+    run("json-glib", parse_with_json_glib, payload);
+    run("streaming", parse_streaming, payload);
+    g_string_free(payload, TRUE);
+    return 0;
+}
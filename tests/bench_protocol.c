@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmodule.h>
+#include "../src/payload.h"
+
+// Compares the cost of handling the same lines payload sent with the json
+// and the msgpack protocols: parsing plus building every line, and the size
+// of the payload on the wire.
+
+static const int ROUNDS = 5;
+
+static void msgpack_append_uint(GString* out, guint64 value, guint bytes) {
+    for (guint i = bytes; i > 0; --i) {
+        g_string_append_c(out, (gchar) ((value >> ((i - 1) * 8)) & 0xff));
+    }
+}
+
+static void msgpack_append_header(GString* out, guchar fix, guint fix_max, guchar base, gsize length) {
+    if (length <= fix_max) {
+        g_string_append_c(out, (gchar) (fix | length));
+    } else if (length <= G_MAXUINT16) {
+        g_string_append_c(out, (gchar) base);
+        msgpack_append_uint(out, length, 2);
+    } else {
+        g_string_append_c(out, (gchar) (base + 1));
+        msgpack_append_uint(out, length, 4);
+    }
+}
+
+static void msgpack_append_str(GString* out, const gchar* str) {
+    gsize length = strlen(str);
+    if (length < 32) {
+        g_string_append_c(out, (gchar) (0xa0 | length));
+    } else {
+        msgpack_append_header(out, 0xa0, 0, 0xda, length);
+    }
+    g_string_append_len(out, str, length);
+}
+
+static void generate_payloads(int lines, GString* json, GString* msgpack) {
+    g_string_append(json, "{\"prompt\":\"bench\", \"message\":\"a message\", \"lines\":[");
+    g_string_append_c(msgpack, (gchar) 0x83);
+    msgpack_append_str(msgpack, "prompt");
+    msgpack_append_str(msgpack, "bench");
+    msgpack_append_str(msgpack, "message");
+    msgpack_append_str(msgpack, "a message");
+    msgpack_append_str(msgpack, "lines");
+    msgpack_append_header(msgpack, 0x90, 15, 0xdc, lines);
+
+    GString* text = g_string_new(NULL);
+    GString* data = g_string_new(NULL);
+    for (int i = 0; i < lines; ++i) {
+        gboolean urgent = i % 10 == 0;
+        g_string_printf(text, "entry number %d with some \"escaped\" text", i);
+        g_string_printf(data, "id:%d", i);
+        g_string_append_printf(json,
+            "%s{\"text\":\"entry number %d with some \\\"escaped\\\" text\", \"icon\":\"folder\", \"urgent\":%s, \"data\":\"%s\"}",
+            i == 0 ? "" : ",", i, urgent ? "true" : "false", data->str);
+
+        g_string_append_c(msgpack, (gchar) 0x84);
+        msgpack_append_str(msgpack, "text");
+        msgpack_append_str(msgpack, text->str);
+        msgpack_append_str(msgpack, "icon");
+        msgpack_append_str(msgpack, "folder");
+        msgpack_append_str(msgpack, "urgent");
+        g_string_append_c(msgpack, (gchar) (urgent ? 0xc3 : 0xc2));
+        msgpack_append_str(msgpack, "data");
+        msgpack_append_str(msgpack, data->str);
+    }
+    g_string_append(json, "]}");
+    g_string_free(text, TRUE);
+    g_string_free(data, TRUE);
+}
+
+static void run(const char* name, PayloadFormat format, GString* payload) {
+    gchar* copy = g_malloc(payload->len + 1);
+    gint64 best = G_MAXINT64;
+    gsize lines = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        // parsing modifies the payload in place
+        memcpy(copy, payload->str, payload->len + 1);
+        PageData* page = page_data_new();
+        Payload parsed;
+        gint64 start = g_get_monotonic_time();
+        gboolean valid = format == PayloadFormat_MSGPACK
+            ? payload_parse_msgpack(&parsed, copy, payload->len, NULL)
+            : payload_parse_json(&parsed, copy, payload->len, NULL);
+        if (!valid) {
+            fprintf(stderr, "%s payload is invalid\n", name);
+            exit(1);
+        }
+        payload_build_lines(&parsed.lines, page, 0);
+        best = MIN(best, g_get_monotonic_time() - start);
+        lines = page_data_get_number_of_lines(page);
+        page_data_destroy(page);
+    }
+    printf("%-8s %8zu lines %8.2f MiB %10.2f ms %10.1f MiB/s\n", name, lines,
+           payload->len / (1024.0 * 1024.0), best / 1000.0,
+           (payload->len / (1024.0 * 1024.0)) / (best / (double) G_USEC_PER_SEC));
+    g_free(copy);
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : 200000;
+    GString* json = g_string_new(NULL);
+    GString* msgpack = g_string_new(NULL);
+    generate_payloads(lines, json, msgpack);
+    printf("best of %d rounds, parse and build\n", ROUNDS);
+    run("json", PayloadFormat_JSON, json);
+    run("msgpack", PayloadFormat_MSGPACK, msgpack);
+    g_string_free(json, TRUE);
+    g_string_free(msgpack, TRUE);
+    return 0;
+}
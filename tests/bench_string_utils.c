@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdlib.h>
+#include <gmodule.h>
+#include "bench_util.h"
+#include "../src/string_utils.h"
+
+// Escapes a MiB of text for JSON strings, with escapes more or less often,
+// and prints the results as JSON lines like bench_suite. Run by make bench.
+
+#define INPUT_LENGTH (1024 * 1024)
+#define ITERATIONS 200
+
+typedef struct {
+    gsize escape_every; // 0 for plain text
+    gchar escape;
+} BenchEscape;
+
+static guint64 bench_escape(BenchTimer* timer, gpointer context) {
+    BenchEscape* bench = context;
+    gchar* in = g_malloc(INPUT_LENGTH);
+    gchar* out = g_malloc(INPUT_LENGTH * 6);
+    for (gsize i = 0; i < INPUT_LENGTH; ++i) {
+        in[i] = bench->escape_every > 0 && i % bench->escape_every == 0 ? bench->escape : 'a' + i % 26;
+    }
+    gsize escaped = 0;
+    bench_timer_start(timer);
+    for (int i = 0; i < ITERATIONS; ++i) {
+        escaped += str_escape_for_json_string_into(in, INPUT_LENGTH, out) - out;
+    }
+    bench_timer_stop(timer);
+    g_debug("%zu bytes escaped", escaped);
+    g_free(in);
+    g_free(out);
+    return (guint64) INPUT_LENGTH * ITERATIONS;
+}
+
+int main(void) {
+    BenchEscape plain = { 0, 'a' };
+    BenchEscape every_64_bytes = { 64, '"' };
+    BenchEscape every_4_bytes = { 4, '\n' };
+    gboolean ok = bench_run("escape_plain", "byte", bench_escape, &plain, NULL);
+    ok = bench_run("escape_every_64_bytes", "byte", bench_escape, &every_64_bytes, NULL) && ok;
+    ok = bench_run("escape_every_4_bytes", "byte", bench_escape, &every_4_bytes, NULL) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gmodule.h>
+#include "bench_util.h"
+#include "bench_workload.h"
+#include "../src/event_format.h"
+#include "../src/line_reader.h"
+#include "../src/match_bitmap.h"
+#include "../src/payload.h"
+
+// Runs every step a payload goes through, from reading it to matching its
+// lines and sending events about them, on a generated workload, and prints
+// the results as JSON lines. Run by make bench, to compare releases:
+//
+//     ./bench_suite --lines=100000 --markup-ratio=0.5 --icons=1000 --data-size=64
+
+static const gchar* DEFAULT_EVENT_FORMAT = "{\"event\":\"{{event}}\", \"value\":\"{{value_escaped}}\", \"data\":\"{{data_escaped}}\"}";
+
+static const gchar* const QUERIES[][3] = {
+    { "file", NULL },
+    { "report", "2020", NULL },
+    { "nothing", NULL }
+};
+
+typedef struct {
+    BenchWorkload workload;
+    GPtrArray* payloads; // GString* of each variant
+    gchar* buffer;       // parsed payloads are copied to, as parsing changes them
+} BenchSuite;
+
+static void bench_suite_parse(BenchSuite* suite, guint variant, Payload* payload) {
+    GString* json = g_ptr_array_index(suite->payloads, variant);
+    memcpy(suite->buffer, json->str, json->len);
+    GError* error = NULL;
+    if (!payload_parse_json(payload, suite->buffer, json->len, &error)) {
+        fprintf(stderr, "generated payload does not parse: %s\n", error->message);
+        exit(1);
+    }
+}
+
+static PageData* bench_suite_build_page(BenchSuite* suite, guint variant) {
+    Payload payload;
+    bench_suite_parse(suite, variant, &payload);
+    PageData* page = page_data_new();
+    payload_build_lines(&payload.lines, page, 0);
+    return page;
+}
+
+// newline ended payloads, as a backend writes them to its stdout
+static guint64 bench_read_lines(BenchTimer* timer, gpointer context) {
+    BenchSuite* suite = context;
+    char path[] = "/tmp/bench_suite_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    for (guint i = 0; i < suite->payloads->len; ++i) {
+        GString* json = g_ptr_array_index(suite->payloads, i);
+        if (write(fd, json->str, json->len) != (ssize_t) json->len) {
+            perror("write");
+            exit(1);
+        }
+    }
+    lseek(fd, 0, SEEK_SET);
+    LineReader* reader = line_reader_new(fd);
+    guint64 payloads = 0;
+    gchar* line;
+    gsize length;
+    LineReaderStatus status;
+    bench_timer_start(timer);
+    do {
+        status = line_reader_fill(reader);
+        while (line_reader_next_line(reader, &line, &length)) {
+            payloads++;
+        }
+    } while (status == LineReaderStatus_AGAIN);
+    bench_timer_stop(timer);
+    line_reader_destroy(reader);
+    close(fd);
+    return payloads;
+}
+
+static guint64 bench_parse_payload(BenchTimer* timer, gpointer context) {
+    BenchSuite* suite = context;
+    guint64 lines = 0;
+    for (guint i = 0; i < suite->payloads->len; ++i) {
+        GString* json = g_ptr_array_index(suite->payloads, i);
+        memcpy(suite->buffer, json->str, json->len);
+        Payload payload;
+        bench_timer_start(timer);
+        gboolean parsed = payload_parse_json(&payload, suite->buffer, json->len, NULL);
+        bench_timer_stop(timer);
+        if (!parsed) {
+            exit(1);
+        }
+        lines += payload.lines.count;
+    }
+    return lines;
+}
+
+static guint64 bench_build_lines(BenchTimer* timer, gpointer context) {
+    BenchSuite* suite = context;
+    PageData* page = page_data_new();
+    guint64 lines = 0;
+    for (guint i = 0; i < suite->payloads->len; ++i) {
+        Payload payload;
+        bench_suite_parse(suite, i, &payload);
+        page_data_clear_lines(page);
+        bench_timer_start(timer);
+        payload_build_lines(&payload.lines, page, 0);
+        bench_timer_stop(timer);
+        lines += page_data_get_number_of_lines(page);
+    }
+    page_data_destroy(page);
+    return lines;
+}
+
+// what blocks_mode_private_data_update_page and applying the pending lines do
+// with the lines of a payload, without the rofi parts
+static guint64 bench_update_page(BenchTimer* timer, gpointer context) {
+    BenchSuite* suite = context;
+    PageData* page = page_data_new();
+    PageData* pending_page = page_data_new();
+    GArray* previous = g_array_new(FALSE, FALSE, sizeof(guint));
+    for (guint i = 0; i < suite->payloads->len; ++i) {
+        GString* json = g_ptr_array_index(suite->payloads, i);
+        memcpy(suite->buffer, json->str, json->len);
+        bench_timer_start(timer);
+        Payload payload;
+        if (!payload_parse_json(&payload, suite->buffer, json->len, NULL)) {
+            exit(1);
+        }
+        page_data_clear_lines(pending_page);
+        payload_build_lines(&payload.lines, pending_page, 0);
+        g_array_set_size(previous, 0);
+        if (!page_data_match_lines(page, pending_page, previous)) {
+            page_data_take_lines(page, pending_page);
+        } else {
+            page_data_clear_lines(pending_page);
+        }
+        bench_timer_stop(timer);
+    }
+    g_array_free(previous, TRUE);
+    page_data_destroy(pending_page);
+    page_data_destroy(page);
+    return suite->payloads->len;
+}
+
+typedef struct {
+    PageData* page;
+    const gchar* const* words;
+} BenchMatchContext;
+
+// stands in for rofi's token matcher, as in bench_match_bitmap
+static gboolean bench_line_matches(gpointer context, guint index) {
+    BenchMatchContext* match_context = context;
+    LineData* line = page_data_get_line_by_index_or_else(match_context->page, index, NULL);
+    gchar* folded = g_utf8_casefold(line->match_text, -1);
+    gboolean result = TRUE;
+    for (const gchar* const* word = match_context->words; result && *word != NULL; ++word) {
+        result = strstr(folded, *word) != NULL;
+    }
+    g_free(folded);
+    return result;
+}
+
+static guint64 bench_match_tokens(BenchTimer* timer, gpointer context) {
+    BenchSuite* suite = context;
+    BenchMatchContext match_context = { .page = bench_suite_build_page(suite, 0) };
+    guint length = page_data_get_number_of_lines(match_context.page);
+    MatchBitmap* bitmap = match_bitmap_new(1);
+    guint matches = 0;
+    bench_timer_start(timer);
+    for (guint query = 0; query < G_N_ELEMENTS(QUERIES); ++query) {
+        match_context.words = QUERIES[query];
+        for (guint i = 0; i < length; ++i) {
+            matches += match_bitmap_test(bitmap, query, match_context.page->lines_generation, length,
+                                         bench_line_matches, NULL, &match_context, i);
+        }
+    }
+    bench_timer_stop(timer);
+    g_debug("%u matches", matches);
+    match_bitmap_destroy(bitmap);
+    page_data_destroy(match_context.page);
+    return (guint64) length * G_N_ELEMENTS(QUERIES);
+}
+
+static guint64 bench_format_event(BenchTimer* timer, gpointer context) {
+    BenchSuite* suite = context;
+    PageData* page = bench_suite_build_page(suite, 0);
+    guint length = page_data_get_number_of_lines(page);
+    EventFormat* event_format = event_format_new(DEFAULT_EVENT_FORMAT);
+    gsize bytes = 0;
+    bench_timer_start(timer);
+    for (guint round = 0; round < suite->payloads->len; ++round) {
+        for (guint i = 0; i < length; ++i) {
+            LineData* line = page_data_get_line_by_index_or_else(page, i, NULL);
+            bytes += event_format_render(event_format, "SELECT_ENTRY", line->text, line->data)->len;
+        }
+    }
+    bench_timer_stop(timer);
+    g_debug("%zu bytes", bytes);
+    event_format_destroy(event_format);
+    page_data_destroy(page);
+    return (guint64) length * suite->payloads->len;
+}
+
+int main(int argc, char** argv) {
+    BenchSuite suite;
+    if (!bench_workload_parse_args(&suite.workload, argc, argv)) {
+        return 2;
+    }
+    suite.payloads = g_ptr_array_new();
+    gsize largest = 0;
+    for (guint i = 0; i < suite.workload.payloads; ++i) {
+        GString* json = g_string_new(NULL);
+        bench_workload_append_payload(json, &suite.workload, i);
+        largest = MAX(largest, json->len);
+        g_ptr_array_add(suite.payloads, json);
+    }
+    suite.buffer = g_malloc(largest);
+    gchar* workload = bench_workload_describe(&suite.workload);
+    gboolean ok = bench_run("read_lines", "payload", bench_read_lines, &suite, workload);
+    ok = bench_run("parse_payload", "line", bench_parse_payload, &suite, workload) && ok;
+    ok = bench_run("build_lines", "line", bench_build_lines, &suite, workload) && ok;
+    ok = bench_run("update_page", "payload", bench_update_page, &suite, workload) && ok;
+    ok = bench_run("match_tokens", "line", bench_match_tokens, &suite, workload) && ok;
+    ok = bench_run("format_event", "event", bench_format_event, &suite, workload) && ok;
+    g_free(workload);
+    g_free(suite.buffer);
+    for (guint i = 0; i < suite.payloads->len; ++i) {
+        g_string_free(g_ptr_array_index(suite.payloads, i), TRUE);
+    }
+    g_ptr_array_free(suite.payloads, TRUE);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmodule.h>
+#include "../src/match_bitmap.h"
+#include "../src/trigram_index.h"
+
+// Compares filtering a large list by scanning every line against filtering
+// only the candidates of a trigram index, for queries of varying
+// selectivity, along with what building the index costs.
+
+static const int ROUNDS = 5;
+
+typedef struct {
+    gchar** lines;
+    const gchar* const* words;
+    TrigramIndex* index;
+} BenchContext;
+
+static gboolean match_words(gpointer context, guint index) {
+    BenchContext* bench = context;
+    gchar* folded = g_utf8_casefold(bench->lines[index], -1);
+    gboolean result = TRUE;
+    for (const gchar* const* word = bench->words; result && *word != NULL; ++word) {
+        result = strstr(folded, *word) != NULL;
+    }
+    g_free(folded);
+    return result;
+}
+
+static GArray* index_candidates(gpointer context) {
+    BenchContext* bench = context;
+    return trigram_index_query(bench->index, bench->words);
+}
+
+static gint64 run(BenchContext* context, guint length, MatchBitmapCandidatesFunc candidates, guint* matches) {
+    MatchBitmap* bitmap = match_bitmap_new(1);
+    gint64 best = G_MAXINT64;
+    for (int round = 0; round < ROUNDS; ++round) {
+        gint64 start = g_get_monotonic_time();
+        *matches = 0;
+        for (guint i = 0; i < length; ++i) {
+            *matches += match_bitmap_test(bitmap, round, 0, length, match_words, candidates, context, i);
+        }
+        best = MIN(best, g_get_monotonic_time() - start);
+    }
+    match_bitmap_destroy(bitmap);
+    return best;
+}
+
+int main(int argc, char** argv) {
+    guint length = argc > 1 ? atoi(argv[1]) : 500000;
+    BenchContext context = { .lines = g_new(gchar*, length), .index = trigram_index_new() };
+    for (guint i = 0; i < length; ++i) {
+        context.lines[i] = g_strdup_printf("Entry number %u of the list, with some more text to match", i);
+    }
+
+    gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < length; ++i) {
+        trigram_index_add(context.index, context.lines[i], FALSE);
+    }
+    printf("%u lines indexed in %.2f ms, %.2f MiB\n", length,
+           (g_get_monotonic_time() - start) / 1000.0, context.index->memory / (1024.0 * 1024.0));
+
+    static const gchar* const queries[][3] = {
+        { "entry", NULL },
+        { "number 12", NULL },
+        { "text", "4242", NULL },
+        { "missing", NULL },
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(queries); ++i) {
+        context.words = queries[i];
+        guint scan_matches = 0;
+        guint index_matches = 0;
+        gint64 scan = run(&context, length, NULL, &scan_matches);
+        gint64 indexed = run(&context, length, index_candidates, &index_matches);
+        if (scan_matches != index_matches) {
+            fprintf(stderr, "index found %u matches instead of %u\n", index_matches, scan_matches);
+            exit(1);
+        }
+        printf("%-12s %-6s %8u matches  scan %10.2f ms  index %10.2f ms\n", queries[i][0],
+               queries[i][1] != NULL ? queries[i][1] : "", scan_matches, scan / 1000.0, indexed / 1000.0);
+    }
+
+    trigram_index_destroy(context.index);
+    for (guint i = 0; i < length; ++i) {
+        g_free(context.lines[i]);
+    }
+    g_free(context.lines);
+    return 0;
+}
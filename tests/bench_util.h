@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+// Measures benchmark cases and reports them one JSON object per line, so that
+// results of different releases can be compared:
+//
+//     {"bench":"parse_payload", "unit":"line", "ops":400000, "ns_per_op":81.3, ...}
+//
+// Every case runs in a process of its own, so that the peak RSS is its own.
+// Allocations are counted by wrapping malloc, with glibc only; they are
+// reported as null elsewhere.
+
+#ifndef ROFI_BLOCKS_BENCH_UTIL_H
+#define ROFI_BLOCKS_BENCH_UTIL_H
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <gmodule.h>
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define BENCH_COUNT_ALLOCATIONS 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+
+static guint64 bench_allocations = 0;
+
+void* malloc(size_t size) {
+    __atomic_add_fetch(&bench_allocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&bench_allocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    if (pointer == NULL) {
+        __atomic_add_fetch(&bench_allocations, 1, __ATOMIC_RELAXED);
+    }
+    return __libc_realloc(pointer, size);
+}
+#endif
+
+// time and allocations of the measured parts of a case
+typedef struct {
+    gint64 start;
+    gint64 elapsed;        // ns
+    guint64 allocations_start;
+    guint64 allocations;
+    gboolean running;
+} BenchTimer;
+
+// runs a case, measuring the parts it wants with the timer, and returns how
+// many operations it did
+typedef guint64 (*BenchFunc)(BenchTimer* timer, gpointer context);
+
+static gint64 bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (gint64) now.tv_sec * G_GINT64_CONSTANT(1000000000) + now.tv_nsec;
+}
+
+static guint64 bench_allocations_so_far(void) {
+#ifdef BENCH_COUNT_ALLOCATIONS
+    return __atomic_load_n(&bench_allocations, __ATOMIC_RELAXED);
+#else
+    return 0;
+#endif
+}
+
+static void bench_timer_start(BenchTimer* timer) {
+    timer->running = TRUE;
+    timer->allocations_start = bench_allocations_so_far();
+    timer->start = bench_now_ns();
+}
+
+static void bench_timer_stop(BenchTimer* timer) {
+    gint64 end = bench_now_ns();
+    timer->allocations += bench_allocations_so_far() - timer->allocations_start;
+    timer->elapsed += end - timer->start;
+    timer->running = FALSE;
+}
+
+static glong bench_current_rss_kib(void) {
+    glong pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*d %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Runs func in a child process and prints its results, with extra appended
+// as more members of the object. Returns whether the case succeeded.
+static gboolean bench_run(const gchar* name, const gchar* unit, BenchFunc func, gpointer context, const gchar* extra) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return FALSE;
+    }
+    if (pid == 0) {
+        BenchTimer timer = { 0 };
+        glong rss_before = bench_current_rss_kib();
+        guint64 ops = func(&timer, context);
+        if (timer.running) {
+            bench_timer_stop(&timer);
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        ops = MAX(ops, 1);
+        printf("{\"bench\":\"%s\", \"unit\":\"%s\", \"ops\":%" G_GUINT64_FORMAT ", \"ns_per_op\":%.2f, ",
+               name, unit, ops, (gdouble) timer.elapsed / ops);
+#ifdef BENCH_COUNT_ALLOCATIONS
+        printf("\"allocations\":%" G_GUINT64_FORMAT ", \"allocations_per_op\":%.3f, ",
+               timer.allocations, (gdouble) timer.allocations / ops);
+#else
+        printf("\"allocations\":null, \"allocations_per_op\":null, ");
+#endif
+        printf("\"peak_rss_kib\":%ld, \"rss_growth_kib\":%ld%s%s}\n", usage.ru_maxrss,
+               MAX(usage.ru_maxrss - rss_before, 0), extra != NULL ? ", " : "", extra != NULL ? extra : "");
+        fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench %s failed\n", name);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+#endif // ROFI_BLOCKS_BENCH_UTIL_H
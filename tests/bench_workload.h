@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+// Generates payloads like the ones backends send, for benchmarks: a number of
+// lines with words of text, some of them with pango markup, icons out of a
+// set of names, and data of some size. The same seed always generates the
+// same payloads.
+
+#ifndef ROFI_BLOCKS_BENCH_WORKLOAD_H
+#define ROFI_BLOCKS_BENCH_WORKLOAD_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmodule.h>
+
+typedef struct {
+    guint lines;
+    gdouble markup_ratio; // of lines with markup, from 0 to 1
+    guint icons;          // different icon names, 0 for lines without icon
+    guint data_size;      // bytes of data of every line
+    guint payloads;       // payloads sent, for benchmarks of streams
+    guint32 seed;
+} BenchWorkload;
+
+static const BenchWorkload BENCH_WORKLOAD_DEFAULT = {
+    .lines = 20000,
+    .markup_ratio = 0.1,
+    .icons = 32,
+    .data_size = 16,
+    .payloads = 10,
+    .seed = 1
+};
+
+static const gchar* const BENCH_WORKLOAD_WORDS[] = {
+    "file", "Documents", "report", "2020", "draft", "final", "music", "photo", "backup", "notes",
+    "\\\"quoted\\\"", "ünïcödé", "tab\\tseparated", "server", "local", "remote", "branch", "main", "todo", "done"
+};
+
+static guint32 bench_workload_random(guint32* state) {
+    // xorshift32
+    guint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void bench_workload_usage(const char* program) {
+    fprintf(stderr, "usage: %s [--lines=N] [--markup-ratio=R] [--icons=N] [--data-size=N] [--payloads=N] [--seed=N]\n",
+            program);
+}
+
+static gboolean bench_workload_is_option(const char* argument, gsize length, const char* option) {
+    return length == strlen(option) && strncmp(argument, option, length) == 0;
+}
+
+// reads the workload options out of the arguments, the defaults for the
+// missing ones
+static gboolean bench_workload_parse_args(BenchWorkload* workload, int argc, char** argv) {
+    *workload = BENCH_WORKLOAD_DEFAULT;
+    for (int i = 1; i < argc; ++i) {
+        const char* value = strchr(argv[i], '=');
+        if (value == NULL) {
+            bench_workload_usage(argv[0]);
+            return FALSE;
+        }
+        gsize length = value - argv[i];
+        value++;
+        if (bench_workload_is_option(argv[i], length, "--lines")) {
+            workload->lines = strtoul(value, NULL, 10);
+        } else if (bench_workload_is_option(argv[i], length, "--markup-ratio")) {
+            workload->markup_ratio = CLAMP(strtod(value, NULL), 0.0, 1.0);
+        } else if (bench_workload_is_option(argv[i], length, "--icons")) {
+            workload->icons = strtoul(value, NULL, 10);
+        } else if (bench_workload_is_option(argv[i], length, "--data-size")) {
+            workload->data_size = strtoul(value, NULL, 10);
+        } else if (bench_workload_is_option(argv[i], length, "--payloads")) {
+            workload->payloads = MAX(strtoul(value, NULL, 10), 1);
+        } else if (bench_workload_is_option(argv[i], length, "--seed")) {
+            workload->seed = MAX(strtoul(value, NULL, 10), 1);
+        } else {
+            bench_workload_usage(argv[0]);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// the workload as members of a JSON object, to tell results apart
+static gchar* bench_workload_describe(const BenchWorkload* workload) {
+    return g_strdup_printf("\"lines\":%u, \"markup_ratio\":%.2f, \"icons\":%u, \"data_size\":%u, \"payloads\":%u",
+                           workload->lines, workload->markup_ratio, workload->icons, workload->data_size,
+                           workload->payloads);
+}
+
+static void bench_workload_append_words(GString* payload, guint32* state, guint count) {
+    for (guint i = 0; i < count; ++i) {
+        guint32 word = bench_workload_random(state) % G_N_ELEMENTS(BENCH_WORKLOAD_WORDS);
+        g_string_append_printf(payload, "%s%s", i == 0 ? "" : " ", BENCH_WORKLOAD_WORDS[word]);
+    }
+}
+
+// Appends the JSON payload number variant of the workload, newline ended.
+// Payloads of different variants differ in about one line out of ten, like
+// the ones of a backend updating a list.
+static void bench_workload_append_payload(GString* payload, const BenchWorkload* workload, guint variant) {
+    guint32 state = workload->seed;
+    guint markup_threshold = (guint) (workload->markup_ratio * 1000);
+    g_string_append_printf(payload, "{\"prompt\":\"bench\", \"message\":\"payload %u\", \"lines\":[", variant);
+    for (guint i = 0; i < workload->lines; ++i) {
+        gboolean markup = bench_workload_random(&state) % 1000 < markup_threshold;
+        gboolean changed = bench_workload_random(&state) % 10 == 0;
+        g_string_append_printf(payload, "%s{\"text\":\"", i == 0 ? "" : ",");
+        if (markup) {
+            g_string_append(payload, "<b>");
+            bench_workload_append_words(payload, &state, 2);
+            g_string_append(payload, "</b> <span color='gray'>");
+            bench_workload_append_words(payload, &state, 3);
+            g_string_append(payload, "</span>");
+        } else {
+            bench_workload_append_words(payload, &state, 5);
+        }
+        g_string_append_printf(payload, " %u\"", changed ? i + variant * workload->lines : i);
+        if (markup) {
+            g_string_append(payload, ", \"markup\":true");
+        }
+        if (workload->icons > 0) {
+            g_string_append_printf(payload, ", \"icon\":\"icon-%u\"", bench_workload_random(&state) % workload->icons);
+        }
+        if (workload->data_size > 0) {
+            g_string_append(payload, ", \"data\":\"");
+            for (guint j = 0; j < workload->data_size; ++j) {
+                g_string_append_c(payload, 'a' + (i + j) % 26);
+            }
+            g_string_append_c(payload, '"');
+        }
+        if (i % 50 == 0) {
+            g_string_append(payload, ", \"urgent\":true");
+        }
+        g_string_append_c(payload, '}');
+    }
+    g_string_append(payload, "]}\n");
+}
+
+#endif // ROFI_BLOCKS_BENCH_WORKLOAD_H
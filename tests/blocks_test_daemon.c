@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+
+// A backend serving many rofi-blocks sessions over a Unix socket, standing
+// in for real ones while trying -blocks-connect:
+//
+//     ./blocks_test_daemon /tmp/blocks.sock &
+//     rofi -modi blocks -show blocks -blocks-connect /tmp/blocks.sock
+//
+// Every connection is a session of its own, which is shown the last events
+// it sent, and how many sessions are connected.
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "../src/string_utils.h"
+#include "../src/unix_socket.h"
+
+// events shown to each session
+static const guint MAX_EVENTS = 10;
+
+typedef struct {
+    int fd;
+    GString* input;   // received, not yet handled
+    gchar* id;        // as sent in INIT
+    GPtrArray* events;
+} Session;
+
+static Session* session_new(int fd) {
+    Session* session = g_malloc0(sizeof(*session));
+    session->fd = fd;
+    session->input = g_string_new(NULL);
+    session->id = g_strdup("?");
+    session->events = g_ptr_array_new_with_free_func(g_free);
+    return session;
+}
+
+static void session_free(gpointer pointer) {
+    Session* session = pointer;
+    close(session->fd);
+    g_string_free(session->input, TRUE);
+    g_free(session->id);
+    g_ptr_array_free(session->events, TRUE);
+    g_free(session);
+}
+
+// the INIT data is the rofi version, then the session id
+static void session_read_id(Session* session, const gchar* event) {
+    const gchar* data = strstr(event, "\"data\":\"");
+    const gchar* id = data != NULL ? strchr(data + strlen("\"data\":\""), ' ') : NULL;
+    const gchar* end = id != NULL ? strchr(id, '"') : NULL;
+    if (end != NULL) {
+        g_free(session->id);
+        session->id = g_strndup(id + 1, end - id - 1);
+    }
+}
+
+static gboolean session_send_page(Session* session, guint sessions) {
+    GString* page = g_string_new(NULL);
+    g_string_append_printf(page, "{\"prompt\": \"session %s\", \"message\": \"%u sessions connected\", \"lines\": [",
+                           session->id, sessions);
+    for (guint i = session->events->len; i > 0; --i) {
+        char* escaped = str_new_escaped_for_json_string(g_ptr_array_index(session->events, i - 1));
+        g_string_append_printf(page, "%s\"%s\"", i < session->events->len ? ", " : "", escaped);
+        free(escaped);
+    }
+    g_string_append(page, "]}\n");
+    gboolean sent = write(session->fd, page->str, page->len) == (ssize_t) page->len;
+    g_string_free(page, TRUE);
+    return sent;
+}
+
+// handles what the session sent, returns FALSE once it is over
+static gboolean session_handle_input(Session* session, guint sessions) {
+    char buffer[4096];
+    ssize_t count = read(session->fd, buffer, sizeof(buffer));
+    if (count <= 0) {
+        return FALSE;
+    }
+    g_string_append_len(session->input, buffer, count);
+    gchar* newline;
+    gboolean open = TRUE;
+    while (open && (newline = memchr(session->input->str, '\n', session->input->len)) != NULL) {
+        gchar* event = g_strndup(session->input->str, newline - session->input->str);
+        g_string_erase(session->input, 0, newline - session->input->str + 1);
+        if (strstr(event, "\"event\":\"INIT\"") != NULL) {
+            session_read_id(session, event);
+        }
+        open = strstr(event, "\"event\":\"EXIT\"") == NULL;
+        g_ptr_array_add(session->events, event);
+        if (session->events->len > MAX_EVENTS) {
+            g_ptr_array_remove_index(session->events, 0);
+        }
+        open = open && session_send_page(session, sessions);
+    }
+    return open;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s /path/to.sock\n", argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    GError* error = NULL;
+    int listen_fd = unix_socket_listen(argv[1], &error);
+    if (listen_fd < 0) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    GPtrArray* sessions = g_ptr_array_new_with_free_func(session_free);
+    GArray* fds = g_array_new(FALSE, TRUE, sizeof(struct pollfd));
+    while (TRUE) {
+        g_array_set_size(fds, sessions->len + 1);
+        struct pollfd* pollfds = (struct pollfd*) fds->data;
+        pollfds[0] = (struct pollfd) { .fd = listen_fd, .events = POLLIN };
+        for (guint i = 0; i < sessions->len; ++i) {
+            Session* session = g_ptr_array_index(sessions, i);
+            pollfds[i + 1] = (struct pollfd) { .fd = session->fd, .events = POLLIN };
+        }
+        if (poll(pollfds, fds->len, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        // sessions are removed from the last, so that indexes stay valid
+        for (guint i = sessions->len; i > 0; --i) {
+            if (pollfds[i].revents != 0 && !session_handle_input(g_ptr_array_index(sessions, i - 1), sessions->len)) {
+                fprintf(stderr, "session %s closed\n", ((Session*) g_ptr_array_index(sessions, i - 1))->id);
+                g_ptr_array_remove_index(sessions, i - 1);
+            }
+        }
+        if (pollfds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                g_ptr_array_add(sessions, session_new(fd));
+            }
+        }
+    }
+    g_array_free(fds, TRUE);
+    g_ptr_array_free(sessions, TRUE);
+    close(listen_fd);
+    unlink(argv[1]);
+    return 1;
+}
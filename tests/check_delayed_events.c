@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/delayed_events.h"
+
+enum { INPUT, SELECT_ENTRY, ACCEPT_CUSTOM, FETCH_LINES };
+
+// appends "kind:value:data;" for every event sent
+static void on_send(gint kind, const gchar* value, const gchar* data, gpointer context) {
+    g_string_append_printf((GString*) context, "%d:%s:%s;", kind, value, data);
+}
+
+int main(void)
+{
+    GString* sent = g_string_new(NULL);
+    DelayedEvents* events = delayed_events_new(INPUT, SELECT_ENTRY, on_send, sent);
+
+    // without delays events are sent as they happen
+    delayed_events_push(events, INPUT, "a", "");
+    delayed_events_push(events, SELECT_ENTRY, "", "1");
+    test_string_equals(.result = sent->str, .expected = "0:a:;1::1;");
+    g_string_truncate(sent, 0);
+
+    // debounced events keep the newest value until their delay passed
+    events->input.debounce_ms = 60000;
+    events->select_entry.debounce_ms = 60000;
+    delayed_events_push(events, INPUT, "ab", "");
+    delayed_events_push(events, INPUT, "abc", "");
+    delayed_events_push(events, SELECT_ENTRY, "", "2");
+    test_string_equals(.result = sent->str, .expected = "");
+    test_true(events->input.pending);
+    test_true(events->input.timeout > 0);
+
+    // events that are not user actions leave them pending
+    delayed_events_send(events, FETCH_LINES, "0", "64");
+    test_string_equals(.result = sent->str, .expected = "3:0:64;");
+    test_true(events->input.pending);
+    test_true(events->select_entry.pending);
+    test_true(events->input.timeout > 0);
+    g_string_truncate(sent, 0);
+
+    // user actions send them first, in the order they happened
+    delayed_events_push(events, ACCEPT_CUSTOM, "abc", "");
+    test_string_equals(.result = sent->str, .expected = "0:abc:;1::2;2:abc:;");
+    test_true(!events->input.pending);
+    test_true(!events->select_entry.pending);
+    test_uint_equals(.result = events->input.timeout, .expected = 0);
+    g_string_truncate(sent, 0);
+
+    // throttle sends the first event right away, later ones once per interval
+    events->input.debounce_ms = 0;
+    events->input.throttle_ms = 60000;
+    events->input.last_sent = 0;
+    delayed_events_push(events, INPUT, "x", "");
+    delayed_events_push(events, INPUT, "xy", "");
+    test_string_equals(.result = sent->str, .expected = "0:x:;");
+    test_true(events->input.pending);
+    delayed_events_flush(events);
+    test_string_equals(.result = sent->str, .expected = "0:x:;0:xy:;");
+
+    delayed_events_destroy(events);
+    g_string_free(sent, TRUE);
+    return test_finish();
+}
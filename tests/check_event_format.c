@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/event_format.h"
+
+int main(void)
+{
+    EventFormat* event_format = event_format_new("{\"event\":\"{{event}}\", \"value\":\"{{value_escaped}}\", \"data\":\"{{data_escaped}}\"}");
+    test_uint_equals(.result = event_format->segments->len, .expected = 7);
+
+    GString* result = event_format_render(event_format, "SELECT_ENTRY", "a \"quoted\"\tvalue", "c:\\data");
+    test_string_equals(.result = result->str, .expected = "{\"event\":\"SELECT_ENTRY\", \"value\":\"a \\\"quoted\\\"\\tvalue\", \"data\":\"c:\\\\data\"}");
+    test_uint_equals(.result = result->len, .expected = strlen(result->str));
+
+    result = event_format_render(event_format, "INPUT_CHANGE", "", NULL);
+    test_string_equals(.result = result->str, .expected = "{\"event\":\"INPUT_CHANGE\", \"value\":\"\", \"data\":\"\"}");
+
+    event_format_set(event_format, "{{event}}{{value}}|{{data}} {{unknown}} {{value}}");
+    result = event_format_render(event_format, "E", "{{data}}", "\"d\"");
+    test_string_equals(.result = result->str, .expected = "E{{data}}|\"d\" {{unknown}} {{data}}");
+
+    event_format_set(event_format, "");
+    test_uint_equals(.result = event_format->segments->len, .expected = 0);
+    test_string_equals(.result = event_format_render(event_format, "E", "v", "d")->str, .expected = "");
+
+    event_format_set(event_format, "no parameters {{");
+    test_string_equals(.result = event_format_render(event_format, "E", "v", "d")->str, .expected = "no parameters {{");
+
+    // the msgpack protocol ignores the format
+    result = event_format_render_msgpack(event_format, "INPUT", "v", NULL);
+    const char expected[] = "\0\0\0\x1b" "\x83" "\xa5" "event" "\xa5" "INPUT" "\xa5" "value" "\xa1" "v" "\xa4" "data" "\xa0";
+    test_uint_equals(.result = result->len, .expected = sizeof(expected) - 1);
+    test_true(memcmp(result->str, expected, result->len) == 0);
+
+    event_format_destroy(event_format);
+
+    return test_finish();
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/event_queue.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+enum { BIG, SELECT, INPUT, ACCEPT };
+
+// events are queued as lines, as they are written in the json protocol
+static void push(EventQueue* queue, const char* text, int kind) {
+    GString* line = g_string_new(text);
+    g_string_append_c(line, '\n');
+    event_queue_push(queue, line->str, line->len, kind, kind == SELECT || kind == INPUT);
+    g_string_free(line, TRUE);
+}
+
+// reads everything the queue writes, until it is empty
+static GString* read_all(EventQueue* queue, int read_fd) {
+    GString* result = g_string_new(NULL);
+    char buffer[65536];
+    gboolean pending = TRUE;
+    while (pending) {
+        pending = event_queue_flush(queue);
+        ssize_t count;
+        while ((count = read(read_fd, buffer, sizeof(buffer))) > 0) {
+            g_string_append_len(result, buffer, count);
+        }
+    }
+    return result;
+}
+
+int main(void)
+{
+    // writing to the closed pipe must fail with EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+    int fds[2];
+    test_true(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    // the file descriptor mode is left as it is, it may be shared
+    int flags = fcntl(fds[1], F_GETFL);
+    EventQueue* queue = event_queue_new(fds[1], 4);
+    test_true(fcntl(fds[1], F_GETFL) == flags);
+    fcntl(fds[1], F_SETFL, flags | O_NONBLOCK);
+    push(queue, "first", ACCEPT);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 0);
+    test_uint_equals(.result = queue->sent, .expected = 1);
+
+    // fills the pipe, so that the following events stay queued
+    GString* big = g_string_new(NULL);
+    for (int i = 0; i < 1024 * 1024; ++i) {
+        g_string_append_c(big, 'x');
+    }
+    push(queue, big->str, BIG);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 1);
+    test_true(queue->head_written > 0 && queue->watch > 0);
+
+    push(queue, "select a", SELECT);
+    push(queue, "select b", SELECT);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 2);
+    test_uint_equals(.result = queue->dropped, .expected = 1);
+
+    push(queue, "input x", INPUT);
+    push(queue, "accept", ACCEPT);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 4);
+    test_uint_equals(.result = queue->dropped, .expected = 1);
+
+    // once full, the oldest droppable events make room for new ones
+    push(queue, "input y", INPUT);
+    push(queue, "accept 2", ACCEPT);
+    push(queue, "select c", SELECT);
+    push(queue, "accept 3", ACCEPT);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 4);
+    test_uint_equals(.result = queue->dropped, .expected = 5);
+
+    // and events that cannot be dropped go past the limit
+    push(queue, "accept 4", ACCEPT);
+    push(queue, "select d", SELECT);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 5);
+    test_uint_equals(.result = queue->dropped, .expected = 6);
+    test_uint_equals(.result = queue->peak_depth, .expected = 5);
+
+    GString* output = read_all(queue, fds[0]);
+    test_true(output->len > big->len + 1);
+    test_string_equals(.result = output->str + strlen("first\n") + big->len + 1, .expected = "accept\naccept 2\naccept 3\naccept 4\n");
+    test_uint_equals(.result = queue->sent, .expected = 6);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 0);
+
+    close(fds[0]);
+    push(queue, "after close", ACCEPT);
+    test_true(queue->closed);
+    test_uint_equals(.result = event_queue_get_depth(queue), .expected = 0);
+
+    event_queue_destroy(queue);
+    close(fds[1]);
+    g_string_free(big, TRUE);
+    g_string_free(output, TRUE);
+
+    return test_finish();
+}
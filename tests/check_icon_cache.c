@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/icon_cache.h"
+
+static guint fetches = 0;
+
+static uint32_t fetch(const char* name, const int size) {
+    return ++fetches;
+}
+
+int main(void)
+{
+    IconCache* cache = icon_cache_new(fetch);
+    uint32_t folder = icon_cache_lookup(cache, "folder", 24);
+    test_uint_equals(.result = fetches, .expected = 1);
+
+    // lines sharing an icon share its fetch
+    gchar* name = g_strdup("folder");
+    test_uint_equals(.result = icon_cache_lookup(cache, name, 24), .expected = folder);
+    g_free(name);
+    test_uint_equals(.result = fetches, .expected = 1);
+
+    // each size is fetched on its own
+    uint32_t bigger = icon_cache_lookup(cache, "folder", 48);
+    test_true(bigger != folder);
+    test_uint_equals(.result = icon_cache_lookup(cache, "text-x-generic", 24), .expected = 3);
+    test_uint_equals(.result = icon_cache_lookup(cache, "folder", 48), .expected = bigger);
+    test_uint_equals(.result = fetches, .expected = 3);
+    test_uint_equals(.result = cache->hits, .expected = 2);
+    test_uint_equals(.result = cache->misses, .expected = 3);
+
+    icon_cache_destroy(cache);
+    return test_finish();
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/line_reader.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+static void write_bytes(int fd, const gchar* bytes, gsize length) {
+    test_true(write(fd, bytes, length) == (ssize_t) length);
+}
+
+static void write_text(int fd, const gchar* text) {
+    write_bytes(fd, text, strlen(text));
+}
+
+// a file holding a line of length bytes, then tail without a newline
+static int open_long_line_file(gsize length, const gchar* tail) {
+    char path[] = "/tmp/check_line_reader_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    gchar* line = g_malloc(length + 1);
+    memset(line, 'x', length);
+    line[length] = '\n';
+    write_bytes(fd, line, length + 1);
+    write_text(fd, tail);
+    g_free(line);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+int main(void)
+{
+    int fds[2];
+    test_true(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    LineReader* reader = line_reader_new(fds[0]);
+    gchar* line;
+    gsize length;
+
+    // lines split across reads are handed out once complete
+    write_text(fds[1], "{\"a\":1}\n{\"b");
+    test_true(line_reader_fill(reader) == LineReaderStatus_AGAIN);
+    test_true(line_reader_next_line(reader, &line, &length));
+    test_string_equals(.result = line, .expected = "{\"a\":1}");
+    test_uint_equals(.result = length, .expected = 7);
+    test_true(!line_reader_next_line(reader, &line, &length));
+    write_text(fds[1], "\":2}\n");
+    test_true(line_reader_fill(reader) == LineReaderStatus_AGAIN);
+    // the rest of the buffer was moved back to its start
+    test_uint_equals(.result = reader->start, .expected = 0);
+    test_true(line_reader_next_line(reader, &line, &length));
+    test_true(line == reader->buffer);
+    test_string_equals(.result = line, .expected = "{\"b\":2}");
+    test_true(!line_reader_next_line(reader, &line, &length));
+
+    // empty lines and lines with invalid UTF-8 are dropped
+    write_text(fds[1], "\n\xff\xfe\nok\n");
+    test_true(line_reader_fill(reader) == LineReaderStatus_AGAIN);
+    test_true(line_reader_next_line(reader, &line, &length));
+    test_string_equals(.result = line, .expected = "ok");
+    test_true(!line_reader_next_line(reader, &line, &length));
+
+    // frames split across reads, empty frames are skipped
+    line_reader_set_framed(reader, TRUE);
+    write_bytes(fds[1], "\x00\x00\x00\x0a" "0123", 8);
+    test_true(line_reader_fill(reader) == LineReaderStatus_AGAIN);
+    test_true(!line_reader_next_frame(reader, &line, &length));
+    write_bytes(fds[1], "456789" "\x00\x00\x00\x00" "\x00\x00\x00\x02" "xy" "\x20\x00", 18);
+    test_true(line_reader_fill(reader) == LineReaderStatus_AGAIN);
+    test_true(line_reader_next_frame(reader, &line, &length));
+    test_uint_equals(.result = length, .expected = 10);
+    test_true(memcmp(line, "0123456789", 10) == 0);
+    test_true(line_reader_next_frame(reader, &line, &length));
+    test_uint_equals(.result = length, .expected = 2);
+    test_true(memcmp(line, "xy", 2) == 0);
+    test_true(!line_reader_next_frame(reader, &line, &length));
+
+    // frames announcing more than the reader takes break the stream, once
+    // the rest of their length arrives
+    write_bytes(fds[1], "\x00\x00", 2);
+    test_true(line_reader_fill(reader) == LineReaderStatus_ERROR);
+    line_reader_destroy(reader);
+
+    close(fds[1]);
+    reader = line_reader_new(fds[0]);
+    test_true(line_reader_fill(reader) == LineReaderStatus_EOF);
+    line_reader_destroy(reader);
+    close(fds[0]);
+
+    // a line longer than a single read, the trailing partial line at EOF is
+    // never handed out
+    int fd = open_long_line_file(200 * 1024, "partial");
+    reader = line_reader_new(fd);
+    test_true(line_reader_fill(reader) == LineReaderStatus_EOF);
+    test_true(line_reader_next_line(reader, &line, &length));
+    test_uint_equals(.result = length, .expected = 200 * 1024);
+    test_true(line[0] == 'x' && line[length - 1] == 'x');
+    test_true(!line_reader_next_line(reader, &line, &length));
+    line_reader_destroy(reader);
+    close(fd);
+
+    // the buffer of a huge line shrinks back once it was handed out
+    fd = open_long_line_file(5 * 1024 * 1024, "");
+    reader = line_reader_new(fd);
+    gsize initial_capacity = reader->capacity;
+    test_true(line_reader_fill(reader) == LineReaderStatus_AGAIN);
+    test_true(reader->capacity > 5 * 1024 * 1024);
+    test_true(line_reader_next_line(reader, &line, &length));
+    test_uint_equals(.result = length, .expected = 5 * 1024 * 1024);
+    test_true(line_reader_fill(reader) == LineReaderStatus_EOF);
+    test_true(!line_reader_next_line(reader, &line, &length));
+    test_uint_equals(.result = reader->capacity, .expected = initial_capacity);
+    line_reader_destroy(reader);
+    close(fd);
+
+    return test_finish();
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/lru_cache.h"
+
+static guint freed = 0;
+
+static void free_value(gpointer value) {
+    freed++;
+    g_free(value);
+}
+
+static void append_entry(gpointer key, gpointer value, gpointer entries) {
+    g_string_append_printf(entries, "%u=%s ", GPOINTER_TO_UINT(key), (gchar*) value);
+}
+
+int main(void)
+{
+    LruCache* cache = lru_cache_new(2, free_value);
+    test_true(lru_cache_lookup(cache, 0) == NULL);
+    lru_cache_insert(cache, 0, g_strdup("zero"));
+    lru_cache_insert(cache, 1, g_strdup("one"));
+    test_string_equals(.result = lru_cache_lookup(cache, 0), .expected = "zero");
+
+    // one was used less recently than zero
+    lru_cache_insert(cache, 2, g_strdup("two"));
+    test_uint_equals(.result = lru_cache_size(cache), .expected = 2);
+    test_uint_equals(.result = freed, .expected = 1);
+    test_true(lru_cache_lookup(cache, 1) == NULL);
+    test_string_equals(.result = lru_cache_lookup(cache, 0), .expected = "zero");
+    test_string_equals(.result = lru_cache_lookup(cache, 2), .expected = "two");
+
+    // replacing a value frees the previous one, and makes it the newest
+    lru_cache_insert(cache, 0, g_strdup("ZERO"));
+    test_uint_equals(.result = freed, .expected = 2);
+    lru_cache_insert(cache, 3, g_strdup("three"));
+    test_true(lru_cache_lookup(cache, 2) == NULL);
+    test_string_equals(.result = lru_cache_lookup(cache, 0), .expected = "ZERO");
+    test_uint_equals(.result = cache->evictions, .expected = 2);
+    test_uint_equals(.result = cache->hits, .expected = 4);
+    test_uint_equals(.result = cache->misses, .expected = 3);
+
+    GString* entries = g_string_new(NULL);
+    lru_cache_foreach(cache, append_entry, entries);
+    test_string_equals(.result = entries->str, .expected = "0=ZERO 3=three ");
+    g_string_free(entries, TRUE);
+
+    lru_cache_clear(cache);
+    test_uint_equals(.result = lru_cache_size(cache), .expected = 0);
+    test_uint_equals(.result = freed, .expected = 5);
+    lru_cache_insert(cache, 4, g_strdup("four"));
+    lru_cache_destroy(cache);
+    test_uint_equals(.result = freed, .expected = 6);
+    return test_finish();
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/match_bitmap.h"
+
+static gint calls = 0;
+
+static gboolean match_every_third(gpointer context, guint index) {
+    g_atomic_int_inc(&calls);
+    return index % GPOINTER_TO_UINT(context) == 0;
+}
+
+// every even line
+static GArray* even_candidates(gpointer context) {
+    GArray* candidates = g_array_new(FALSE, FALSE, sizeof(guint));
+    for (guint i = 0; i < 100003; i += 2) {
+        g_array_append_val(candidates, i);
+    }
+    return candidates;
+}
+
+static gboolean all_bits_match(MatchBitmap* bitmap, guint64 lines_generation, guint length, guint step) {
+    for (guint i = 0; i < length; ++i) {
+        gboolean result = match_bitmap_test(bitmap, 1, lines_generation, length, match_every_third, NULL, GUINT_TO_POINTER(step), i);
+        if (result != (i % step == 0)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+int main(void)
+{
+    MatchBitmap* bitmap = match_bitmap_new(4);
+    const guint length = 100003;
+
+    test_true(all_bits_match(bitmap, 1, length, 3));
+    test_uint_equals(.result = calls, .expected = length);
+    test_true(!match_bitmap_test(bitmap, 1, 1, length, match_every_third, NULL, GUINT_TO_POINTER(3), length));
+
+    // nothing is matched again until a generation changes
+    test_true(all_bits_match(bitmap, 1, length, 3));
+    test_uint_equals(.result = calls, .expected = length);
+    test_true(all_bits_match(bitmap, 2, length, 7));
+    test_uint_equals(.result = calls, .expected = 2 * length);
+
+    // few lines are matched by the calling thread
+    test_true(all_bits_match(bitmap, 2, 100, 5));
+    test_uint_equals(.result = calls, .expected = 2 * length + 100);
+
+    // only candidates are matched
+    calls = 0;
+    guint matches = 0;
+    for (guint i = 0; i < length; ++i) {
+        matches += match_bitmap_test(bitmap, 3, 1, length, match_every_third, even_candidates, GUINT_TO_POINTER(3), i);
+    }
+    test_uint_equals(.result = calls, .expected = (length + 1) / 2);
+    test_uint_equals(.result = matches, .expected = (length + 5) / 6);
+
+    // the matches of a query narrow the next one down
+    GArray* previous = match_bitmap_get_matches(bitmap, 1, length);
+    test_uint_equals(.result = previous->len, .expected = (length + 5) / 6);
+    test_uint_equals(.result = g_array_index(previous, guint, 1), .expected = 6);
+    test_uint_equals(.result = g_array_index(previous, guint, previous->len - 1), .expected = length - 1);
+    g_array_free(previous, TRUE);
+    test_true(match_bitmap_get_matches(bitmap, 2, length) == NULL);
+    test_true(match_bitmap_get_matches(bitmap, 1, length + 1) == NULL);
+
+    // lines that moved keep their results, new ones are candidates
+    const guint moved[] = { 6, 1, G_MAXUINT, 12 };
+    match_bitmap_remap(bitmap, 1, 2, moved, G_N_ELEMENTS(moved));
+    previous = match_bitmap_get_matches(bitmap, 2, G_N_ELEMENTS(moved));
+    test_uint_equals(.result = previous->len, .expected = 3);
+    test_uint_equals(.result = g_array_index(previous, guint, 1), .expected = 2);
+    g_array_free(previous, TRUE);
+    test_true(!bitmap->valid);
+    match_bitmap_remap(bitmap, 1, 3, moved, G_N_ELEMENTS(moved));
+    test_true(match_bitmap_get_matches(bitmap, 3, G_N_ELEMENTS(moved)) == NULL);
+
+    match_bitmap_destroy(bitmap);
+
+    bitmap = match_bitmap_new(1);
+    test_true(bitmap->pool == NULL);
+    test_true(all_bits_match(bitmap, 1, length, 3));
+    match_bitmap_destroy(bitmap);
+
+    return test_finish();
+}
@@ -2,6 +2,44 @@
 // Copyright (C) 2020 Omar Castro
 #include "simple_tap_test_util.h"
 #include "../src/page_data.h"
+#include <stdio.h>
+
+static void append_uint(GString* out, guint32 value) {
+    value = GUINT32_TO_LE(value);
+    g_string_append_len(out, (const gchar*) &value, sizeof(value));
+}
+
+static void append_entry(GString* out, const guint32* fields) {
+    for (int i = 0; i < 9; ++i) {
+        append_uint(out, fields[i]);
+    }
+}
+
+static void write_lines_file(const char* path) {
+    GString* out = g_string_new("RBLF");
+    append_uint(out, 1);
+    append_uint(out, 3);
+    append_uint(out, 0);
+    append_entry(out, (guint32[]) { 0, 3, G_MAXUINT32, 0, 0, 0, 0, 0, 0 });
+    append_entry(out, (guint32[]) { 4, 10, 15, 1, 17, 4, 0, 0, LinesFileFlag_URGENT | LinesFileFlag_MARKUP | LinesFileFlag_MARKUP_SET });
+    append_entry(out, (guint32[]) { 100, 5, G_MAXUINT32, 0, 0, 0, 0, 0, 0 });
+    g_string_append_len(out, "one\0<b>two</b>\0m\0icon\0", 22);
+    FILE* file = fopen(path, "wb");
+    fwrite(out->str, 1, out->len, file);
+    fclose(file);
+    g_string_free(out, TRUE);
+}
+
+// reads every line, as filter threads do
+static gpointer read_every_line(gpointer context) {
+    PageData* page = context;
+    gboolean complete = TRUE;
+    for (guint i = 0; i < page_data_get_number_of_lines(page); ++i) {
+        LineData* line = page_data_get_line_by_index_or_else(page, i, NULL);
+        complete = complete && line->text != NULL && line->match_text != NULL;
+    }
+    return GINT_TO_POINTER(complete);
+}
 
 int main(void)
 {
@@ -15,13 +53,206 @@ int main(void)
     test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 0);
 
 
-    page_data_add_line(page_data, "aaa", "any-icon", "any-data", true, true, true);
+    page_data_add_line(page_data, "aaa", NULL, "any-icon", "any-data", true, true, true, false, true);
     test_string_equals(.result =  page_data_get_line_by_index_or_else(page_data, 0, NULL)->text, .expected= "aaa");
     test_true(page_data_get_line_by_index_or_else(page_data, -1, NULL) == NULL);
     test_true(page_data_get_line_by_index_or_else(NULL, 0, NULL) == NULL);
     test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 1);
 
 
+    page_data_add_line(page_data, "bbb", NULL, "", "", false, false, false, false, true);
+    page_data_add_line(page_data, "ccc", NULL, "", "", false, false, false, false, true);
+    page_data_set_max_lines(page_data, 2);
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 2);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 0, NULL)->text, .expected= "bbb");
+    test_uint_equals(.result = page_data->lines_evicted, .expected = 0);
+
+    // appending to a full ring evicts the oldest line, which is not a reset
+    guint64 reset_generation = page_data->lines_reset_generation;
+    page_data_add_line(page_data, "ddd", NULL, "", "", false, false, false, false, true);
+    test_true(page_data->lines_reset_generation == reset_generation);
+    test_uint_equals(.result = page_data->lines_evicted, .expected = 1);
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 2);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 0, NULL)->text, .expected= "ccc");
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 1, NULL)->text, .expected= "ddd");
+    test_true(page_data_get_line_by_index_or_else(page_data, 2, NULL) == NULL);
+
+    page_data_set_max_lines(page_data, 0);
+    test_true(page_data->lines_reset_generation != reset_generation);
+    test_uint_equals(.result = page_data->lines_evicted, .expected = 0);
+    page_data_add_line(page_data, "eee", NULL, "", "", false, false, false, false, true);
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 3);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 0, NULL)->text, .expected= "ccc");
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 2, NULL)->text, .expected= "eee");
+
+
+    page_data_clear_lines(page_data);
+    page_data_add_line(page_data, "fff", "meta", NULL, "data", false, false, false, false, true);
+    LineData* line = page_data_get_line_by_index_or_else(page_data, 0, NULL);
+    test_string_equals(.result = line->text, .expected= "fff");
+    test_string_equals(.result = line->meta, .expected= "meta");
+    test_true(line->icon == NULL);
+    test_string_equals(.result = line->data, .expected= "data");
+    test_string_equals(.result = line->match_text, .expected= "meta");
+
+    page_data_add_line(page_data, "<b>bold</b> text", NULL, "", "", false, false, true, false, true);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 1, NULL)->match_text, .expected= "bold text");
+    page_data_add_line(page_data, "<b>not markup</b>", NULL, "", "", false, false, false, false, true);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 2, NULL)->match_text, .expected= "<b>not markup</b>");
+    page_data_add_line(page_data, "<b>broken", "<i>meta</i>", "", "", false, false, true, false, true);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 3, NULL)->match_text, .expected= "meta");
+    page_data_add_line(page_data, "<b>broken", NULL, "", "", false, false, true, false, true);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 4, NULL)->match_text, .expected= "<b>broken");
+
+    gsize small_page_mapped = page_data->arena->mapped;
+    for (int i = 0; i < 100000; ++i) {
+        page_data_add_line(page_data, "a line long enough to fill a few arena chunks", NULL, "icon", "", false, false, false, false, true);
+    }
+    test_true(page_data->arena->mapped > 16 * small_page_mapped);
+    page_data_clear_lines(page_data);
+    page_data_add_line(page_data, "ggg", NULL, "", "", false, false, false, false, true);
+    test_uint_equals(.result = page_data->arena->mapped, .expected = small_page_mapped);
+
+    GString* huge_text = g_string_new(NULL);
+    for (int i = 0; i < 100000; ++i) {
+        g_string_append(huge_text, "huge");
+    }
+    page_data_add_line(page_data, huge_text->str, NULL, "", "", false, false, false, false, true);
+    test_uint_equals(.result = strlen(page_data_get_line_by_index_or_else(page_data, 1, NULL)->text), .expected = huge_text->len);
+    test_true(page_data->arena->mapped > small_page_mapped);
+    page_data_set_max_lines(page_data, 1);
+    page_data_add_line(page_data, "hhh", NULL, "", "", false, false, false, false, true);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 0, NULL)->text, .expected= "hhh");
+    test_uint_equals(.result = page_data->arena->mapped, .expected = small_page_mapped);
+    g_string_free(huge_text, TRUE);
+
+    // values repeated across lines share a single copy
+    page_data_set_max_lines(page_data, 0);
+    page_data_clear_lines(page_data);
+    gchar* icon = g_strdup("folder");
+    guint64 hits = page_data->strings->hits;
+    page_data_add_line(page_data, "iii", NULL, "folder", "tag", false, false, false, false, true);
+    page_data_add_line(page_data, "jjj", "meta", icon, "tag", false, false, false, false, true);
+    g_free(icon);
+    LineData* first = page_data_get_line_by_index_or_else(page_data, 0, NULL);
+    LineData* second = page_data_get_line_by_index_or_else(page_data, 1, NULL);
+    test_true(first->icon == second->icon && first->data == second->data);
+    test_string_equals(.result = second->icon, .expected = "folder");
+    test_uint_equals(.result = page_data->strings->hits - hits, .expected = 2);
+    page_data_set_max_lines(page_data, 1);
+    test_uint_equals(.result = g_hash_table_size(page_data->strings->strings), .expected = 3);
+    page_data_clear_lines(page_data);
+    test_uint_equals(.result = g_hash_table_size(page_data->strings->strings), .expected = 0);
+
+    // lines that did not change keep what was cached about them
+    page_data_set_max_lines(page_data, 0);
+    const gchar* texts[] = { "kkk", "lll", "kkk", "mmm" };
+    for (guint i = 0; i < G_N_ELEMENTS(texts); ++i) {
+        page_data_add_line(page_data, texts[i], NULL, "icon", "", false, false, false, false, true);
+        page_data_get_line_by_index_or_else(page_data, i, NULL)->icon_fetch_uid = i + 1;
+    }
+    PageData* new_page = page_data_new();
+    const gchar* new_texts[] = { "kkk", "new", "mmm", "kkk", "kkk" };
+    for (guint i = 0; i < G_N_ELEMENTS(new_texts); ++i) {
+        page_data_add_line(new_page, new_texts[i], NULL, "icon", "", false, false, false, false, true);
+    }
+    page_data_add_line(new_page, "lll", NULL, "icon", "", true, false, false, false, true);
+    GArray* previous = g_array_new(FALSE, FALSE, sizeof(guint));
+    test_true(!page_data_match_lines(page_data, new_page, previous));
+    GString* previous_lines = g_string_new(NULL);
+    for (guint i = 0; i < previous->len; ++i) {
+        g_string_append_printf(previous_lines, "%d/%u ", (gint) g_array_index(previous, guint, i),
+                               page_data_get_line_by_index_or_else(new_page, i, NULL)->icon_fetch_uid);
+    }
+    test_string_equals(.result = previous_lines->str, .expected = "0/1 -1/0 3/4 2/3 -1/0 -1/0 ");
+    page_data_clear_lines(new_page);
+    for (guint i = 0; i < G_N_ELEMENTS(texts); ++i) {
+        page_data_add_line(new_page, texts[i], NULL, "icon", "", false, false, false, false, true);
+    }
+    test_true(page_data_match_lines(page_data, new_page, previous));
+    test_uint_equals(.result = page_data_get_line_by_index_or_else(new_page, 3, NULL)->icon_fetch_uid, .expected = 4);
+    g_string_free(previous_lines, TRUE);
+    g_array_free(previous, TRUE);
+    page_data_destroy(new_page);
+    page_data_clear_lines(page_data);
+
+    char path[] = "/tmp/check_page_data_lines_XXXXXX";
+    close(mkstemp(path));
+    test_true(lines_file_open(path, NULL) == NULL);
+    write_lines_file(path);
+    LinesFile* lines_file = lines_file_open(path, NULL);
+    unlink(path);
+    test_true(lines_file != NULL);
+    page_data_set_max_lines(page_data, 0);
+    page_data_set_lines_file(page_data, lines_file);
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 3);
+    // lines are read the first time any thread needs them
+    GThread* readers[4];
+    for (guint i = 0; i < G_N_ELEMENTS(readers); ++i) {
+        readers[i] = g_thread_new("check-page-data", read_every_line, page_data);
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(readers); ++i) {
+        test_true(GPOINTER_TO_INT(g_thread_join(readers[i])));
+    }
+    line = page_data_get_line_by_index_or_else(page_data, 1, NULL);
+    test_string_equals(.result = line->text, .expected = "<b>two</b>");
+    test_string_equals(.result = line->match_text, .expected = "m");
+    test_string_equals(.result = line->icon, .expected = "icon");
+    test_true(line->urgent && line->markup && line->filter && !line->highlight);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 2, NULL)->text, .expected = "");
+    page_data_set_max_lines(page_data, 2);
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 2);
+    test_true(page_data_get_line_by_index_or_else(page_data, 0, NULL) == line);
+
+    // appending copies the lines out of the file
+    page_data_set_max_lines(page_data, 0);
+    page_data_add_line(page_data, "four", NULL, "", "", false, false, false, false, true);
+    test_true(page_data->lines_file == NULL);
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 4);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 0, NULL)->match_text, .expected = "one");
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 1, NULL)->match_text, .expected = "m");
+
+    // virtual lines are counted, but only the loaded blocks are available
+    page_data_set_virtual_lines(page_data, 1000);
+    test_true(page_data_is_virtual(page_data));
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 1000);
+    test_true(page_data_get_line_by_index_or_else(page_data, 70, NULL) == NULL);
+    PageData* window = page_data_new();
+    for (guint i = 0; i < PAGE_DATA_VIRTUAL_BLOCK_SIZE * 2; ++i) {
+        char text[16];
+        snprintf(text, sizeof(text), "%u", PAGE_DATA_VIRTUAL_BLOCK_SIZE + i);
+        page_data_add_line(window, text, NULL, "", "", false, false, false, false, true);
+    }
+    guint64 virtual_generation = page_data->lines_generation;
+    gsize virtual_size = page_data_get_memory_size(page_data);
+    test_uint_equals(.result = page_data_set_virtual_window(page_data, PAGE_DATA_VIRTUAL_BLOCK_SIZE, window), .expected = 2);
+    test_true(page_data->lines_generation != virtual_generation);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 70, NULL)->text, .expected = "70");
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 191, NULL)->text, .expected = "191");
+    // only the memory of loaded blocks is counted
+    test_true(page_data_get_memory_size(page_data) >= virtual_size + PAGE_DATA_VIRTUAL_BLOCK_SIZE * 2 * sizeof(LineData));
+    test_true(page_data_get_line_by_index_or_else(page_data, 63, NULL) == NULL);
+    test_true(page_data_get_line_by_index_or_else(page_data, 192, NULL) == NULL);
+    // lines of partly covered blocks are dropped, the last block may be short
+    test_uint_equals(.result = page_data_set_virtual_window(page_data, 1, window), .expected = 1);
+    test_true(page_data_get_line_by_index_or_else(page_data, 1, NULL) == NULL);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 70, NULL)->text, .expected = "133");
+    test_uint_equals(.result = page_data_set_virtual_window(page_data, 960, window), .expected = 1);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page_data, 999, NULL)->text, .expected = "103");
+    page_data_destroy(window);
+    // a window loading no block leaves the lines as they were
+    window = page_data_new();
+    page_data_add_line(window, "short", NULL, "", "", false, false, false, false, true);
+    virtual_generation = page_data->lines_generation;
+    test_uint_equals(.result = page_data_set_virtual_window(page_data, 0, window), .expected = 0);
+    test_uint_equals(.result = page_data_set_virtual_window(page_data, G_MAXUINT, window), .expected = 0);
+    test_true(page_data->lines_generation == virtual_generation);
+    test_true(page_data_get_line_by_index_or_else(page_data, 0, NULL) == NULL);
+    page_data_destroy(window);
+    page_data_add_line(page_data, "five", NULL, "", "", false, false, false, false, true);
+    test_true(!page_data_is_virtual(page_data));
+    test_uint_equals(.result = page_data_get_number_of_lines(page_data), .expected = 1);
+
     page_data_destroy(page_data);
 
     return test_finish();
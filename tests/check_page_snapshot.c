@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/page_snapshot.h"
+#include "../src/payload.h"
+#include <dirent.h>
+#include <unistd.h>
+
+// removes the snapshots saved in directory, and directory
+static void remove_directory(const char* directory) {
+    DIR* dir = opendir(directory);
+    struct dirent* entry;
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+            unlink(path);
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+    rmdir(directory);
+}
+
+int main(void)
+{
+    char cache[] = "/tmp/check_page_snapshot_XXXXXX";
+    test_true(mkdtemp(cache) != NULL);
+    setenv("XDG_CACHE_HOME", cache, TRUE);
+    test_true(page_snapshot_load("backend --flag", NULL) == NULL);
+
+    PageData* page = page_data_new();
+    page_data_set_string_member(&page->prompt, "pro\"mpt");
+    page_data_set_message(page, "message");
+    page_data_add_line(page, "<b>one</b>", NULL, "folder", "1", true, false, true, false, true);
+    page_data_add_line(page, "two", "meta", "", "", false, true, false, true, false);
+    test_true(page_snapshot_save(page, "backend --flag", NULL));
+    page_data_destroy(page);
+
+    gsize length;
+    gchar* text = page_snapshot_load("backend --flag", &length);
+    test_true(text != NULL);
+    test_true(page_snapshot_load("other backend", NULL) == NULL);
+    Payload payload;
+    test_true(payload_parse_json(&payload, text, length, NULL));
+    test_string_equals(.result = payload.prompt.value, .expected = "pro\"mpt");
+    test_string_equals(.result = payload.message.value, .expected = "message");
+    test_true(payload.icon.present && payload.icon.value == NULL);
+
+    // lines are restored with their flags and markup, whatever the default
+    LinesFile* file = lines_file_open(payload.lines_file.value, NULL);
+    test_true(file != NULL);
+    page = page_data_new();
+    page_data_set_lines_file(page, file);
+    test_uint_equals(.result = page_data_get_number_of_lines(page), .expected = 2);
+    LineData* line = page_data_get_line_by_index_or_else(page, 0, NULL);
+    test_string_equals(.result = line->text, .expected = "<b>one</b>");
+    test_string_equals(.result = line->match_text, .expected = "one");
+    test_string_equals(.result = line->icon, .expected = "folder");
+    test_string_equals(.result = line->data, .expected = "1");
+    test_true(line->urgent && line->markup && !line->highlight && line->filter);
+    line = page_data_get_line_by_index_or_else(page, 1, NULL);
+    test_string_equals(.result = line->meta, .expected = "meta");
+    test_true(line->highlight && line->nonselectable && !line->filter && !line->markup);
+
+    // saving over a snapshot that is mapped leaves the mapping as it was
+    page_data_set_virtual_lines(page, 10);
+    test_true(page_snapshot_save(page, "backend --flag", NULL));
+    PageData* saved = page_data_new();
+    page_data_add_line(saved, "three", NULL, "", "", false, false, false, false, true);
+    test_true(page_snapshot_save(saved, "other backend", NULL));
+    page_data_destroy(saved);
+    g_free(text);
+
+    text = page_snapshot_load("backend --flag", &length);
+    test_true(payload_parse_json(&payload, text, length, NULL));
+    file = lines_file_open(payload.lines_file.value, NULL);
+    page_data_set_lines_file(page, file);
+    test_uint_equals(.result = page_data_get_number_of_lines(page), .expected = 2);
+    g_free(text);
+    text = page_snapshot_load("other backend", &length);
+    test_true(payload_parse_json(&payload, text, length, NULL));
+    test_true(payload.prompt.present && payload.prompt.value == NULL);
+    page_data_destroy(page);
+    g_free(text);
+
+    char snapshots[64];
+    snprintf(snapshots, sizeof(snapshots), "%s/rofi-blocks", cache);
+    remove_directory(snapshots);
+    rmdir(cache);
+    return test_finish();
+}
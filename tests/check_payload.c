@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/payload.h"
+
+static bool parse(Payload* payload, const char* json, char* buffer) {
+    strcpy(buffer, json);
+    return payload_parse_json(payload, buffer, strlen(buffer), NULL);
+}
+
+#define parse_msgpack(payload, bytes, buffer) parse_msgpack_length(payload, bytes, sizeof(bytes) - 1, buffer)
+
+static bool parse_msgpack_length(Payload* payload, const char* bytes, size_t length, char* buffer) {
+    memcpy(buffer, bytes, length);
+    return payload_parse_msgpack(payload, buffer, length, NULL);
+}
+
+int main(void)
+{
+    char buffer[1024];
+    Payload payload;
+
+    test_true(parse(&payload, "{}", buffer));
+    test_true(!payload.message.present && payload.lines.start == NULL);
+    test_true(!parse(&payload, "", buffer));
+    test_true(!parse(&payload, "[]", buffer));
+    test_true(!parse(&payload, "{\"message\": \"unterminated}", buffer));
+    test_true(!parse(&payload, "{\"lines\": [1, 2,]}", buffer));
+    test_true(!parse(&payload, "{} trailing", buffer));
+
+    test_true(parse(&payload, " {\"message\": \"a\\tb \\u00e9 \\ud83d\\ude00 \\\"q\\\"\", \"prompt\": null, \"input\": 3} ", buffer));
+    test_string_equals(.result = payload.message.value, .expected = "a\tb \xc3\xa9 \xf0\x9f\x98\x80 \"q\"");
+    test_true(payload.prompt.present && payload.prompt.value == NULL);
+    test_true(!payload.input.present);
+
+    test_true(parse(&payload, "{\"case_sensitive\": true, \"close_on_exit\": 1, \"selected_line\": 4, \"max_lines\": 2.5}", buffer));
+    test_true(payload.case_sensitive.present && payload.case_sensitive.value);
+    test_true(!payload.close_on_exit.present);
+    test_true(payload.selected_line.is_integer && payload.selected_line.value == 4);
+    test_true(payload.max_lines.present && !payload.max_lines.is_integer);
+
+    test_true(parse(&payload, "{\"lines_count\": 1000000, \"lines_offset\": 64, \"lines\": [\"a\"]}", buffer));
+    test_true(payload.lines_count.is_integer && payload.lines_count.value == 1000000);
+    test_true(payload.lines_offset.is_integer && payload.lines_offset.value == 64);
+    test_true(!payload_is_idempotent(&payload));
+
+    test_true(parse(&payload, "{\"stats\": true}", buffer));
+    test_true(payload.stats.present && payload.stats.value);
+    test_true(!payload_is_idempotent(&payload));
+    test_true(parse(&payload, "{\"stats\": false}", buffer));
+    test_true(payload_is_idempotent(&payload));
+    // focusing a line is an action, the user may have moved since
+    test_true(parse(&payload, "{\"selected_line\": 3}", buffer));
+    test_true(!payload_is_idempotent(&payload));
+
+    test_true(parse(&payload, "{\"unknown\": {\"a\": [1, {\"b\": null}]}, \"message\": \"x\", \"message\": \"y\"}", buffer));
+    test_string_equals(.result = payload.message.value, .expected = "y");
+
+    test_true(parse(&payload, "{\"lines\": [\"one\", {\"text\": \"t\\\"wo\", \"meta\": \"m\", \"urgent\": true, \"extra\": [1]}, 3, {\"markup\": \"no\"}]}", buffer));
+    test_uint_equals(.result = payload.lines.count, .expected = 4);
+    PageData* page = page_data_new();
+    page->markup_default = MarkupStatus_ENABLED;
+    payload_build_lines(&payload.lines, page, 0);
+    test_uint_equals(.result = page_data_get_number_of_lines(page), .expected = 3);
+    LineData* line = page_data_get_line_by_index_or_else(page, 0, NULL);
+    test_string_equals(.result = line->text, .expected = "one");
+    test_true(line->markup && line->filter && line->meta == NULL);
+    line = page_data_get_line_by_index_or_else(page, 1, NULL);
+    test_string_equals(.result = line->text, .expected = "t\"wo");
+    test_string_equals(.result = line->meta, .expected = "m");
+    test_true(line->urgent && !line->highlight);
+    line = page_data_get_line_by_index_or_else(page, 2, NULL);
+    test_string_equals(.result = line->text, .expected = "");
+    test_true(line->markup);
+
+    test_true(parse(&payload, "{\"lines_append\": [\"a\", \"b\", \"c\"]}", buffer));
+    page_data_clear_lines(page);
+    payload_build_lines(&payload.lines_append, page, 2);
+    test_uint_equals(.result = page_data_get_number_of_lines(page), .expected = 1);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page, 0, NULL)->text, .expected = "c");
+    page_data_destroy(page);
+
+    test_true(parse(&payload, "{\"debounce\": {\"input\": 150, \"other\": {}, \"select_entry\": null}, \"throttle\": 5}", buffer));
+    test_true(payload.debounce.input.is_integer && payload.debounce.input.value == 150);
+    test_true(payload.debounce.select_entry.present && !payload.debounce.select_entry.is_integer);
+    test_true(!payload.throttle.input.present && !payload.throttle.select_entry.present);
+    test_true(!parse(&payload, "{\"debounce\": {\"input\": 150,}}", buffer));
+
+    // msgpack: {"message": "hi", "selected_line": -2, "max_lines": 2.5, "lines": ["one", {"text": "two", "urgent": true, "x": [1]}, 3]}
+    test_true(parse_msgpack(&payload,
+        "\x84" "\xa7" "message" "\xa2" "hi" "\xad" "selected_line" "\xd1\xff\xfe"
+        "\xa9" "max_lines" "\xcb\x40\x04\x00\x00\x00\x00\x00\x00"
+        "\xa5" "lines" "\x93" "\xa3" "one" "\x83" "\xa4" "text" "\xd9\x03" "two" "\xa6" "urgent" "\xc3" "\xa1" "x" "\x91\x01" "\x03",
+        buffer));
+    test_string_equals(.result = payload.message.value, .expected = "hi");
+    test_true(payload.selected_line.is_integer && payload.selected_line.value == -2);
+    test_true(payload.max_lines.present && !payload.max_lines.is_integer);
+    test_uint_equals(.result = payload.lines.count, .expected = 3);
+    page = page_data_new();
+    payload_build_lines(&payload.lines, page, 0);
+    test_uint_equals(.result = page_data_get_number_of_lines(page), .expected = 2);
+    test_string_equals(.result = page_data_get_line_by_index_or_else(page, 0, NULL)->text, .expected = "one");
+    line = page_data_get_line_by_index_or_else(page, 1, NULL);
+    test_string_equals(.result = line->text, .expected = "two");
+    test_true(line->urgent && !line->markup);
+    page_data_destroy(page);
+
+    test_true(!parse_msgpack(&payload, "\x91\xc0", buffer));
+    test_true(!parse_msgpack(&payload, "\x81\xa7" "message" "\xa5" "hi", buffer));
+    test_true(!parse_msgpack(&payload, "\x81\xa7" "message" "\xc1", buffer));
+    test_true(!parse_msgpack(&payload, "\x81\xa7" "message" "\xa1\xff", buffer));
+    test_true(!parse_msgpack(&payload, "\x80\xc0", buffer));
+    // strings that are not UTF-8 reject the whole payload, wherever they are
+    test_true(!parse_msgpack(&payload, "\x81\xa5" "lines" "\x92" "\xa3" "one" "\xa1\xff", buffer));
+    test_true(!parse_msgpack(&payload, "\x81\xa5" "lines" "\x91" "\x81\xa4" "meta" "\xa1\xff", buffer));
+    test_true(!parse_msgpack(&payload, "\x81\xa7" "unknown" "\x91\xa1\xff", buffer));
+
+    return test_finish();
+}
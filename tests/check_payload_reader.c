@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/payload_reader.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct {
+    GString* prompts;
+    guint lines;
+    guint batches;
+    gboolean lines_built;
+} ReadState;
+
+static void on_payload(PayloadReaderItem* item, gpointer context) {
+    ReadState* state = context;
+    if (item == NULL) {
+        state->batches++;
+        return;
+    }
+    if (item->payload.prompt.present) {
+        g_string_append_printf(state->prompts, "%s ", item->payload.prompt.value);
+    }
+    if (item->lines != NULL) {
+        state->lines = page_data_get_number_of_lines(item->lines);
+        LineData* line = page_data_get_line_by_index_or_else(item->lines, 1, NULL);
+        state->lines_built = line != NULL && g_strcmp0(line->text, "c") == 0 && g_strcmp0(line->icon, "folder") == 0;
+    }
+}
+
+static void write_text(int fd, const gchar* text) {
+    test_true(write(fd, text, strlen(text)) == (ssize_t) strlen(text));
+}
+
+int main(void)
+{
+    int fds[2];
+    test_true(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    ReadState state = { .prompts = g_string_new(NULL) };
+    Stats stats;
+    stats_init(&stats);
+    PayloadReader* reader = payload_reader_new(fds[0], PayloadFormat_JSON, MarkupStatus_UNDEFINED, 0, NULL, &stats,
+                                               on_payload, &state);
+
+    write_text(fds[1], "{\"prompt\":\"one\"}\n{\"prompt\":\"one\"}\n{\"prompt\":\"two\", \"max_lines\":2}\n");
+    write_text(fds[1], "not json\n{\"lines\":[\"a\", \"b\", {\"text\":\"c\", \"icon\":\"folder\"}]}\n");
+    // lines are built on the reader thread, with the max_lines read before
+    while (state.lines == 0) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    test_string_equals(.result = state.prompts->str, .expected = "one two ");
+    test_uint_equals(.result = state.lines, .expected = 2);
+    test_true(state.lines_built);
+    test_true(state.batches > 0);
+    test_uint_equals(.result = stats_get(&stats.payloads_received), .expected = 5);
+    test_uint_equals(.result = stats_get(&stats.payloads_coalesced), .expected = 1);
+    test_uint_equals(.result = stats_get(&stats.bytes_read), .expected = 16 + 16 + 31 + 8 + 51);
+    test_true(stats_get_parse_time_percentile(&stats, 100) > 0);
+
+    // payloads that act each time they are received are never skipped
+    write_text(fds[1], "{\"prompt\":\"three\", \"input\":\"x\"}\n{\"prompt\":\"three\", \"input\":\"x\"}\n");
+    while (strstr(state.prompts->str, "three three") == NULL) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    test_string_equals(.result = state.prompts->str, .expected = "one two three three ");
+
+    close(fds[1]);
+    payload_reader_destroy(reader);
+    close(fds[0]);
+    g_string_free(state.prompts, TRUE);
+    return test_finish();
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/stats.h"
+
+int main(void)
+{
+    Stats stats;
+    stats_init(&stats);
+    test_true(stats.started > 0);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 50), .expected = 0);
+
+    stats_add(&stats.payloads_received, 3);
+    stats_add(&stats.payloads_received, 2);
+    test_uint_equals(.result = stats_get(&stats.payloads_received), .expected = 5);
+
+    // 90 parses of at most 1us, 9 of 100us and 1 of 5ms
+    for (int i = 0; i < 90; ++i) {
+        stats_add_parse_time(&stats, i % 2);
+    }
+    for (int i = 0; i < 9; ++i) {
+        stats_add_parse_time(&stats, 100);
+    }
+    stats_add_parse_time(&stats, 5000);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 50), .expected = 1);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 90), .expected = 1);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 91), .expected = 128);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 99), .expected = 128);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 100), .expected = 8192);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 0), .expected = 1);
+
+    // times past the last bucket are counted in it
+    stats_init(&stats);
+    stats_add_parse_time(&stats, G_MAXINT64);
+    test_uint_equals(.result = stats_get_parse_time_percentile(&stats, 50),
+                     .expected = G_GUINT64_CONSTANT(1) << (STATS_PARSE_TIME_BUCKETS - 1));
+
+    stats_add(&stats.bytes_read, 42);
+    GString* json = g_string_new(NULL);
+    stats_append_json(&stats, json);
+    test_true(g_str_has_prefix(json->str, "\"uptime_ms\":"));
+    test_true(strstr(json->str, ", \"payloads_received\":0, \"payloads_coalesced\":0, \"bytes_read\":42, ") != NULL);
+    test_true(strstr(json->str, "\"parse_time_us\":{\"p50\":2147483648, ") != NULL);
+    g_string_free(json, TRUE);
+
+    return test_finish();
+}
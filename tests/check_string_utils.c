@@ -3,6 +3,27 @@
 #include "simple_tap_test_util.h"
 #include "../src/string_utils.h"
 
+// one byte at a time, as a reference for the block based escaper
+static char* reference_escape(const char* in, size_t length) {
+    char* result = malloc(length * 6 + 1);
+    char* out = result;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = in[i];
+        switch (c) {
+        case '"': out += sprintf(out, "\\\""); break;
+        case '\\': out += sprintf(out, "\\\\"); break;
+        case '\b': out += sprintf(out, "\\b"); break;
+        case '\f': out += sprintf(out, "\\f"); break;
+        case '\n': out += sprintf(out, "\\n"); break;
+        case '\r': out += sprintf(out, "\\r"); break;
+        case '\t': out += sprintf(out, "\\t"); break;
+        default: out += c < 0x20 ? sprintf(out, "\\u%04x", c) : sprintf(out, "%c", c); break;
+        }
+    }
+    *out = '\0';
+    return result;
+}
+
 
 int main(void)
 {
@@ -31,5 +52,36 @@ int main(void)
     test_string_equals(.result = str_replace_in_escaped(&result, "{{bb}}", "\\ \" \t \f \b \r\n a b"), .expected = "a lorem \\\\ \\\" \\t \\f \\b \\r\\n a b c", .description = "str_replace_in(&result, \"{{bb}}\", \\\\ \\\" \\t \\f \\b \\r\\n a b\") == \"a lorem \\\\\\\\ \\\\\\\" \\\\t \\\\f \\\\b \\\\r\\\\n a b c\"");
     free(result);
 
+
+    result = str_new_escaped_for_json_string("");
+    test_string_equals(.result = result, .expected = "");
+    free(result);
+
+    result = str_new_escaped_for_json_string("\x01 \x1f \x7f \xc3\xa9 \"/\"");
+    test_string_equals(.result = result, .expected = "\\u0001 \\u001f \x7f \xc3\xa9 \\\"/\\\"");
+    free(result);
+
+    test_uint_equals(.result = str_escaped_for_json_string_length("a\"b\x02", 4), .expected = 10);
+    test_uint_equals(.result = str_escaped_for_json_string_length("a\"b\x02", 2), .expected = 3);
+
+    // escapes on both sides of every block boundary
+    char mixed[256];
+    for (size_t i = 0; i < sizeof(mixed); ++i) {
+        mixed[i] = (i * 7) % 5 == 0 ? (char) (i % 0x20) : (i % 13 == 0 ? '"' : (i % 11 == 0 ? '\\' : 'a' + i % 26));
+    }
+    bool all_lengths_match = true;
+    for (size_t length = 0; length <= sizeof(mixed); ++length) {
+        char* expected = reference_escape(mixed, length);
+        char out[sizeof(mixed) * 6];
+        size_t escaped_length = str_escaped_for_json_string_length(mixed, length);
+        char* end = str_escape_for_json_string_into(mixed, length, out);
+        all_lengths_match = all_lengths_match
+            && escaped_length == strlen(expected)
+            && (size_t) (end - out) == escaped_length
+            && memcmp(out, expected, escaped_length) == 0;
+        free(expected);
+    }
+    test_true(all_lengths_match, .description = "escaping every prefix of mixed input matches the reference escaper");
+
     return test_finish();
 }
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/trace.h"
+#include <unistd.h>
+
+static gpointer end_span_on_thread(gpointer context) {
+    Trace* trace = context;
+    trace_end(trace, "parse", trace_begin(trace), "\"bytes\":%d", 42);
+    return NULL;
+}
+
+int main(void)
+{
+    // a disabled trace does nothing
+    test_true(trace_begin(NULL) == 0);
+    trace_end(NULL, "read", 0, NULL);
+    trace_destroy(NULL);
+
+    GError* error = NULL;
+    test_true(trace_new("/nonexistent/directory/trace.json", &error) == NULL);
+    test_true(error != NULL && error->domain == TRACE_ERROR);
+    g_clear_error(&error);
+
+    char path[] = "/tmp/check_trace_XXXXXX";
+    int fd = mkstemp(path);
+    test_true(fd >= 0);
+    close(fd);
+    Trace* trace = trace_new(path, NULL);
+    test_true(trace != NULL);
+    gint64 start = trace_begin(trace);
+    test_true(start > 0);
+    trace_end(trace, "read", start, NULL);
+    GThread* thread = g_thread_new("check-trace", end_span_on_thread, trace);
+    g_thread_join(thread);
+    trace_end(trace, "write_event", trace_begin(trace), "\"event\":\"%s\"", "INPUT");
+    trace_destroy(trace);
+
+    gchar* contents = NULL;
+    test_true(g_file_get_contents(path, &contents, NULL, NULL));
+    test_true(g_str_has_prefix(contents, "[{\"name\":\"process_name\", \"ph\":\"M\""));
+    test_true(g_str_has_suffix(contents, "\n]\n"));
+    test_true(strstr(contents, "{\"name\":\"read\", \"cat\":\"blocks\", \"ph\":\"X\", \"ts\":") != NULL);
+    const char* read_span = strstr(contents, "\"name\":\"read\"");
+    test_true(read_span != NULL && strstr(read_span, "\"tid\":1}") != NULL);
+    const char* parse_span = strstr(contents, "\"name\":\"parse\"");
+    test_true(parse_span != NULL && strstr(parse_span, "\"tid\":2, \"args\":{\"bytes\":42}}") != NULL);
+    const char* write_span = strstr(contents, "\"name\":\"write_event\"");
+    test_true(write_span != NULL && strstr(write_span, "\"tid\":1, \"args\":{\"event\":\"INPUT\"}}") != NULL);
+    g_free(contents);
+    unlink(path);
+
+    return test_finish();
+}
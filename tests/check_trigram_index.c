@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/trigram_index.h"
+
+static GString* query(TrigramIndex* index, const gchar* const* needles) {
+    GArray* lines = trigram_index_query(index, needles);
+    if (lines == NULL) {
+        return NULL;
+    }
+    GString* result = g_string_new(NULL);
+    for (guint i = 0; i < lines->len; ++i) {
+        g_string_append_printf(result, "%s%u", i == 0 ? "" : " ", g_array_index(lines, guint, i));
+    }
+    g_array_free(lines, TRUE);
+    return result;
+}
+
+static void test_query(TrigramIndex* index, const gchar* const* needles, const gchar* expected) {
+    GString* result = query(index, needles);
+    test_string_equals(.result = result->str, .expected = expected);
+    g_string_free(result, TRUE);
+}
+
+int main(void)
+{
+    TrigramIndex* index = trigram_index_new();
+    trigram_index_add(index, "Firefox Web Browser", FALSE);
+    trigram_index_add(index, "Files", FALSE);
+    trigram_index_add(index, "always shown", TRUE);
+    trigram_index_add(index, "web server logs", FALSE);
+    trigram_index_add(index, "ÉCRAN de veille", FALSE);
+    test_uint_equals(.result = index->lines, .expected = 5);
+    test_true(index->memory > 0);
+
+    test_query(index, (const gchar*[]) { "fire", NULL }, "0 2");
+    test_query(index, (const gchar*[]) { "WEB", NULL }, "0 2 3");
+    test_query(index, (const gchar*[]) { "web", "logs", NULL }, "2 3");
+    test_query(index, (const gchar*[]) { "écran", NULL }, "2 4");
+
+    // a trigram no line has leaves only the always lines
+    test_query(index, (const gchar*[]) { "xyz", NULL }, "2");
+    test_query(index, (const gchar*[]) { "fil", "missing", NULL }, "2");
+
+    // needles shorter than a trigram cannot narrow anything
+    test_true(query(index, (const gchar*[]) { "fi", "w", NULL }) == NULL);
+    test_true(query(index, (const gchar*[]) { NULL }) == NULL);
+
+    // line numbers far apart take more than a byte to encode
+    for (guint i = 0; i < 1000; ++i) {
+        trigram_index_add(index, i == 700 ? "far away files" : "filler", FALSE);
+    }
+    test_query(index, (const gchar*[]) { "files", NULL }, "1 2 705");
+
+    // dropping the oldest lines numbers the rest from the first one kept
+    trigram_index_drop(index, 2);
+    test_uint_equals(.result = trigram_index_get_number_of_lines(index), .expected = 1003);
+    test_query(index, (const gchar*[]) { "files", NULL }, "0 703");
+    test_query(index, (const gchar*[]) { "xyz", NULL }, "0");
+    trigram_index_drop(index, 1);
+    test_query(index, (const gchar*[]) { "xyz", NULL }, "");
+    trigram_index_add(index, "new files", FALSE);
+    test_query(index, (const gchar*[]) { "files", NULL }, "702 1002");
+    trigram_index_drop(index, 2000);
+    test_uint_equals(.result = trigram_index_get_number_of_lines(index), .expected = 0);
+    test_query(index, (const gchar*[]) { "files", NULL }, "");
+
+    trigram_index_clear(index);
+    test_uint_equals(.result = index->lines, .expected = 0);
+    test_uint_equals(.result = index->dropped, .expected = 0);
+    trigram_index_add(index, "files again", FALSE);
+    test_query(index, (const gchar*[]) { "files", NULL }, "0");
+
+    trigram_index_destroy(index);
+    return test_finish();
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2020 Omar Castro
+#include "simple_tap_test_util.h"
+#include "../src/unix_socket.h"
+#include <sys/socket.h>
+#include <unistd.h>
+
+int main(void)
+{
+    char directory[] = "/tmp/check_unix_socket_XXXXXX";
+    test_true(mkdtemp(directory) != NULL);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/blocks.sock", directory);
+    GError* error = NULL;
+    test_true(unix_socket_connect(path, &error) < 0);
+    test_true(error != NULL);
+    g_clear_error(&error);
+
+    int listen_fd = unix_socket_listen(path, NULL);
+    test_true(listen_fd >= 0);
+    // sessions connect to the same socket, each on a connection of its own
+    int first = unix_socket_connect(path, NULL);
+    int second = unix_socket_connect(path, NULL);
+    test_true(first >= 0 && second >= 0);
+    int first_accepted = accept(listen_fd, NULL, NULL);
+    int second_accepted = accept(listen_fd, NULL, NULL);
+    char buffer[16] = { 0 };
+    test_true(write(second, "two\n", 4) == 4);
+    test_true(read(second_accepted, buffer, sizeof(buffer)) == 4);
+    test_string_equals(.result = buffer, .expected = "two\n");
+    test_true(write(first_accepted, "one\n", 4) == 4);
+    test_true(read(first, buffer, sizeof(buffer)) == 4);
+    test_string_equals(.result = buffer, .expected = "one\n");
+    close(first);
+    close(second);
+    close(first_accepted);
+    close(second_accepted);
+
+    // a socket left behind by a backend that did not stop is replaced
+    close(listen_fd);
+    listen_fd = unix_socket_listen(path, NULL);
+    test_true(listen_fd >= 0);
+    close(listen_fd);
+
+    char long_path[200];
+    memset(long_path, 'x', sizeof(long_path) - 1);
+    long_path[sizeof(long_path) - 1] = '\0';
+    test_true(unix_socket_connect(long_path, &error) < 0);
+    test_true(error != NULL && strstr(error->message, "too long") != NULL);
+    g_clear_error(&error);
+
+    unlink(path);
+    rmdir(directory);
+    return test_finish();
+}